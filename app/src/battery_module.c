@@ -39,6 +39,7 @@
 #include "nrf_fuel_gauge.h"
 #include "ui/move_ui.h"
 #include "hw_module.h"
+#include "log_module.h"
 
 LOG_MODULE_REGISTER(battery_module, LOG_LEVEL_DBG);
 
@@ -305,6 +306,9 @@ void battery_monitor_conditions(uint8_t sys_batt_level, bool sys_batt_charging,
             low_battery_screen_active = true;
             critical_battery_notified = true;
 
+            // Persist buffered trend points in case the battery gives out
+            hpi_log_trend_flush_all();
+
             // Load the low battery screen with battery level and voltage as arguments
             // Pass voltage as arg3 (multiply by 100 to preserve 2 decimal places in uint32_t)
             hpi_load_scr_spl(SCR_SPL_LOW_BATTERY, SCROLL_NONE, sys_batt_level, sys_batt_charging, (uint32_t)(sys_batt_voltage * 100), 0);
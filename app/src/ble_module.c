@@ -52,7 +52,16 @@
 #define LOG_LEVEL CONFIG_LOG_DEFAULT_LEVEL
 LOG_MODULE_REGISTER(ble_module, LOG_LEVEL_DBG);
 
+// Set and cleared on the BT thread; other threads must go through
+// ble_get_conn() so the connection can't be released while they use it
 struct bt_conn *current_conn;
+static struct k_spinlock current_conn_lock;
+
+// Bulk transfers are paced by notification completions rather than fixed
+// delays; each credit is one notification queued in the stack
+#define BLE_BULK_CREDIT_TIMEOUT K_SECONDS(2)
+#define BLE_BULK_NOMEM_RETRIES 10
+K_SEM_DEFINE(sem_ble_bulk_credits, CONFIG_HPI_BLE_BULK_WINDOW, CONFIG_HPI_BLE_BULK_WINDOW);
 
 // BLE GATT Identifiers
 
@@ -317,6 +326,121 @@ void hpi_ble_send_data(const uint8_t *data, uint16_t len)
 	bt_gatt_notify(NULL, attr, data, len);
 }
 
+static void ble_bulk_notify_complete(struct bt_conn *conn, void *user_data)
+{
+	k_sem_give(&sem_ble_bulk_credits);
+}
+
+// Returns a reference to the current connection, or NULL if not connected.
+// The caller must bt_conn_unref() it.
+static struct bt_conn *ble_get_conn(void)
+{
+	struct bt_conn *conn = NULL;
+	k_spinlock_key_t key = k_spin_lock(&current_conn_lock);
+
+	if (current_conn != NULL)
+	{
+		conn = bt_conn_ref(current_conn);
+	}
+	k_spin_unlock(&current_conn_lock, key);
+
+	return conn;
+}
+
+// Largest notification payload on the current connection, 0 if not connected
+uint16_t hpi_ble_get_max_payload(void)
+{
+	struct bt_conn *conn = ble_get_conn();
+	uint16_t payload;
+
+	if (conn == NULL)
+	{
+		return 0;
+	}
+
+	// 3 bytes of ATT opcode and handle
+	payload = bt_gatt_get_mtu(conn) - 3;
+	bt_conn_unref(conn);
+
+	return payload;
+}
+
+void hpi_ble_bulk_begin(void)
+{
+	k_sem_reset(&sem_ble_bulk_credits);
+	for (int i = 0; i < CONFIG_HPI_BLE_BULK_WINDOW; i++)
+	{
+		k_sem_give(&sem_ble_bulk_credits);
+	}
+}
+
+int hpi_ble_send_data_bulk(const uint8_t *data, uint16_t len)
+{
+	struct bt_gatt_notify_params params = {
+		.attr = &hpi_cmd_service.attrs[4],
+		.data = data,
+		.len = len,
+		.func = ble_bulk_notify_complete,
+	};
+	struct bt_conn *conn = ble_get_conn();
+	int ret;
+
+	// A NULL conn would notify every subscribed connection
+	if (conn == NULL)
+	{
+		LOG_ERR("Bulk transfer aborted - not connected");
+		return -ENOTCONN;
+	}
+
+	for (int retry = 0; retry < BLE_BULK_NOMEM_RETRIES; retry++)
+	{
+		if (k_sem_take(&sem_ble_bulk_credits, BLE_BULK_CREDIT_TIMEOUT) != 0)
+		{
+			LOG_ERR("Bulk transfer stalled");
+			bt_conn_unref(conn);
+			return -ETIMEDOUT;
+		}
+
+		ret = bt_gatt_notify_cb(conn, &params);
+		if (ret == 0)
+		{
+			bt_conn_unref(conn);
+			return 0;
+		}
+
+		k_sem_give(&sem_ble_bulk_credits);
+		if (ret != -ENOMEM)
+		{
+			break;
+		}
+
+		// Host buffers are shared with other services, back off briefly
+		k_sleep(K_MSEC(5));
+	}
+
+	bt_conn_unref(conn);
+	LOG_ERR("Bulk notify failed: %d", ret);
+	return ret;
+}
+
+// Waits until every queued bulk notification has gone out
+int hpi_ble_bulk_end(void)
+{
+	int ret = 0;
+
+	for (int i = 0; i < CONFIG_HPI_BLE_BULK_WINDOW; i++)
+	{
+		if (k_sem_take(&sem_ble_bulk_credits, BLE_BULK_CREDIT_TIMEOUT) != 0)
+		{
+			ret = -ETIMEDOUT;
+			break;
+		}
+	}
+
+	hpi_ble_bulk_begin();
+	return ret;
+}
+
 void ble_ppg_notify_wr(uint32_t *ppg_data, uint8_t len)
 {
 	uint8_t out_data[128];
@@ -353,7 +477,10 @@ void ble_ppg_notify_fi(uint32_t *ppg_data, uint8_t len)
 
 void ble_ecg_notify(int32_t *ecg_data, uint8_t len)
 { 
-	uint8_t out_data[128];
+	// One FIFO batch per notification, at most a full 32 sample FIFO
+	uint8_t out_data[ECG_POINTS_PER_SAMPLE * 4];
+
+	len = MIN(len, ECG_POINTS_PER_SAMPLE);
 	
 	for (int i = 0; i < len; i++)
 	{
@@ -370,9 +497,11 @@ void ble_ecg_notify(int32_t *ecg_data, uint8_t len)
 
 void ble_gsr_notify(int32_t *gsr_data, uint8_t len)
 {
-	uint8_t out_data[128];
+	uint8_t out_data[ECG_POINTS_PER_SAMPLE * 4];
 	int32_t gsr_data_i32 = 0;
 
+	len = MIN(len, ECG_POINTS_PER_SAMPLE);
+
 	for (int i = 0; i < len; i++)
 	{
 		out_data[i * 4] = (uint8_t)gsr_data_i32;
@@ -422,6 +551,13 @@ static void connected(struct bt_conn *conn, uint8_t err)
 
 	LOG_INF("Connected to %s\n", addr);
 
+	k_spinlock_key_t key = k_spin_lock(&current_conn_lock);
+	if (current_conn == NULL)
+	{
+		current_conn = bt_conn_ref(conn);
+	}
+	k_spin_unlock(&current_conn_lock, key);
+
 	if (bt_conn_set_security(conn, BT_SECURITY_L2))
 	{
 		LOG_ERR("Failed to set security\n");
@@ -436,6 +572,21 @@ static void disconnected(struct bt_conn *conn, uint8_t reason)
 
 	LOG_INF("Disconnected from %s, reason 0x%02x %s\n", addr,
 			reason, bt_hci_err_to_str(reason));
+
+	// Only the connection bulk transfers use is tracked
+	struct bt_conn *old = NULL;
+	k_spinlock_key_t key = k_spin_lock(&current_conn_lock);
+	if (conn == current_conn)
+	{
+		old = current_conn;
+		current_conn = NULL;
+	}
+	k_spin_unlock(&current_conn_lock, key);
+
+	if (old != NULL)
+	{
+		bt_conn_unref(old);
+	}
 }
 
 static void security_changed(struct bt_conn *conn, bt_security_t level,
@@ -33,16 +33,26 @@
 #include <zephyr/device.h>
 #include <zephyr/drivers/uart.h>
 #include <zephyr/sys/reboot.h>
+#include <zephyr/sys/byteorder.h>
+#include <string.h>
 
 #include "cmd_module.h"
 #include "hw_module.h"
 #include "ble_module.h"
 #include "fs_module.h"
 #include "log_module.h"
+#include "storage_module.h"
+#include "hpi_sys.h"
 
 LOG_MODULE_REGISTER(hpi_cmd_module, LOG_LEVEL_DBG);
 
 #define MAX_MSG_SIZE 32
+// Fetch commands: cmd, type, int64 file ID, then optional uint32 offset and length
+#define HPI_CMD_FETCH_RANGE_PKT_LEN 18
+// Index commands: cmd, type, then optional int64 start-after and uint16 max count
+#define HPI_CMD_INDEX_PAGE_PKT_LEN 12
+// Rate command: cmd, uint16 ECG SPS, uint8 BioZ SPS
+#define HPI_CMD_SET_RATE_PKT_LEN 4
 K_MSGQ_DEFINE(q_cmd_msg, sizeof(struct hpi_cmd_data_obj_t), 64, 4);  // Reduced from 128 to 64 messages
 
 int cmd_pkt_len;
@@ -60,6 +70,37 @@ extern struct k_sem sem_bpt_enter_mode_cal;
 extern struct k_sem sem_bpt_cal_start;
 extern struct k_sem sem_bpt_exit_mode_cal;
 
+// Reply with the stats packets of each key and mirror them on the USB console
+static void hpi_cmd_send_flash_stats(uint8_t m_key, bool m_reset)
+{
+    struct hpi_flash_io_stats_t stats;
+    const uint8_t *keys;
+    size_t num_keys = hpi_flash_stats_keys(&keys);
+
+    hpi_ble_bulk_begin();
+
+    for (size_t i = 0; i < num_keys; i++)
+    {
+        if (m_key == HPI_FLASH_STATS_KEY_ALL || m_key == keys[i])
+        {
+            hpi_flash_stats_get(keys[i], &stats);
+            if (cmdif_send_ble_flash_stats(keys[i], &stats) < 0)
+            {
+                break;
+            }
+        }
+    }
+
+    hpi_ble_bulk_end();
+
+    hpi_flash_stats_print_usb(m_key);
+
+    if (m_reset)
+    {
+        hpi_flash_stats_reset(m_key);
+    }
+}
+
 void hpi_decode_data_packet(uint8_t *in_pkt_buf, uint8_t pkt_len)
 {
     uint8_t cmd_cmd_id = in_pkt_buf[0];
@@ -79,9 +120,22 @@ void hpi_decode_data_packet(uint8_t *in_pkt_buf, uint8_t pkt_len)
     case HPI_CMD_DEVICE_RESET:
         LOG_DBG("RX CMD Reboot");
         LOG_DBG("Rebooting...");
+        hpi_log_trend_flush_all();
         k_sleep(K_MSEC(1000));
         sys_reboot(SYS_REBOOT_COLD);
         break;
+    case HPI_CMD_SET_ECG_BIOZ_RATE:
+        if (pkt_len < HPI_CMD_SET_RATE_PKT_LEN)
+        {
+            LOG_WRN("RX CMD Set ECG/BioZ Rate: short packet (%d)", pkt_len);
+            break;
+        }
+        LOG_DBG("RX CMD Set ECG/BioZ Rate: %d/%d SPS", sys_get_le16(&in_pkt_buf[1]), in_pkt_buf[3]);
+        if (hpi_ecg_set_sample_rates(sys_get_le16(&in_pkt_buf[1]), in_pkt_buf[3]) != 0)
+        {
+            LOG_WRN("Unsupported ECG/BioZ rate");
+        }
+        break;
     case HPI_CMD_BPT_SEL_CAL_MODE:
         LOG_DBG("RX CMD Select BPT Cal Mode");
         k_sem_give(&sem_bpt_enter_mode_cal);
@@ -108,7 +162,14 @@ void hpi_decode_data_packet(uint8_t *in_pkt_buf, uint8_t pkt_len)
     case HPI_CMD_LOG_GET_INDEX:
         LOG_DBG("RX CMD Get Index: %d", in_pkt_buf[1]);
         log_type = in_pkt_buf[1];
-        log_get_index(log_type);
+        if (pkt_len >= HPI_CMD_INDEX_PAGE_PKT_LEN)
+        {
+            log_get_index_page(log_type, (int64_t)sys_get_le64(&in_pkt_buf[2]), sys_get_le16(&in_pkt_buf[10]));
+        }
+        else
+        {
+            log_get_index(log_type);
+        }
         break;
     case HPI_CMD_LOG_GET_FILE:
         LOG_DBG("RX CMD Get Log");
@@ -118,12 +179,23 @@ void hpi_decode_data_packet(uint8_t *in_pkt_buf, uint8_t pkt_len)
         {
             log_id_int64 |= ((int64_t)in_pkt_buf[2 + i] << (8 * i));
         }
-        log_get(log_type, log_id_int64);
+        if (pkt_len >= HPI_CMD_FETCH_RANGE_PKT_LEN)
+        {
+            log_get_range(log_type, log_id_int64, sys_get_le32(&in_pkt_buf[10]), sys_get_le32(&in_pkt_buf[14]));
+        }
+        else
+        {
+            log_get(log_type, log_id_int64);
+        }
         break;
     case HPI_CMD_LOG_DELETE:
         LOG_DBG("RX CMD Log delete");
         log_delete((in_pkt_buf[1] | (in_pkt_buf[2] << 8)));
         break;
+    case HPI_CMD_LOG_GET_FLASH_STATS:
+        LOG_DBG("RX CMD Get Flash Stats: %X", in_pkt_buf[1]);
+        hpi_cmd_send_flash_stats(in_pkt_buf[1], (pkt_len > 2) && (in_pkt_buf[2] != 0));
+        break;
     case HPI_CMD_LOG_WIPE_ALL:
         LOG_DBG("RX CMD Log Wipe");
         log_wipe_trends();
@@ -138,7 +210,14 @@ void hpi_decode_data_packet(uint8_t *in_pkt_buf, uint8_t pkt_len)
     case HPI_CMD_RECORDING_INDEX:
         LOG_DBG("RX CMD Recording Index");
         recording_type = in_pkt_buf[1];
-        log_get_index(recording_type);
+        if (pkt_len >= HPI_CMD_INDEX_PAGE_PKT_LEN)
+        {
+            log_get_index_page(recording_type, (int64_t)sys_get_le64(&in_pkt_buf[2]), sys_get_le16(&in_pkt_buf[10]));
+        }
+        else
+        {
+            log_get_index(recording_type);
+        }
         break;
     case HPI_CMD_RECORDING_FETCH_FILE:
         LOG_DBG("RX CMD Recording Fetch File");
@@ -148,7 +227,14 @@ void hpi_decode_data_packet(uint8_t *in_pkt_buf, uint8_t pkt_len)
         {
             recording_id_int64 |= ((int64_t)in_pkt_buf[2 + i] << (8 * i));
         }
-        log_get(recording_type, recording_id_int64);
+        if (pkt_len >= HPI_CMD_FETCH_RANGE_PKT_LEN)
+        {
+            log_get_range(recording_type, recording_id_int64, sys_get_le32(&in_pkt_buf[10]), sys_get_le32(&in_pkt_buf[14]));
+        }
+        else
+        {
+            log_get(recording_type, recording_id_int64);
+        }
         break;
     case HPI_CMD_RECORDING_DELETE:
         LOG_DBG("RX CMD Recording Delete");
@@ -194,6 +280,91 @@ void cmdif_send_ble_data_idx(uint8_t *m_data, uint8_t m_data_len)
     hpi_ble_send_data(cmd_pkt, 1 + m_data_len);
 }
 
+// Send a page of the log index packed into as few notifications as the MTU
+// allows, followed by an end-of-index marker
+void cmdif_send_ble_idx_page(uint8_t m_log_type, const struct hpi_log_index_t *m_entries, uint16_t m_count, bool m_more)
+{
+    static uint8_t idx_pkt[CONFIG_BT_L2CAP_TX_MTU - 3];
+    uint16_t per_pkt = (MIN(hpi_ble_get_max_payload(), sizeof(idx_pkt)) - 2) / HPI_FILE_IDX_SIZE;
+    uint16_t sent = 0;
+
+    if (per_pkt == 0)
+    {
+        LOG_ERR("No connection for index");
+        return;
+    }
+
+    hpi_ble_bulk_begin();
+
+    while (sent < m_count)
+    {
+        uint8_t n = MIN(per_pkt, m_count - sent);
+
+        idx_pkt[0] = CES_CMDIF_TYPE_LOG_IDX_BATCH;
+        idx_pkt[1] = n;
+        for (int i = 0; i < n; i++)
+        {
+            memcpy(&idx_pkt[2 + i * HPI_FILE_IDX_SIZE], &m_entries[sent + i], HPI_FILE_IDX_SIZE);
+        }
+
+        if (hpi_ble_send_data_bulk(idx_pkt, 2 + n * HPI_FILE_IDX_SIZE) < 0)
+        {
+            break;
+        }
+        sent += n;
+    }
+
+    idx_pkt[0] = CES_CMDIF_TYPE_LOG_IDX_END;
+    idx_pkt[1] = m_log_type;
+    sys_put_le16(sent, &idx_pkt[2]);
+    idx_pkt[4] = m_more ? 1 : 0;
+    hpi_ble_send_data_bulk(idx_pkt, 5);
+
+    hpi_ble_bulk_end();
+}
+
+// Send the stats of one key as bulk notifications, as many fields per
+// packet as the MTU allows. Must be called between hpi_ble_bulk_begin()
+// and hpi_ble_bulk_end().
+int cmdif_send_ble_flash_stats(uint8_t m_key, const struct hpi_flash_io_stats_t *m_stats)
+{
+    uint8_t stats_pkt[4 + sizeof(*m_stats)];
+    const uint32_t *fields = (const uint32_t *)m_stats;
+    const uint8_t num_fields = sizeof(*m_stats) / sizeof(uint32_t);
+    uint16_t max_payload = MIN(hpi_ble_get_max_payload(), sizeof(stats_pkt));
+    uint16_t per_pkt = (max_payload > 4) ? (max_payload - 4) / sizeof(uint32_t) : 0;
+    uint8_t sent = 0;
+
+    if (per_pkt == 0)
+    {
+        LOG_ERR("No connection for flash stats");
+        return -ENOTCONN;
+    }
+
+    while (sent < num_fields)
+    {
+        uint8_t n = MIN(per_pkt, num_fields - sent);
+
+        stats_pkt[0] = CES_CMDIF_TYPE_FLASH_STATS;
+        stats_pkt[1] = m_key;
+        stats_pkt[2] = sent;
+        stats_pkt[3] = n;
+        for (int i = 0; i < n; i++)
+        {
+            sys_put_le32(fields[sent + i], &stats_pkt[4 + i * sizeof(uint32_t)]);
+        }
+
+        int ret = hpi_ble_send_data_bulk(stats_pkt, 4 + n * sizeof(uint32_t));
+        if (ret < 0)
+        {
+            return ret;
+        }
+        sent += n;
+    }
+
+    return 0;
+}
+
 void hpi_cmdif_send_count_rsp(uint8_t m_cmd, uint8_t m_log_type, uint16_t m_value)
 {
     LOG_DBG("Sending BLE Command Response: %X %X\n", m_cmd, m_value);
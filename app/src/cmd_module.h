@@ -59,20 +59,22 @@ enum hpi_cmds
     HPI_CMD_PAIR_DEVICE = 0x43,
     HPI_CMD_UNPAIR_DEVICE = 0x44,
     HPI_CMD_PAIR_CHECK_PIN = 0x45,
+    HPI_CMD_SET_ECG_BIOZ_RATE = 0x46, // Needs ECG rate (uint16 SPS) and BioZ rate (uint8 SPS)
 
-    HPI_CMD_LOG_GET_INDEX = 0x50, // No arguments
-    HPI_CMD_LOG_GET_FILE = 0x51,  // Needs session ID (uint16) as argument
+    HPI_CMD_LOG_GET_INDEX = 0x50, // Needs log type (uint8), optional start-after (int64) and max count (uint16)
+    HPI_CMD_LOG_GET_FILE = 0x51,  // Needs log type (uint8) and file ID (int64), optional offset/length (uint32 each)
     HPI_CMD_LOG_DELETE = 0x52,    // Needs session ID (uint16) as argument
     HPI_CMD_LOG_WIPE_ALL = 0x53,  // No arguments
     HPI_CMD_LOG_GET_COUNT = 0x54, // No arguments
+    HPI_CMD_LOG_GET_FLASH_STATS = 0x55, // Needs stats key (uint8, log type or 0xFF for all), optional reset flag (uint8)
 
     HPI_CMD_BPT_SEL_CAL_MODE = 0x60,
     HPI_CMD_START_BPT_CAL_START = 0x61, // Needs Sys/Diastolic (as uint8/uint8) as argument
     HPI_CMD_BPT_EXIT_CAL_MODE = 0x62,
 
     HPI_CMD_RECORDING_COUNT = 0x30,      // Needs recording type (uint8) as argument
-    HPI_CMD_RECORDING_INDEX = 0x31,      // Needs recording type (uint8) as argument
-    HPI_CMD_RECORDING_FETCH_FILE = 0x32, // Needs recording type (uint8) as argument
+    HPI_CMD_RECORDING_INDEX = 0x31,      // Needs recording type (uint8), optional start-after (int64) and max count (uint16)
+    HPI_CMD_RECORDING_FETCH_FILE = 0x32, // Needs recording type (uint8) and file ID (int64), optional offset/length (uint32 each)
     HPI_CMD_RECORDING_DELETE = 0x33,     // Needs recording type (uint8) as argument
     HPI_CMD_RECORDING_WIPE_ALL = 0x34, // No arguments
 };
@@ -86,6 +88,12 @@ enum cmdif_pkt_type
 
     CES_CMDIF_TYPE_LOG_IDX = 0x05,
     CES_CMDIF_TYPE_CMD_RSP = 0x06,
+    CES_CMDIF_TYPE_DATA_RANGE = 0x07, // uint32 file offset + data
+    CES_CMDIF_TYPE_DATA_CRC = 0x08,   // uint32 window offset, uint32 window length, uint32 CRC32
+    CES_CMDIF_TYPE_LOG_IDX_BATCH = 0x09, // uint8 count + count * HPI_FILE_IDX_SIZE index records
+    CES_CMDIF_TYPE_LOG_IDX_END = 0x0A,   // uint8 log type, uint16 records sent, uint8 more pages
+    CES_CMDIF_TYPE_FLASH_STATS = 0x0B,   // uint8 stats key, uint8 first field, uint8 count + count fields of
+                                         // struct hpi_flash_io_stats_t as uint32 LE, split to fit the MTU
 };
 
 enum ble_status
@@ -107,4 +115,8 @@ struct hpi_cmd_data_obj_t
 void cmdif_send_ble_data(uint8_t *m_data, uint8_t m_data_len);
 void hpi_cmdif_send_count_rsp(uint8_t m_cmd, uint8_t m_log_type, uint16_t m_value);
 void cmdif_send_ble_data_idx(uint8_t *m_data, uint8_t m_data_len);
+struct hpi_log_index_t;
+struct hpi_flash_io_stats_t;
+int cmdif_send_ble_flash_stats(uint8_t m_key, const struct hpi_flash_io_stats_t *m_stats);
+void cmdif_send_ble_idx_page(uint8_t m_log_type, const struct hpi_log_index_t *m_entries, uint16_t m_count, bool m_more);
 void hpi_bpt_set_cal_vals(uint8_t cal_index, uint8_t cal_sys, uint8_t cal_dia);
\ No newline at end of file
@@ -50,6 +50,10 @@ LOG_MODULE_REGISTER(data_module, LOG_LEVEL_DBG);
 #include "hpi_sys.h"
 
 #include "log_module.h"
+#include "hpi_sample_pool.h"
+#include "hpi_record_codec.h"
+#include "hrv_module.h"
+#include "ecg_filter.h"
 
 #if defined(CONFIG_HPI_GSR_STRESS_INDEX)
 ZBUS_CHAN_DECLARE(gsr_stress_chan);
@@ -65,6 +69,19 @@ ZBUS_CHAN_DECLARE(gsr_stress_chan);
 #define LOG_SAMPLE_RATE_SPS 125
 #define SAMPLE_BUFF_WATERMARK 8
 
+// Max messages taken from one producer queue per data thread wakeup
+#define DATA_THREAD_MAX_BATCH 8
+#define DATA_WAKEUP_REPORT_INTERVAL_S 60
+
+enum data_thread_events
+{
+    DATA_EVT_ECG,
+    DATA_EVT_BIOZ,
+    DATA_EVT_PPG_FI,
+    DATA_EVT_PPG_WR,
+    DATA_EVT_COUNT,
+};
+
 char DataPacket[DATA_LEN];
 const char DataPacketFooter[2] = {0, CES_CMDIF_PKT_STOP};
 const char DataPacketHeader[5] = {CES_CMDIF_PKT_START_1, CES_CMDIF_PKT_START_2, DATA_LEN, 0, CES_CMDIF_TYPE_DATA};
@@ -91,16 +108,35 @@ uint16_t current_session_log_counter = 0;
 uint16_t current_session_log_id = 0;
 char session_id_str[5];
 
+// Streaming ECG recorder: samples are packed into fixed-size chunks that the
+// background record writer appends to /lfs/ecg/, so RAM use is independent
+// of the recording length. With CONFIG_HPI_RECORD_COMPRESSION the samples are
+// first gathered into codec blocks and the chunks carry the encoded stream.
 static bool is_ecg_record_active = false;
-static int32_t ecg_record_buffer[ECG_RECORD_BUFFER_SAMPLES]; // 128 Hz * 30 seconds = 3840 samples (15.36KB)
-static volatile uint16_t ecg_record_counter = 0;
+static uint8_t *ecg_record_chunk = NULL;    // Chunk currently being filled
+static uint16_t ecg_record_chunk_fill = 0;  // Bytes in ecg_record_chunk
+#if defined(CONFIG_HPI_RECORD_COMPRESSION)
+static int32_t ecg_record_block[HPI_RECORD_CODEC_BLOCK_SAMPLES];
+static uint16_t ecg_record_block_fill = 0;  // Samples in ecg_record_block
+static uint8_t ecg_record_enc[HPI_RECORD_CODEC_MAX_BLOCK_BYTES];
+#endif
+static uint32_t ecg_record_counter = 0;     // Samples recorded so far
+static uint16_t ecg_record_rate = ECG_SAMPLE_RATE_SPS; // SPS of the file being written
+static bool ecg_record_aborted = false;     // Stopped by data_thread, file not discarded yet
 K_MUTEX_DEFINE(mutex_is_ecg_record_active);
+// Serialises record start, stop and reset. Those queue record control jobs,
+// which can wait on the storage queue, so they run with only this held and
+// take mutex_is_ecg_record_active just to hand the record over.
+K_MUTEX_DEFINE(mutex_ecg_record_ctrl);
 
 static bool is_gsr_measurement_active = false;
 K_MUTEX_DEFINE(mutex_is_gsr_measurement_active);
 
 static uint32_t last_hr_update_time = 0;
 
+// Number of times data_thread returned from k_poll(), for idle power profiling
+static atomic_t data_thread_wakeups = ATOMIC_INIT(0);
+
 K_MUTEX_DEFINE(mutex_hr_change);
 
 // Externs
@@ -120,6 +156,8 @@ extern struct k_msgq q_plot_ppg_fi;
 extern struct k_msgq q_plot_hrv;
 extern struct k_msgq q_plot_gsr;
 
+extern struct k_sem sem_ecg_complete;
+
 void sendData(int32_t ecg_sample, int32_t bioz_sample, uint32_t raw_red, uint32_t raw_ir, int32_t temp, uint8_t hr,
               uint8_t bpt_status, uint8_t spo2, bool _bioZSkipSample)
 {
@@ -222,66 +260,307 @@ void send_data_text_1(int32_t in_sample)
     send_usb_cdc(data, strlen(data));
 }
 
-void hpi_data_set_ecg_record_active(bool active)
+// Hand the partially filled chunk to the writer, or free it if nothing is in
+// it. Returns false if the writer's queue was full and the data was lost.
+static bool ecg_record_flush_chunk(void)
 {
-    k_mutex_lock(&mutex_is_ecg_record_active, K_FOREVER);
-    is_ecg_record_active = active;
+    int ret = 0;
 
-    if (active)
+    if (ecg_record_chunk != NULL && ecg_record_chunk_fill > 0)
     {
-        // Starting new recording - reset buffer and counter
-        ecg_record_counter = 0;
-        memset(ecg_record_buffer, 0, sizeof(ecg_record_buffer));
-        LOG_INF("ECG recording started - buffer reset");
+        ret = hpi_record_write_chunk(ecg_record_chunk, ecg_record_chunk_fill);
     }
     else
     {
-        // Stopping recording - write file SYNCHRONOUSLY with mutex held
-        // This prevents race condition where new recording could start before write completes
-        if (ecg_record_counter > 0)
+        hpi_record_chunk_free(ecg_record_chunk);
+    }
+    ecg_record_chunk = NULL;
+    ecg_record_chunk_fill = 0;
+
+    return ret == 0;
+}
+
+static void ecg_record_drop_chunk(void)
+{
+    hpi_record_chunk_free(ecg_record_chunk);
+    ecg_record_chunk = NULL;
+    ecg_record_chunk_fill = 0;
+#if defined(CONFIG_HPI_RECORD_COMPRESSION)
+    ecg_record_block_fill = 0;
+#endif
+}
+
+// Most chunks one ecg_record_put() call can span
+#define ECG_RECORD_PUT_MAX_CHUNKS 2
+
+BUILD_ASSERT(HPI_RECORD_CODEC_MAX_BLOCK_BYTES <= ECG_RECORD_PUT_MAX_CHUNKS * HPI_RECORD_CHUNK_SIZE &&
+                 sizeof(((struct hpi_ecg_bioz_sensor_data_t *)0)->ecg_samples) <= HPI_RECORD_CHUNK_SIZE,
+             "ecg_record_put() data must fit in ECG_RECORD_PUT_MAX_CHUNKS chunks");
+
+// Append bytes to the record, handing each full chunk to the writer. Either
+// all of the data is queued or, if the chunk pool is short, none of it, so a
+// record never holds a partial sample or codec block. Also fails if a full
+// chunk couldn't be queued; the record then has a gap and must be aborted.
+static bool ecg_record_put(const void *data, size_t len)
+{
+    const uint8_t *src = data;
+    uint8_t *spare[ECG_RECORD_PUT_MAX_CHUNKS];
+    size_t room = (ecg_record_chunk != NULL) ? (HPI_RECORD_CHUNK_SIZE - ecg_record_chunk_fill) : 0;
+    int needed = (len > room) ? DIV_ROUND_UP(len - room, HPI_RECORD_CHUNK_SIZE) : 0;
+    int next = 0;
+
+    for (int i = 0; i < needed; i++)
+    {
+        spare[i] = hpi_record_chunk_alloc();
+        if (spare[i] == NULL)
         {
-            // Validate counter is within bounds before writing
-            if (ecg_record_counter > ECG_RECORD_BUFFER_SAMPLES) {
-                LOG_ERR("ECG counter overflow detected: %d > %d - clamping to max",
-                        ecg_record_counter, ECG_RECORD_BUFFER_SAMPLES);
-                ecg_record_counter = ECG_RECORD_BUFFER_SAMPLES;
+            while (i-- > 0)
+            {
+                hpi_record_chunk_free(spare[i]);
             }
-            
-            struct tm tm_sys_time = hpi_sys_get_sys_time();
-            int64_t log_time = timeutil_timegm64(&tm_sys_time);
-            
-            LOG_INF("ECG recording stopped - writing %d samples to file (%.1f seconds @ 128Hz)", 
-                    ecg_record_counter, (float)ecg_record_counter / 128.0f);
-            
-            // Write actual collected samples, not full buffer size
-            hpi_write_ecg_record_file(ecg_record_buffer, ecg_record_counter, log_time);
-            
-            LOG_INF("ECG file write completed");
+            return false;
         }
-        else
+    }
+
+    while (len > 0)
+    {
+        if (ecg_record_chunk == NULL)
         {
-            LOG_WRN("ECG recording stopped but no samples collected");
+            ecg_record_chunk = spare[next++];
+        }
+
+        size_t n = MIN(len, HPI_RECORD_CHUNK_SIZE - ecg_record_chunk_fill);
+        memcpy(&ecg_record_chunk[ecg_record_chunk_fill], src, n);
+        ecg_record_chunk_fill += n;
+        src += n;
+        len -= n;
+
+        if (ecg_record_chunk_fill >= HPI_RECORD_CHUNK_SIZE && !ecg_record_flush_chunk())
+        {
+            while (next < needed)
+            {
+                hpi_record_chunk_free(spare[next++]);
+            }
+            return false;
         }
     }
-    k_mutex_unlock(&mutex_is_ecg_record_active);
+
+    return true;
+}
+
+// A record is one continuous stretch of ECG. If the writer falls far enough
+// behind that samples would be dropped, the file would splice across the gap,
+// so the record is thrown away instead; the state machine sees recording stop.
+// The discard itself is queued by the next stop or start, so data_thread never
+// waits on the storage queue.
+static void ecg_record_abort(void)
+{
+    LOG_ERR("ECG record writer fell behind after %u samples - record discarded", ecg_record_counter);
+    ecg_record_drop_chunk();
+    is_ecg_record_active = false;
+    ecg_record_aborted = true;
+}
+
+#if defined(CONFIG_HPI_RECORD_COMPRESSION)
+static bool ecg_record_encode_block(void)
+{
+    if (ecg_record_block_fill == 0)
+    {
+        return true;
+    }
+
+    size_t len = hpi_record_codec_encode_block(ecg_record_block, ecg_record_block_fill, ecg_record_enc);
+
+    if (!ecg_record_put(ecg_record_enc, len))
+    {
+        ecg_record_abort();
+        return false;
+    }
+    ecg_record_block_fill = 0;
+    return true;
+}
+#else
+static bool ecg_record_put_samples(const int32_t *samples, uint32_t num_samples)
+{
+    if (!ecg_record_put(samples, num_samples * sizeof(int32_t)))
+    {
+        // Writer has fallen behind the flash; don't block the data thread
+        ecg_record_abort();
+        return false;
+    }
+    return true;
 }
+#endif
 
-void hpi_data_reset_ecg_record_buffer(void)
+// Take the record away from data_thread. Returns true if there is a file
+// left that the caller has to discard once the mutex is released.
+static bool ecg_record_take_locked(void)
 {
+    bool discard = is_ecg_record_active || ecg_record_aborted;
+
+    ecg_record_drop_chunk();
+    is_ecg_record_active = false;
+    ecg_record_aborted = false;
+
+    return discard;
+}
+
+// Open a new record file and hand it to data_thread. Called with only
+// mutex_ecg_record_ctrl held, since the open is queued to the storage thread.
+// With compression the header's chunk is reserved before the file is opened,
+// so a record never exists without its header.
+static int ecg_record_start_file(void)
+{
+    uint16_t rate = hpi_ecg_get_sample_rate();
+    uint8_t *hdr_chunk = NULL;
+    uint16_t hdr_len = 0;
+
+#if defined(CONFIG_HPI_RECORD_COMPRESSION)
+    struct hpi_record_codec_file_hdr_t hdr;
+
+    hdr_chunk = hpi_record_chunk_alloc();
+    if (hdr_chunk == NULL)
+    {
+        LOG_ERR("ECG record chunk pool empty - record not started");
+        return -ENOMEM;
+    }
+    hpi_record_codec_file_hdr(&hdr, HPI_LOG_TYPE_ECG_RECORD, rate);
+    memcpy(hdr_chunk, &hdr, sizeof(hdr));
+    hdr_len = sizeof(hdr);
+#endif
+
+    int ret = hpi_record_open(HPI_LOG_TYPE_ECG_RECORD, hw_get_sys_time_ts());
+    if (ret != 0)
+    {
+        LOG_ERR("ECG record open failed (%d) - record not started", ret);
+        hpi_record_chunk_free(hdr_chunk);
+        return ret;
+    }
+
     k_mutex_lock(&mutex_is_ecg_record_active, K_FOREVER);
-    // Reset buffer and counter without saving (for lead-off restart)
+    ecg_record_drop_chunk();
+    ecg_record_chunk = hdr_chunk;
+    ecg_record_chunk_fill = hdr_len;
     ecg_record_counter = 0;
-    memset(ecg_record_buffer, 0, sizeof(ecg_record_buffer));
-    LOG_INF("ECG recording buffer reset (discard incomplete data)");
+    ecg_record_rate = rate;
+    is_ecg_record_active = true;
+    k_mutex_unlock(&mutex_is_ecg_record_active);
+
+    return 0;
+}
+
+int hpi_data_set_ecg_record_active(bool active)
+{
+    bool close = false;
+    bool discard = false;
+    bool aborted;
+    uint32_t samples;
+    uint16_t rate;
+    int ret = 0;
+
+    k_mutex_lock(&mutex_ecg_record_ctrl, K_FOREVER);
+
+    k_mutex_lock(&mutex_is_ecg_record_active, K_FOREVER);
+    if (!active && is_ecg_record_active && ecg_record_counter > 0)
+    {
+        // Stopping recording - only the last partial chunk is left to queue,
+        // the record writer finishes the file in the background
+#if defined(CONFIG_HPI_RECORD_COMPRESSION)
+        ecg_record_encode_block();
+#endif
+        if (is_ecg_record_active)
+        {
+            if (ecg_record_flush_chunk())
+            {
+                is_ecg_record_active = false;
+                close = true;
+            }
+            else
+            {
+                // The tail was lost, so don't keep a short record
+                ecg_record_abort();
+            }
+        }
+    }
+    // Starting a new recording drops anything left from a previous one
+    aborted = ecg_record_aborted;
+    samples = ecg_record_counter;
+    rate = ecg_record_rate;
+    discard = ecg_record_take_locked();
+    k_mutex_unlock(&mutex_is_ecg_record_active);
+
+    if (close)
+    {
+        hpi_record_close();
+        LOG_INF("ECG recording stopped - %u samples (%.1f seconds @ %dHz)", samples, (double)samples / rate, rate);
+    }
+    else if (discard)
+    {
+        hpi_record_discard();
+        if (aborted)
+        {
+            ret = -ENOMEM;
+        }
+        else if (!active)
+        {
+            LOG_WRN("ECG recording stopped but no samples collected");
+        }
+    }
+
+    if (active)
+    {
+        ret = ecg_record_start_file();
+        if (ret == 0)
+        {
+            LOG_INF("ECG recording started - streaming up to %d s at %u SPS to flash", ECG_RECORD_DURATION_S,
+                    ecg_record_rate);
+        }
+    }
+
+    k_mutex_unlock(&mutex_ecg_record_ctrl);
+    return ret;
+}
+
+int hpi_data_reset_ecg_record_buffer(void)
+{
+    int ret = 0;
+
+    k_mutex_lock(&mutex_ecg_record_ctrl, K_FOREVER);
+
+    k_mutex_lock(&mutex_is_ecg_record_active, K_FOREVER);
+    bool active = is_ecg_record_active;
+    if (active)
+    {
+        ecg_record_take_locked();
+    }
     k_mutex_unlock(&mutex_is_ecg_record_active);
+
+    if (active)
+    {
+        // Throw away what was streamed so far (for lead-off restart) and
+        // start over in a fresh file
+        hpi_record_discard();
+        ret = ecg_record_start_file();
+        if (ret == 0)
+        {
+            LOG_INF("ECG recording reset (discard incomplete data)");
+        }
+    }
+
+    k_mutex_unlock(&mutex_ecg_record_ctrl);
+    return ret;
 }
 
+// Reports the state after any start, stop or reset in progress, so a
+// restart never shows up as a stopped recording
 bool hpi_data_is_ecg_record_active(void)
 {
     bool active;
+    k_mutex_lock(&mutex_ecg_record_ctrl, K_FOREVER);
     k_mutex_lock(&mutex_is_ecg_record_active, K_FOREVER);
     active = is_ecg_record_active;
     k_mutex_unlock(&mutex_is_ecg_record_active);
+    k_mutex_unlock(&mutex_ecg_record_ctrl);
     return active;
 }
 
@@ -301,221 +580,291 @@ bool hpi_data_is_gsr_measurement_active(void)
     return active;
 }
 
-void data_thread(void)
+static void data_process_ecg_sample(struct hpi_sample_block *blk)
 {
-    struct hpi_ecg_bioz_sensor_data_t ecg_sensor_sample;
-    struct hpi_ppg_wr_data_t ppg_wr_sensor_sample;
-    struct hpi_ppg_fi_data_t ppg_fi_sensor_sample;
-    struct hpi_bioz_sample_t bsample;
+    struct hpi_ecg_bioz_sensor_data_t *ecg_sensor_sample = &blk->ecg;
 
-    static uint32_t hr_zbus_last_pub_time = 0;
-
-    LOG_INF("Data Thread starting");
-
-    for (;;)
+    if (settings_send_ble_enabled)
     {
-        bool processed_data = false;
-
-        // Process all available ECG samples (unchanged)
-        if (k_msgq_get(&q_ecg_sample, &ecg_sensor_sample, K_NO_WAIT) == 0)
+        ble_ecg_notify(ECG_BLE_SAMPLES(ecg_sensor_sample), ecg_sensor_sample->ecg_num_samples);
+        ble_gsr_notify(ecg_sensor_sample->ecg_samples, ecg_sensor_sample->ecg_num_samples);
+    }
+    if (settings_plot_enabled)
+    {
+        // The plot queue holds its own reference to the block
+        hpi_sample_block_ref(blk);
+        int ret = k_msgq_put(&q_plot_ecg, &blk, K_NO_WAIT);
+        if (ret != 0)
         {
-            processed_data = true;
-            if (settings_send_ble_enabled)
-            {
+            hpi_sample_block_unref(blk);
 
-                ble_ecg_notify(ecg_sensor_sample.ecg_samples, ecg_sensor_sample.ecg_num_samples);
-                ble_gsr_notify(ecg_sensor_sample.ecg_samples, ecg_sensor_sample.ecg_num_samples);
-            }
-            if (settings_plot_enabled)
+            static uint32_t plot_drops = 0;
+            plot_drops++;
+            if ((plot_drops % 10) == 0)
             {
-                int ret = k_msgq_put(&q_plot_ecg, &ecg_sensor_sample, K_NO_WAIT);
-                if (ret != 0)
-                {
-                    static uint32_t plot_drops = 0;
-                    plot_drops++;
-                    if ((plot_drops % 10) == 0)
-                    {
-                        LOG_WRN("Plot queue full - dropped %u ECG sample batches", plot_drops);
-                    }
-                }
+                LOG_WRN("Plot queue full - dropped %u ECG sample batches", plot_drops);
             }
+        }
+    }
 
-            // ECG recording buffer management with mutex protection
-            // Fixed: No circular buffer - linear recording only, stop when full
-            k_mutex_lock(&mutex_is_ecg_record_active, K_FOREVER);
-            if (is_ecg_record_active == true)
-            {
-                int samples_to_copy = ecg_sensor_sample.ecg_num_samples;
-                int space_left = ECG_RECORD_BUFFER_SAMPLES - ecg_record_counter;
-
-                // Defensive check: prevent counter from exceeding buffer size
-                if (ecg_record_counter >= ECG_RECORD_BUFFER_SAMPLES) {
-                    LOG_ERR("ECG buffer counter overflow detected: %d >= %d - stopping recording",
-                            ecg_record_counter, ECG_RECORD_BUFFER_SAMPLES);
-                    extern struct k_sem sem_ecg_complete;
-                    k_sem_give(&sem_ecg_complete);
-                    k_mutex_unlock(&mutex_is_ecg_record_active);
-                    continue;  // Skip this sample batch
-                }
-
-                if (samples_to_copy <= space_left)
-                {
-                    // Copy samples to buffer
-                    memcpy(&ecg_record_buffer[ecg_record_counter], 
-                           ecg_sensor_sample.ecg_samples, 
-                           samples_to_copy * sizeof(int32_t));
-                    ecg_record_counter += samples_to_copy;
-                    
-                    // Check if buffer is exactly full
-                    if (ecg_record_counter >= ECG_RECORD_BUFFER_SAMPLES)
-                    {
-                        LOG_INF("ECG buffer full - collected %d samples (30.0 seconds @ 128Hz)", 
-                                ecg_record_counter);
-                        LOG_INF("Signaling state machine to stop recording");
-                        
-                        // Signal state machine that buffer is full
-                        // State machine will call hpi_data_set_ecg_record_active(false)
-                        // which will write the file synchronously
-                        extern struct k_sem sem_ecg_complete;
-                        k_sem_give(&sem_ecg_complete);
-                    }
-                }
-                else
-                {
-                    // Not enough space - copy what fits and stop
-                    if (space_left > 0)
-                    {
-                        memcpy(&ecg_record_buffer[ecg_record_counter], 
-                               ecg_sensor_sample.ecg_samples, 
-                               space_left * sizeof(int32_t));
-                        ecg_record_counter += space_left;
-                    }
-                    
-                    LOG_WRN("ECG buffer full mid-batch - collected %d samples, discarded %d", 
-                            ecg_record_counter, samples_to_copy - space_left);
-                    LOG_INF("Signaling state machine to stop recording");
-                    
-                    // Signal completion
-                    extern struct k_sem sem_ecg_complete;
-                    k_sem_give(&sem_ecg_complete);
-                }
-            }
-            k_mutex_unlock(&mutex_is_ecg_record_active);
+    // A beat was detected since the last batch; HRV runs on its own thread.
+    // Beats either side of a lead-off gap don't form a continuous series.
+    static bool hrv_lead_off = true;
+    if (ecg_sensor_sample->ecg_lead_off)
+    {
+        if (!hrv_lead_off)
+        {
+            hpi_hrv_reset();
         }
+        hrv_lead_off = true;
+    }
+    else
+    {
+        hrv_lead_off = false;
+#if !defined(CONFIG_HPI_ECG_RPEAK_DETECTOR)
+        // Without the on-device detector, fall back to the 8 ms RTOR value
+        if (ecg_sensor_sample->rrint)
+        {
+            hpi_hrv_submit_rr(ecg_sensor_sample->rtor);
+        }
+#endif
+    }
+
+    // Stream samples into record chunks; full chunks go to the background writer
+    k_mutex_lock(&mutex_is_ecg_record_active, K_FOREVER);
+    if (is_ecg_record_active == true && ecg_record_counter < ECG_RECORD_MAX_SAMPLES(ecg_record_rate))
+    {
+        const int32_t *src = ECG_RECORD_SAMPLES(ecg_sensor_sample);
+        uint32_t remaining = MIN(ecg_sensor_sample->ecg_num_samples,
+                                 ECG_RECORD_MAX_SAMPLES(ecg_record_rate) - ecg_record_counter);
 
-        if (k_msgq_get(&q_bioz_sample, &bsample, K_NO_WAIT) == 0)
+#if defined(CONFIG_HPI_RECORD_COMPRESSION)
+        while (remaining > 0)
         {
-            processed_data = true;
-            if (settings_send_ble_enabled)
+            uint32_t n = MIN(remaining, HPI_RECORD_CODEC_BLOCK_SAMPLES - ecg_record_block_fill);
+            memcpy(&ecg_record_block[ecg_record_block_fill], src, n * sizeof(int32_t));
+            ecg_record_block_fill += n;
+            ecg_record_counter += n;
+            src += n;
+            remaining -= n;
+
+            if (ecg_record_block_fill >= HPI_RECORD_CODEC_BLOCK_SAMPLES && !ecg_record_encode_block())
             {
-                ble_gsr_notify(bsample.bioz_samples, bsample.bioz_num_samples);
+                break;
             }
-            if (settings_plot_enabled)
+        }
+#else
+        if (ecg_record_put_samples(src, remaining))
+        {
+            ecg_record_counter += remaining;
+        }
+#endif
+
+        if (is_ecg_record_active && ecg_record_counter >= ECG_RECORD_MAX_SAMPLES(ecg_record_rate))
+        {
+            LOG_INF("ECG recording complete - collected %u samples (%d seconds @ %dHz)",
+                    ecg_record_counter, ECG_RECORD_DURATION_S, ecg_record_rate);
+
+            // Signal state machine that the recording length was reached.
+            // State machine will call hpi_data_set_ecg_record_active(false)
+            k_sem_give(&sem_ecg_complete);
+        }
+    }
+    k_mutex_unlock(&mutex_is_ecg_record_active);
+}
+
+static void data_process_bioz_sample(struct hpi_bioz_sample_t *bsample)
+{
+    if (settings_send_ble_enabled)
+    {
+        ble_gsr_notify(bsample->bioz_samples, bsample->bioz_num_samples);
+    }
+    if (settings_plot_enabled)
+    {
+        int ret = k_msgq_put(&q_plot_gsr, bsample, K_NO_WAIT);
+        if (ret != 0)
+        {
+            static uint32_t plot_drops = 0;
+            plot_drops++;
+            if ((plot_drops % 10) == 0)
             {
-                int ret = k_msgq_put(&q_plot_gsr, &bsample, K_NO_WAIT);
-                if (ret != 0)
-                {
-                    static uint32_t plot_drops = 0;
-                    plot_drops++;
-                    if ((plot_drops % 10) == 0)
-                    {
-                        LOG_WRN("Plot queue full - dropped %u GSR sample batches", plot_drops);
-                    }
-                }
+                LOG_WRN("Plot queue full - dropped %u GSR sample batches", plot_drops);
             }
+        }
+    }
 
 #if defined(CONFIG_HPI_GSR_STRESS_INDEX)
-            // Calculate stress index from GSR samples
-            if (is_gsr_measurement_active && bsample.bioz_num_samples > 0)
-            {
-                // Convert raw BioZ sample to GSR conductance value (μS * 100)
-                // MAX30001 BioZ output needs calibration - using average of samples
-                int32_t sum = 0;
-                for (uint8_t i = 0; i < bsample.bioz_num_samples; i++)
-                {
-                    sum += bsample.bioz_samples[i];
-                }
-                int32_t avg_bioz = sum / bsample.bioz_num_samples;
-
-                // Convert to GSR: Simplified linear mapping (tune based on calibration)
-                // Assuming ~10kΩ corresponds to ~10μS, adjust scaling as needed
-                uint16_t gsr_value_x100 = (uint16_t)((avg_bioz / 100) + 1000); // Offset + scale
-
-                // Update last GSR value
-                hpi_sys_set_last_gsr_update(gsr_value_x100, bsample.timestamp);
-
-                // Calculate and publish stress index
-                static struct hpi_gsr_stress_index_t stress_data = {0};
-                calculate_gsr_stress_index(gsr_value_x100, &stress_data);
-
-                if (stress_data.stress_data_ready)
-                {
-                    zbus_chan_pub(&gsr_stress_chan, &stress_data, K_NO_WAIT);
-                }
-            }
+    // Calculate stress index from GSR samples
+    if (is_gsr_measurement_active && bsample->bioz_num_samples > 0)
+    {
+        // Convert raw BioZ sample to GSR conductance value (μS * 100)
+        // MAX30001 BioZ output needs calibration - using average of samples
+        int32_t sum = 0;
+        for (uint8_t i = 0; i < bsample->bioz_num_samples; i++)
+        {
+            sum += bsample->bioz_samples[i];
+        }
+        int32_t avg_bioz = sum / bsample->bioz_num_samples;
+
+        // Convert to GSR: Simplified linear mapping (tune based on calibration)
+        // Assuming ~10kΩ corresponds to ~10μS, adjust scaling as needed
+        uint16_t gsr_value_x100 = (uint16_t)((avg_bioz / 100) + 1000); // Offset + scale
+
+        // Update last GSR value
+        hpi_sys_set_last_gsr_update(gsr_value_x100, bsample->timestamp);
+
+        // Calculate and publish stress index
+        static struct hpi_gsr_stress_index_t stress_data = {0};
+        calculate_gsr_stress_index(gsr_value_x100, &stress_data);
+
+        if (stress_data.stress_data_ready)
+        {
+            zbus_chan_pub(&gsr_stress_chan, &stress_data, K_NO_WAIT);
+        }
+    }
 #endif
+}
+
+static void data_process_ppg_fi_sample(struct hpi_ppg_fi_data_t *ppg_fi_sensor_sample)
+{
+    if (settings_send_ble_enabled)
+    {
+        ble_ppg_notify_fi(ppg_fi_sensor_sample->raw_ir, ppg_fi_sensor_sample->ppg_num_samples);
+    }
+    if (settings_plot_enabled)
+    {
+        k_msgq_put(&q_plot_ppg_fi, ppg_fi_sensor_sample, K_NO_WAIT);
+    }
+}
+
+static void data_process_ppg_wr_sample(struct hpi_sample_block *blk)
+{
+    struct hpi_ppg_wr_data_t *ppg_wr_sensor_sample = &blk->ppg_wr;
+    static uint32_t hr_zbus_last_pub_time = 0;
+
+    if (settings_send_ble_enabled)
+    {
+        ble_ppg_notify_wr(ppg_wr_sensor_sample->raw_green, ppg_wr_sensor_sample->ppg_num_samples);
+    }
+    if (settings_plot_enabled)
+    {
+        hpi_sample_block_ref(blk);
+        if (k_msgq_put(&q_plot_ppg_wrist, &blk, K_NO_WAIT) != 0)
+        {
+            hpi_sample_block_unref(blk);
         }
+    }
 
-        if (k_msgq_get(&q_ppg_fi_sample, &ppg_fi_sensor_sample, K_NO_WAIT) == 0)
+    if (ppg_wr_sensor_sample->scd_state == HPI_PPG_SCD_ON_SKIN)
+    {
+        if (ppg_wr_sensor_sample->hr_confidence > 75)
         {
-            processed_data = true;
-            if (settings_send_ble_enabled)
+            if (hr_zbus_last_pub_time == 0)
             {
-                ble_ppg_notify_fi(ppg_fi_sensor_sample.raw_ir, ppg_fi_sensor_sample.ppg_num_samples);
+                hr_zbus_last_pub_time = k_uptime_seconds();
             }
-            if (settings_plot_enabled)
+            if ((k_uptime_seconds() - hr_zbus_last_pub_time) > 2)
             {
-                k_msgq_put(&q_plot_ppg_fi, &ppg_fi_sensor_sample, K_NO_WAIT);
+                struct hpi_hr_t hr_chan_value = {
+                    .timestamp = hw_get_sys_time_ts(),
+                    .hr = ppg_wr_sensor_sample->hr,
+                    .hr_ready_flag = true,
+                };
+                zbus_chan_pub(&hr_chan, &hr_chan_value, K_SECONDS(1));
+                hr_zbus_last_pub_time = k_uptime_seconds();
             }
         }
+    }
+}
+
+uint32_t hpi_data_get_wakeup_count(void)
+{
+    return atomic_get(&data_thread_wakeups);
+}
+
+void data_thread(void)
+{
+    struct hpi_sample_block *sample_blk;
+    struct hpi_ppg_fi_data_t ppg_fi_sensor_sample;
+    struct hpi_bioz_sample_t bsample;
+
+    // One event per producer queue. The thread sleeps in k_poll() until at
+    // least one of them has data, so an idle watch doesn't wake up at all.
+    struct k_poll_event data_events[DATA_EVT_COUNT] = {
+        [DATA_EVT_ECG] = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+                                                  K_POLL_MODE_NOTIFY_ONLY, &q_ecg_sample),
+        [DATA_EVT_BIOZ] = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+                                                   K_POLL_MODE_NOTIFY_ONLY, &q_bioz_sample),
+        [DATA_EVT_PPG_FI] = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+                                                     K_POLL_MODE_NOTIFY_ONLY, &q_ppg_fi_sample),
+        [DATA_EVT_PPG_WR] = K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE,
+                                                     K_POLL_MODE_NOTIFY_ONLY, &q_ppg_wrist_sample),
+    };
+
+    uint32_t last_wakeup_report = k_uptime_seconds();
+
+    LOG_INF("Data Thread starting");
+
+    for (;;)
+    {
+        int ret = k_poll(data_events, DATA_EVT_COUNT, K_FOREVER);
+        if (ret != 0)
+        {
+            LOG_WRN("Data thread poll error: %d", ret);
+            continue;
+        }
+
+        atomic_inc(&data_thread_wakeups);
 
-        // Check if PPG data is available
-        if (k_msgq_get(&q_ppg_wrist_sample, &ppg_wr_sensor_sample, K_NO_WAIT) == 0)
+        for (int i = 0; i < DATA_EVT_COUNT; i++)
         {
-            processed_data = true;
-            if (settings_send_ble_enabled)
-            {
-                ble_ppg_notify_wr(ppg_wr_sensor_sample.raw_green, ppg_wr_sensor_sample.ppg_num_samples);
-            }
-            if (settings_plot_enabled)
+            data_events[i].state = K_POLL_STATE_NOT_READY;
+        }
+
+        // Drain each queue in bounded batches so a busy producer can't starve
+        // the others. Anything left over makes the next k_poll() return at once.
+        for (int n = 0; n < DATA_THREAD_MAX_BATCH; n++)
+        {
+            if (k_msgq_get(&q_ecg_sample, &sample_blk, K_NO_WAIT) != 0)
             {
-                k_msgq_put(&q_plot_ppg_wrist, &ppg_wr_sensor_sample, K_NO_WAIT);
+                break;
             }
+            data_process_ecg_sample(sample_blk);
+            hpi_sample_block_unref(sample_blk);
+        }
 
-            if (settings_send_usb_enabled)
+        for (int n = 0; n < DATA_THREAD_MAX_BATCH; n++)
+        {
+            if (k_msgq_get(&q_bioz_sample, &bsample, K_NO_WAIT) != 0)
             {
+                break;
             }
+            data_process_bioz_sample(&bsample);
+        }
 
-            if (ppg_wr_sensor_sample.scd_state == HPI_PPG_SCD_ON_SKIN)
+        for (int n = 0; n < DATA_THREAD_MAX_BATCH; n++)
+        {
+            if (k_msgq_get(&q_ppg_fi_sample, &ppg_fi_sensor_sample, K_NO_WAIT) != 0)
             {
-                if (ppg_wr_sensor_sample.hr_confidence > 75)
-                {
-                    if (hr_zbus_last_pub_time == 0)
-                    {
-                        hr_zbus_last_pub_time = k_uptime_seconds();
-                    }
-                    if ((k_uptime_seconds() - hr_zbus_last_pub_time) > 2)
-                    {
-                        struct hpi_hr_t hr_chan_value = {
-                            .timestamp = hw_get_sys_time_ts(),
-                            .hr = ppg_wr_sensor_sample.hr,
-                            .hr_ready_flag = true,
-                        };
-                        zbus_chan_pub(&hr_chan, &hr_chan_value, K_SECONDS(1));
-                        hr_zbus_last_pub_time = k_uptime_seconds();
-                    }
-                }
+                break;
             }
+            data_process_ppg_fi_sample(&ppg_fi_sensor_sample);
         }
 
-        // Sleep longer if no data was processed to reduce CPU usage
-        if (processed_data)
+        for (int n = 0; n < DATA_THREAD_MAX_BATCH; n++)
         {
-            k_yield(); // Give other threads a chance to run
+            if (k_msgq_get(&q_ppg_wrist_sample, &sample_blk, K_NO_WAIT) != 0)
+            {
+                break;
+            }
+            data_process_ppg_wr_sample(sample_blk);
+            hpi_sample_block_unref(sample_blk);
         }
-        else
+
+        if ((k_uptime_seconds() - last_wakeup_report) >= DATA_WAKEUP_REPORT_INTERVAL_S)
         {
-            k_sleep(K_MSEC(1)); // Reduced sleep time to process samples faster
+            LOG_DBG("Data thread wakeups: %u total", hpi_data_get_wakeup_count());
+            last_wakeup_report = k_uptime_seconds();
         }
     }
 }
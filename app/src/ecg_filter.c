@@ -0,0 +1,209 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <math.h>
+#include <string.h>
+#include <arm_math.h>
+
+#include "ecg_filter.h"
+
+LOG_MODULE_REGISTER(ecg_filter, LOG_LEVEL_INF);
+
+#define ECG_FILTER_MAX_STAGES 3
+#define ECG_FILTER_COEFFS_PER_STAGE 5
+
+// Butterworth Q for the high- and low-pass; the notch is about 2 Hz wide,
+// which settles in well under a second
+#define BUTTERWORTH_Q 0.70710678
+#define NOTCH_Q 25.0
+
+// Samples converted per arm_biquad_cascade_df2T_f32() call
+#define ECG_FILTER_CHUNK 32
+
+// Batches averaged per cost report
+#define ECG_FILTER_STATS_BATCHES 1024
+
+static arm_biquad_cascade_df2T_instance_f32 filter_instance;
+static float32_t filter_coeffs[ECG_FILTER_MAX_STAGES * ECG_FILTER_COEFFS_PER_STAGE];
+static float32_t filter_state[ECG_FILTER_MAX_STAGES * 2];
+static uint32_t filter_rate;
+
+// The first sample after a restart is subtracted from the input, so the
+// electrode DC offset doesn't kick the high-pass into a long transient
+static int32_t filter_offset;
+static bool filter_primed;
+
+static atomic_t filter_reset_pending;
+static atomic_t filter_pending_rate = ATOMIC_INIT(ECG_SAMPLE_RATE_SPS);
+
+static uint32_t stats_cycles;
+static uint32_t stats_samples;
+static uint32_t stats_batches;
+
+enum biquad_type
+{
+    BIQUAD_HIGHPASS,
+    BIQUAD_LOWPASS,
+    BIQUAD_NOTCH,
+};
+
+/**
+ * @brief Design one stage (RBJ cookbook) in CMSIS order {b0, b1, b2, -a1, -a2}
+ */
+static void biquad_design(float32_t *c, enum biquad_type type, double f0, double q, double fs)
+{
+    double w0 = 2.0 * M_PI * f0 / fs;
+    double cw = cos(w0);
+    double alpha = sin(w0) / (2.0 * q);
+    double a0 = 1.0 + alpha;
+    double b0, b1, b2;
+
+    switch (type) {
+    case BIQUAD_HIGHPASS:
+        b0 = (1.0 + cw) / 2.0;
+        b1 = -(1.0 + cw);
+        b2 = b0;
+        break;
+    case BIQUAD_LOWPASS:
+        b0 = (1.0 - cw) / 2.0;
+        b1 = 1.0 - cw;
+        b2 = b0;
+        break;
+    case BIQUAD_NOTCH:
+    default:
+        b0 = 1.0;
+        b1 = -2.0 * cw;
+        b2 = 1.0;
+        break;
+    }
+
+    c[0] = (float32_t)(b0 / a0);
+    c[1] = (float32_t)(b1 / a0);
+    c[2] = (float32_t)(b2 / a0);
+    c[3] = (float32_t)(2.0 * cw / a0);
+    c[4] = (float32_t)(-(1.0 - alpha) / a0);
+}
+
+static void filter_configure(uint32_t rate)
+{
+    double fs = (double)rate;
+    double nyquist = fs / 2.0;
+    int stages = 0;
+
+    biquad_design(&filter_coeffs[0], BIQUAD_HIGHPASS, ECG_FILTER_HP_HZ, BUTTERWORTH_Q, fs);
+    stages++;
+
+#if defined(ECG_FILTER_NOTCH_HZ)
+    if (ECG_FILTER_NOTCH_HZ < nyquist) {
+        biquad_design(&filter_coeffs[stages * ECG_FILTER_COEFFS_PER_STAGE], BIQUAD_NOTCH,
+                      ECG_FILTER_NOTCH_HZ, NOTCH_Q, fs);
+        stages++;
+    }
+#endif
+
+    if (ECG_FILTER_LP_HZ < nyquist) {
+        biquad_design(&filter_coeffs[stages * ECG_FILTER_COEFFS_PER_STAGE], BIQUAD_LOWPASS,
+                      ECG_FILTER_LP_HZ, BUTTERWORTH_Q, fs);
+        stages++;
+    }
+
+    arm_biquad_cascade_df2T_init_f32(&filter_instance, stages, filter_coeffs, filter_state);
+    filter_rate = rate;
+
+    LOG_INF("ECG filter: %d stages at %u SPS", stages, rate);
+}
+
+static void filter_restart(void)
+{
+    memset(filter_state, 0, sizeof(filter_state));
+    filter_primed = false;
+}
+
+void ecg_filter_reset(void)
+{
+    atomic_set(&filter_reset_pending, 1);
+}
+
+void ecg_filter_set_rate(uint32_t sample_rate_sps)
+{
+    if (sample_rate_sps == 0) {
+        return;
+    }
+    atomic_set(&filter_pending_rate, (atomic_val_t)sample_rate_sps);
+}
+
+void ecg_filter_process(const int32_t *in, int32_t *out, int num_samples)
+{
+    float32_t buf[ECG_FILTER_CHUNK];
+
+    uint32_t rate = (uint32_t)atomic_set(&filter_pending_rate, 0);
+    if (rate != 0 && rate != filter_rate) {
+        filter_configure(rate);
+        filter_restart();
+    }
+    if (atomic_cas(&filter_reset_pending, 1, 0)) {
+        filter_restart();
+    }
+
+    if (num_samples <= 0) {
+        return;
+    }
+
+    uint32_t start = k_cycle_get_32();
+
+    if (!filter_primed) {
+        filter_offset = in[0];
+        filter_primed = true;
+    }
+
+    for (int done = 0; done < num_samples; done += ECG_FILTER_CHUNK) {
+        int n = MIN(num_samples - done, ECG_FILTER_CHUNK);
+
+        for (int i = 0; i < n; i++) {
+            buf[i] = (float32_t)(in[done + i] - filter_offset);
+        }
+        arm_biquad_cascade_df2T_f32(&filter_instance, buf, buf, n);
+        for (int i = 0; i < n; i++) {
+            out[done + i] = (int32_t)lrintf(buf[i]);
+        }
+    }
+
+    // Running per-batch cost, reported at debug level
+    stats_cycles += k_cycle_get_32() - start;
+    stats_samples += num_samples;
+    if (++stats_batches >= ECG_FILTER_STATS_BATCHES) {
+        LOG_DBG("ECG filter: %u cycles/batch, %u samples/batch at %u SPS",
+                stats_cycles / stats_batches, stats_samples / stats_batches, filter_rate);
+        stats_cycles = 0;
+        stats_samples = 0;
+        stats_batches = 0;
+    }
+}
@@ -0,0 +1,96 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+ECG display/stream filter chain: a 0.5 Hz high-pass for baseline wander, a
+50 or 60 Hz mains notch and a 40 Hz low-pass, run as one
+arm_biquad_cascade_df2T_f32() cascade over each FIFO batch. Coefficients are
+computed for the current sample rate, so the chain follows rate changes.
+The R-peak detector has its own band-pass and always sees raw samples.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "hpi_common_types.h"
+
+#define ECG_FILTER_HP_HZ 0.5f
+#define ECG_FILTER_LP_HZ 40.0f
+
+#if defined(CONFIG_HPI_ECG_NOTCH_50HZ)
+#define ECG_FILTER_NOTCH_HZ 50.0f
+#elif defined(CONFIG_HPI_ECG_NOTCH_60HZ)
+#define ECG_FILTER_NOTCH_HZ 60.0f
+#endif
+
+// Sample array each output uses, per the CONFIG_HPI_ECG_FILTER_* options
+#if defined(CONFIG_HPI_ECG_FILTER_DISPLAY)
+#define ECG_DISPLAY_SAMPLES(s) ((s)->ecg_filtered)
+#else
+#define ECG_DISPLAY_SAMPLES(s) ((s)->ecg_samples)
+#endif
+
+#if defined(CONFIG_HPI_ECG_FILTER_BLE)
+#define ECG_BLE_SAMPLES(s) ((s)->ecg_filtered)
+#else
+#define ECG_BLE_SAMPLES(s) ((s)->ecg_samples)
+#endif
+
+#if defined(CONFIG_HPI_ECG_FILTER_RECORD)
+#define ECG_RECORD_SAMPLES(s) ((s)->ecg_filtered)
+#else
+#define ECG_RECORD_SAMPLES(s) ((s)->ecg_samples)
+#endif
+
+/**
+ * @brief Restart the chain, e.g. after lead-off; applied on the next batch
+ *
+ * Safe to call from any thread.
+ */
+void ecg_filter_reset(void);
+
+/**
+ * @brief Recompute coefficients for a new sample rate and restart the chain
+ * @param sample_rate_sps ECG sample rate
+ *
+ * Stages at or above Nyquist are left out. Applied on the next batch.
+ */
+void ecg_filter_set_rate(uint32_t sample_rate_sps);
+
+/**
+ * @brief Filter a batch of ECG samples
+ * @param in Raw samples, oldest first
+ * @param out Filtered samples, may be the same array as in
+ * @param num_samples Number of samples
+ *
+ * Only one thread may call it.
+ */
+void ecg_filter_process(const int32_t *in, int32_t *out, int num_samples);
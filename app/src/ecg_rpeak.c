@@ -0,0 +1,327 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+#include "ecg_rpeak.h"
+
+LOG_MODULE_REGISTER(ecg_rpeak, LOG_LEVEL_INF);
+
+// Filter lengths, chosen for 128 SPS
+#define LP_DELAY 4  // Low-pass zeros at multiples of fs/4, -3 dB near 11 Hz
+#define HP_LEN 16   // High-pass is a delayed input minus a 16 sample mean
+#define MWI_LEN 19  // 150 ms integration window
+
+#define SQ_SHIFT 12 // Squared derivative scaling into 32 bits
+#define SQ_MAX (UINT32_MAX / 32) // Keeps the integrator sum in 32 bits
+
+#define LEARN_SAMPLES (2 * ECG_RPEAK_FS)
+#define REFRACTORY_SAMPLES (ECG_RPEAK_FS * 200 / 1000)
+#define TWAVE_SAMPLES (ECG_RPEAK_FS * 360 / 1000)
+
+// Group delay of the band-pass, removed from beat timestamps
+#define BP_DELAY (LP_DELAY - 1 + HP_LEN / 2)
+
+// The MWI peak trails the R wave by up to the integration window plus the
+// derivative delay; the band-passed history must cover that and the time an
+// MWI peak can take to be confirmed
+#define BP_HIST_LEN 64
+#define RPEAK_SEARCH_LEN (MWI_LEN + 6)
+
+BUILD_ASSERT(BP_HIST_LEN >= RPEAK_SEARCH_LEN + REFRACTORY_SAMPLES + 2, "band-pass history too short");
+
+struct ecg_rpeak_state
+{
+    uint32_t idx; // Index of the next sample
+
+    // Filter histories, indexed by idx modulo the length
+    int32_t x_hist[2 * LP_DELAY];
+    int32_t lp_y1, lp_y2;
+    int32_t lp_hist[HP_LEN];
+    int64_t lp_sum;
+    int32_t bp_hist[BP_HIST_LEN];
+    uint32_t sq_hist[MWI_LEN];
+    uint32_t mwi_sum;
+
+    // MWI peak currently being tracked
+    uint32_t cand_val;
+    uint32_t cand_idx;
+
+    // Best rejected peak since the last beat, for search-back. The band-pass
+    // history is gone by the time search-back fires, so keep its fiducial.
+    uint32_t back_val;
+    uint32_t back_idx;
+    int64_t back_pos_q8;
+    uint32_t back_slope;
+
+    // Adaptive levels of the integrated signal
+    uint32_t spki;
+    uint32_t npki;
+    uint64_t learn_sum;
+    uint32_t learn_max;
+
+    // Accepted beats
+    bool have_beat;
+    uint32_t last_beat_idx;    // MWI peak index
+    int64_t last_beat_pos_q8;  // R peak position in 1/256 samples
+    uint32_t last_slope;
+    uint32_t rr_avg_q8;        // Running RR average, 0 until two beats
+};
+
+static struct ecg_rpeak_state rp;
+
+void ecg_rpeak_reset(void)
+{
+    memset(&rp, 0, sizeof(rp));
+}
+
+static inline uint32_t ecg_rpeak_threshold1(void)
+{
+    return rp.npki + (rp.spki - rp.npki) / 4;
+}
+
+/**
+ * @brief Band-pass, derivative, square and integrate one sample
+ * @return Moving window integral
+ */
+static uint32_t ecg_rpeak_filter(int32_t x)
+{
+    uint32_t i = rp.idx;
+
+    // Low-pass: y[n] = 2y[n-1] - y[n-2] + x[n] - 2x[n-4] + x[n-8], gain 16
+    int32_t x4 = rp.x_hist[(i + LP_DELAY) % (2 * LP_DELAY)];
+    int32_t x8 = rp.x_hist[i % (2 * LP_DELAY)];
+    int32_t lp = 2 * rp.lp_y1 - rp.lp_y2 + x - 2 * x4 + x8;
+    rp.x_hist[i % (2 * LP_DELAY)] = x;
+    rp.lp_y2 = rp.lp_y1;
+    rp.lp_y1 = lp;
+
+    // High-pass: lp[n-8] - mean(lp[n-15..n])
+    rp.lp_sum += lp - rp.lp_hist[i % HP_LEN];
+    rp.lp_hist[i % HP_LEN] = lp;
+    int32_t bp = rp.lp_hist[(i + HP_LEN / 2) % HP_LEN] - (int32_t)(rp.lp_sum / HP_LEN);
+    rp.bp_hist[i % BP_HIST_LEN] = bp;
+
+    // Five point derivative 2x[n] + x[n-1] - x[n-3] - 2x[n-4], then square
+    int32_t d = 2 * bp + rp.bp_hist[(i - 1) % BP_HIST_LEN] - rp.bp_hist[(i - 3) % BP_HIST_LEN] -
+                2 * rp.bp_hist[(i - 4) % BP_HIST_LEN];
+    uint64_t sq64 = ((uint64_t)((int64_t)d * d)) >> SQ_SHIFT;
+    uint32_t sq = (sq64 > SQ_MAX) ? SQ_MAX : (uint32_t)sq64;
+
+    rp.mwi_sum += sq - rp.sq_hist[i % MWI_LEN];
+    rp.sq_hist[i % MWI_LEN] = sq;
+
+    return rp.mwi_sum / MWI_LEN;
+}
+
+/**
+ * @brief Locate the R peak behind an MWI peak on the band-passed signal
+ * @param mwi_idx Index of the MWI peak
+ * @param slope Largest sample-to-sample slope in the QRS
+ * @return R peak position in 1/256 samples
+ */
+static int64_t ecg_rpeak_fiducial(uint32_t mwi_idx, uint32_t *slope)
+{
+    uint32_t best = mwi_idx;
+    int32_t best_abs = -1;
+
+    *slope = 0;
+
+    // Absolute value so an inverted lead works as well
+    for (uint32_t j = mwi_idx - RPEAK_SEARCH_LEN; j != mwi_idx + 1; j++) {
+        int32_t v = rp.bp_hist[j % BP_HIST_LEN];
+        int32_t dv = v - rp.bp_hist[(j - 1) % BP_HIST_LEN];
+
+        v = (v < 0) ? -v : v;
+        if (v > best_abs) {
+            best_abs = v;
+            best = j;
+        }
+        dv = (dv < 0) ? -dv : dv;
+        if ((uint32_t)dv > *slope) {
+            *slope = dv;
+        }
+    }
+
+    // Parabola through the peak and its neighbours, vertex offset in Q8
+    int64_t ym = rp.bp_hist[(best - 1) % BP_HIST_LEN];
+    int64_t y0 = rp.bp_hist[best % BP_HIST_LEN];
+    int64_t yp = rp.bp_hist[(best + 1) % BP_HIST_LEN];
+
+    if (y0 < 0) {
+        ym = -ym;
+        y0 = -y0;
+        yp = -yp;
+    }
+
+    int64_t den = ym - 2 * y0 + yp;
+    int64_t offset_q8 = 0;
+
+    if (den < 0) {
+        offset_q8 = (ym - yp) * 128 / den;
+        offset_q8 = CLAMP(offset_q8, -128, 128);
+    }
+
+    return ((int64_t)best << 8) + offset_q8;
+}
+
+/**
+ * @brief Accept an MWI peak as a beat
+ * @return true if a beat with a valid RR interval was produced
+ */
+static bool ecg_rpeak_accept(uint32_t mwi_idx, uint32_t peak, bool searchback, uint32_t slope,
+                             int64_t pos_q8, uint32_t *rr_q8)
+{
+    // Search-back peaks are weighted more, as in the original algorithm
+    if (searchback) {
+        rp.spki = peak / 4 + rp.spki - rp.spki / 4;
+    } else {
+        rp.spki = peak / 8 + rp.spki - rp.spki / 8;
+    }
+
+    bool had_beat = rp.have_beat;
+    int64_t prev_pos = rp.last_beat_pos_q8;
+
+    rp.have_beat = true;
+    rp.last_beat_idx = mwi_idx;
+    rp.last_beat_pos_q8 = pos_q8;
+    rp.last_slope = slope;
+    rp.back_val = 0;
+
+    if (!had_beat || pos_q8 <= prev_pos) {
+        return false;
+    }
+
+    *rr_q8 = (uint32_t)(pos_q8 - prev_pos);
+    rp.rr_avg_q8 = (rp.rr_avg_q8 == 0) ? *rr_q8 : rp.rr_avg_q8 - rp.rr_avg_q8 / 8 + *rr_q8 / 8;
+
+    return true;
+}
+
+/**
+ * @brief Classify a confirmed MWI peak
+ * @return true if it produced an RR interval
+ */
+static bool ecg_rpeak_classify(uint32_t mwi_idx, uint32_t peak, int64_t *pos_q8, uint32_t *rr_q8)
+{
+    if (rp.have_beat && mwi_idx - rp.last_beat_idx < REFRACTORY_SAMPLES) {
+        return false;
+    }
+
+    uint32_t slope;
+    *pos_q8 = ecg_rpeak_fiducial(mwi_idx, &slope);
+
+    if (peak > ecg_rpeak_threshold1()) {
+        // A weak-sloped peak soon after a beat is a T wave
+        bool t_wave = rp.have_beat && mwi_idx - rp.last_beat_idx < TWAVE_SAMPLES && slope < rp.last_slope / 2;
+
+        if (!t_wave) {
+            return ecg_rpeak_accept(mwi_idx, peak, false, slope, *pos_q8, rr_q8);
+        }
+    }
+
+    rp.npki = peak / 8 + rp.npki - rp.npki / 8;
+
+    // Remember the best noise peak as a search-back candidate
+    if (peak > rp.back_val) {
+        rp.back_val = peak;
+        rp.back_idx = mwi_idx;
+        rp.back_pos_q8 = *pos_q8;
+        rp.back_slope = slope;
+    }
+
+    return false;
+}
+
+static void ecg_rpeak_emit(struct hpi_ecg_beat_t *beats, int *n, int max_beats, int64_t pos_q8,
+                           uint32_t rr_q8, uint32_t last_idx, int64_t last_sample_ts)
+{
+    if (*n >= max_beats) {
+        return;
+    }
+
+    int64_t age_q8 = ((int64_t)(last_idx + BP_DELAY) << 8) - pos_q8;
+
+    beats[*n].timestamp = last_sample_ts - age_q8 * 1000 / (ECG_RPEAK_FS * 256);
+    beats[*n].rr_us = (uint32_t)((int64_t)rr_q8 * 1000000 / (ECG_RPEAK_FS * 256));
+    (*n)++;
+}
+
+int ecg_rpeak_process(const int32_t *samples, int num_samples, int64_t last_sample_ts,
+                      struct hpi_ecg_beat_t *beats, int max_beats)
+{
+    int n = 0;
+    uint32_t last_idx = rp.idx + num_samples - 1;
+
+    for (int s = 0; s < num_samples; s++) {
+        uint32_t mwi = ecg_rpeak_filter(samples[s]);
+        uint32_t i = rp.idx++;
+
+        if (i < LEARN_SAMPLES) {
+            // Filters settle and initial levels are learnt over the first 2 s
+            rp.learn_sum += mwi;
+            rp.learn_max = MAX(rp.learn_max, mwi);
+            if (i == LEARN_SAMPLES - 1) {
+                rp.spki = rp.learn_max / 3;
+                rp.npki = (uint32_t)(rp.learn_sum / LEARN_SAMPLES / 2);
+            }
+            continue;
+        }
+
+        int64_t pos_q8;
+        uint32_t rr_q8;
+
+        // Track the current MWI hump; it is confirmed once it falls to half
+        // or has not grown for a refractory period
+        if (mwi > rp.cand_val) {
+            rp.cand_val = mwi;
+            rp.cand_idx = i;
+        } else if (rp.cand_val > 0 && (mwi < rp.cand_val / 2 || i - rp.cand_idx >= REFRACTORY_SAMPLES)) {
+            if (ecg_rpeak_classify(rp.cand_idx, rp.cand_val, &pos_q8, &rr_q8)) {
+                ecg_rpeak_emit(beats, &n, max_beats, pos_q8, rr_q8, last_idx, last_sample_ts);
+            }
+            rp.cand_val = 0;
+        }
+
+        // Search-back: no beat for 166% of the average RR, take the best
+        // rejected peak if it clears the lower threshold
+        if (rp.have_beat && rp.rr_avg_q8 > 0 && rp.back_val > ecg_rpeak_threshold1() / 2 &&
+            ((int64_t)(i - rp.last_beat_idx) << 8) > (int64_t)rp.rr_avg_q8 * 166 / 100) {
+            pos_q8 = rp.back_pos_q8;
+            if (ecg_rpeak_accept(rp.back_idx, rp.back_val, true, rp.back_slope, pos_q8, &rr_q8)) {
+                ecg_rpeak_emit(beats, &n, max_beats, pos_q8, rr_q8, last_idx, last_sample_ts);
+            }
+            rp.back_val = 0;
+        }
+    }
+
+    return n;
+}
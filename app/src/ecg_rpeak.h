@@ -0,0 +1,64 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+Streaming Pan-Tompkins R-peak detector for the 128 SPS MAX30001 ECG. Integer
+band-pass (5-11 Hz), five point derivative, squaring and a 150 ms moving
+window integrator feed adaptive signal/noise thresholds with search-back and
+T-wave rejection. The R peak is then located on the band-passed signal and
+refined with parabolic interpolation, so RR intervals resolve well below the
+7.8 ms sample period (the RTOR register is quantised to 8 ms).
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include "hpi_common_types.h"
+
+// Faster ECG rates are decimated to this before they reach the detector
+#define ECG_RPEAK_FS ECG_SAMPLE_RATE_SPS
+
+/**
+ * @brief Forget all history, e.g. after lead-off; relearns thresholds for 2 s
+ */
+void ecg_rpeak_reset(void);
+
+/**
+ * @brief Run a batch of ECG samples through the detector
+ * @param samples Raw ECG samples, oldest first
+ * @param num_samples Number of samples
+ * @param last_sample_ts Uptime of the last sample in ms
+ * @param beats Detected beats, oldest first
+ * @param max_beats Capacity of beats
+ * @return Number of beats written
+ */
+int ecg_rpeak_process(const int32_t *samples, int num_samples, int64_t last_sample_ts,
+                      struct hpi_ecg_beat_t *beats, int max_beats);
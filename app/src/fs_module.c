@@ -37,12 +37,17 @@
 #include <zephyr/fs/littlefs.h>
 #include <zephyr/storage/flash_map.h>
 #include <zephyr/settings/settings.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
 
 #include "hpi_common_types.h"
 #include "fs_module.h"
 #include "ui/move_ui.h"
 #include "trends.h"
 #include "cmd_module.h"
+#include "ble_module.h"
+#include "storage_module.h"
+#include "log_module.h"
 
 #ifdef CONFIG_MCUMGR_GRP_FS
 #include <zephyr/device.h>
@@ -63,7 +68,10 @@ static struct fs_mount_t lfs_storage_mnt = {
 
 struct fs_mount_t *mp = &lfs_storage_mnt;
 
-#define FILE_TRANSFER_BLE_PACKET_SIZE 64 // (16*7)
+// One packet type byte plus file data, filling a full ATT MTU notification
+#define FILE_TRANSFER_BLE_MAX_PACKET (CONFIG_BT_L2CAP_TX_MTU - 3)
+// Packet type byte plus little-endian uint32 file offset
+#define FILE_TRANSFER_RANGE_HDR_LEN 5
 
 static int littlefs_mount(struct fs_mount_t *mp)
 {
@@ -117,49 +125,6 @@ int fs_check_file_exists(const char *file_path)
     return 0;
 }
 
-static int lsdir(const char *path)
-{
-    int res;
-    struct fs_dir_t dirp;
-    static struct fs_dirent entry;
-
-    fs_dir_t_init(&dirp);
-    res = fs_opendir(&dirp, path);
-    if (res)
-    {
-        LOG_ERR("Error opening dir %s [%d]\n", path, res);
-        return res;
-    }
-
-    LOG_PRINTK("\nListing dir %s ...\n", path);
-    for (;;)
-    {
-
-        res = fs_readdir(&dirp, &entry);
-        if (res || entry.name[0] == 0)
-        {
-            if (res < 0)
-            {
-                LOG_ERR("Error reading dir [%d]\n", res);
-            }
-            break;
-        }
-
-        if (entry.type == FS_DIR_ENTRY_DIR)
-        {
-            LOG_PRINTK("[DIR ] %s\n", entry.name);
-        }
-        else
-        {
-            LOG_PRINTK("[FILE] %s (size = %zu)\n",
-                       entry.name, entry.size);
-        }
-    }
-    fs_closedir(&dirp);
-
-    return res;
-}
-
 uint32_t transfer_get_file_length(char *m_file_name)
 {
     LOG_DBG("Getting file length for file %s", m_file_name);
@@ -186,24 +151,55 @@ uint32_t transfer_get_file_length(char *m_file_name)
     return file_len;
 }
 
-void transfer_send_file(char *in_file_name)
+static int transfer_send_window_crc(uint32_t window_offset, uint32_t window_len, uint32_t crc)
 {
-    LOG_DBG("Start file transfer %s", in_file_name);
-    uint8_t m_buffer[FILE_TRANSFER_BLE_PACKET_SIZE + 1];
+    uint8_t pkt[13];
 
-    uint32_t file_len = transfer_get_file_length(in_file_name);
-    uint32_t number_writes = file_len / FILE_TRANSFER_BLE_PACKET_SIZE;
+    pkt[0] = CES_CMDIF_TYPE_DATA_CRC;
+    sys_put_le32(window_offset, &pkt[1]);
+    sys_put_le32(window_len, &pkt[5]);
+    sys_put_le32(crc, &pkt[9]);
+
+    return hpi_ble_send_data_bulk(pkt, sizeof(pkt));
+}
+
+// Streams [offset, offset + length) of a file over BLE. Plain transfers send
+// bare CES_CMDIF_TYPE_DATA packets; ranged transfers tag every packet with
+// its file offset and follow each window with a CRC32 so the phone can resume
+// or re-request only the windows that failed.
+static void transfer_send(char *in_file_name, uint32_t offset, uint32_t length, bool ranged)
+{
+    static uint8_t m_buffer[FILE_TRANSFER_BLE_MAX_PACKET];
 
-    uint32_t i = 0;
+    uint32_t file_len = transfer_get_file_length(in_file_name);
+    uint16_t packet_size = MIN(hpi_ble_get_max_payload(), sizeof(m_buffer));
+    uint8_t hdr_len = ranged ? FILE_TRANSFER_RANGE_HDR_LEN : 1;
+    uint32_t pos = offset;
+    uint32_t end;
+    uint32_t window_start = offset;
+    uint32_t window_crc = 0;
+    int64_t start_time = k_uptime_get();
     struct fs_file_t m_file;
     int rc = 0;
 
-    if (file_len % FILE_TRANSFER_BLE_PACKET_SIZE != 0)
+    if (packet_size <= hdr_len)
+    {
+        LOG_ERR("No connection for file transfer");
+        return;
+    }
+
+    if (offset > file_len)
     {
-        number_writes++; // Last write will be smaller than 64 bytes
+        LOG_ERR("Offset %d beyond end of %s (%d)", offset, in_file_name, file_len);
+        offset = file_len;
+        pos = file_len;
+        window_start = file_len;
     }
 
-    LOG_DBG("Send file: %s Size:%d No Writes: %d", in_file_name, file_len, number_writes);
+    // A length of 0 means up to the end of the file
+    end = (length == 0 || length > file_len - offset) ? file_len : (offset + length);
+
+    LOG_DBG("Send file: %s Size:%d Range: %d-%d Packet: %d", in_file_name, file_len, offset, end, packet_size);
 
     fs_file_t_init(&m_file);
 
@@ -215,19 +211,67 @@ void transfer_send_file(char *in_file_name)
         return;
     }
 
-    for (i = 0; i < number_writes; i++)
+    rc = fs_seek(&m_file, offset, FS_SEEK_SET);
+    if (rc != 0)
+    {
+        LOG_ERR("Error seeking file %d", rc);
+        fs_close(&m_file);
+        return;
+    }
+
+    m_buffer[0] = ranged ? CES_CMDIF_TYPE_DATA_RANGE : CES_CMDIF_TYPE_DATA;
+    hpi_ble_bulk_begin();
+
+    while (pos < end)
     {
-        rc = fs_read(&m_file, m_buffer, FILE_TRANSFER_BLE_PACKET_SIZE);
-        if (rc < 0)
+        // Ranged packets never straddle a CRC window
+        uint32_t chunk = MIN(packet_size - hdr_len, end - pos);
+        if (ranged)
+        {
+            chunk = MIN(chunk, window_start + CONFIG_HPI_LOG_FETCH_WINDOW_SIZE - pos);
+            sys_put_le32(pos, &m_buffer[1]);
+        }
+
+        rc = fs_read(&m_file, &m_buffer[hdr_len], chunk);
+        if (rc <= 0)
         {
-            LOG_ERR("Error reading file %d", rc);
-            return;
+            if (rc < 0)
+            {
+                LOG_ERR("Error reading file %d", rc);
+            }
+            break;
         }
 
-        cmdif_send_ble_data(m_buffer, rc); // FILE_TRANSFER_BLE_PACKET_SIZE);
-        k_sleep(K_MSEC(50));
+        if (hpi_ble_send_data_bulk(m_buffer, rc + hdr_len) < 0)
+        {
+            break;
+        }
+
+        if (ranged)
+        {
+            window_crc = crc32_ieee_update(window_crc, &m_buffer[hdr_len], rc);
+        }
+        pos += rc;
+
+        if (ranged && (pos - window_start == CONFIG_HPI_LOG_FETCH_WINDOW_SIZE || pos == end))
+        {
+            if (transfer_send_window_crc(window_start, pos - window_start, window_crc) < 0)
+            {
+                break;
+            }
+            window_start = pos;
+            window_crc = 0;
+        }
+    }
+
+    // An empty range still gets its (empty) window so the phone sees the end
+    if (ranged && offset == end)
+    {
+        transfer_send_window_crc(offset, 0, 0);
     }
 
+    hpi_ble_bulk_end();
+
     rc = fs_close(&m_file);
     if (rc != 0)
     {
@@ -235,7 +279,17 @@ void transfer_send_file(char *in_file_name)
         return;
     }
 
-    LOG_INF("File sent!!");
+    LOG_INF("File sent: %d of %d bytes in %lld ms", pos - offset, end - offset, k_uptime_get() - start_time);
+}
+
+void transfer_send_file(char *in_file_name)
+{
+    transfer_send(in_file_name, 0, 0, false);
+}
+
+void transfer_send_file_range(char *in_file_name, uint32_t offset, uint32_t length)
+{
+    transfer_send(in_file_name, offset, length, true);
 }
 
 void hpi_init_fs_struct(void)
@@ -358,40 +412,17 @@ int fs_load_file_to_buffer(char *m_file_name, uint8_t *buffer, uint32_t buffer_l
     return 0;
 }
 
+// Replaces the file with a copy of buffer from the storage thread; call
+// hpi_storage_flush() if the file has to be on flash before continuing
 void fs_write_buffer_to_file(char *m_file_name, uint8_t *buffer, uint32_t buffer_len)
 {
     LOG_DBG("Writing buffer to file %s", m_file_name);
 
-    struct fs_file_t m_file;
-    int ret = 0;
-
-    ret = fs_unlink(m_file_name);
+    int ret = hpi_storage_write(HPI_STORAGE_PRIO_META, HPI_FLASH_STATS_KEY_SYS, m_file_name, buffer, buffer_len,
+                                NULL, NULL);
     if (ret != 0)
     {
-        LOG_ERR("Error unlinking file %d", ret);
-    }
-
-    fs_file_t_init(&m_file);
-
-    ret = fs_open(&m_file, m_file_name, FS_O_CREATE | FS_O_WRITE);
-    if (ret != 0)
-    {
-        LOG_ERR("Error opening file %d", ret);
-        return;
-    }
-
-    ret = fs_write(&m_file, buffer, buffer_len);
-    if (ret < 0)
-    {
-        LOG_ERR("Error writing file %d", ret);
-        return;
-    }
-
-    ret = fs_close(&m_file);
-    if (ret != 0)
-    {
-        LOG_ERR("Error closing file %d", ret);
-        return;
+        LOG_ERR("Error queueing write to %s: %d", m_file_name, ret);
     }
 }
 
@@ -422,24 +453,16 @@ void fs_module_init(void)
 
     // record_wipe_all();
 
-    rc = lsdir("/lfs");
-    if (rc < 0)
-    {
-        LOG_ERR("FAIL: lsdir %s: %d\n", mp->mnt_point, rc);
-    }
-
-    rc = lsdir("/lfs/trtemp");
-    if (rc < 0)
-    {
-        LOG_ERR("FAIL: lsdir %s: %d\n", mp->mnt_point, rc);
-    }
+    // Directory contents are tracked by the per log type manifests, so only
+    // check that the directory structure exists instead of walking it
+    struct fs_dirent dirent;
 
-    rc = lsdir("/lfs/sys");
+    rc = fs_stat("/lfs/sys", &dirent);
     if (rc < 0)
     {
-        LOG_ERR("FAIL: lsdir %s: %d\n", mp->mnt_point, rc);
         LOG_INF("Creating FS directory structure");
         hpi_init_fs_struct();
-        lsdir("/lfs/trhr");
     }
+
+    hpi_log_retention_start();
 }
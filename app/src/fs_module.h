@@ -36,6 +36,7 @@
 
 void fs_module_init(void);
 void transfer_send_file(char* in_file_name);
+void transfer_send_file_range(char *in_file_name, uint32_t offset, uint32_t length);
 
 int fs_load_file_to_buffer(char *m_file_name, uint8_t *buffer, uint32_t buffer_len);
 void fs_write_buffer_to_file(char *m_file_name, uint8_t *buffer, uint32_t buffer_len);
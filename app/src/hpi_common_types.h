@@ -36,12 +36,18 @@ HealthyPi specific common data types
 
 #include <time.h>
 
-#define ECG_POINTS_PER_SAMPLE 16
+// Sized for a full MAX30001 FIFO watermark at the fastest rate
+#define ECG_POINTS_PER_SAMPLE 32
 #define BIOZ_POINTS_PER_SAMPLE 8
 #define PPG_POINTS_PER_SAMPLE 8
 #define BPT_PPG_POINTS_PER_SAMPLE 32
 
-#define ECG_RECORD_BUFFER_SAMPLES 3840 // Full 30 seconds at 128 Hz (128*30) - 15.36KB total
+// Default rates; the active ones are set with hpi_ecg_set_sample_rates()
+#define ECG_SAMPLE_RATE_SPS 128
+#define ECG_MAX_SAMPLE_RATE_SPS 512
+#define BIOZ_SAMPLE_RATE_SPS 32
+#define ECG_RECORD_DURATION_S CONFIG_HPI_ECG_RECORD_DURATION_S
+#define ECG_RECORD_MAX_SAMPLES(sps) (ECG_RECORD_DURATION_S * (sps))
 
 enum hpi_ppg_status 
 {
@@ -54,10 +60,14 @@ enum hpi_ppg_status
 struct hpi_ecg_bioz_sensor_data_t
 {
     int32_t ecg_samples[ECG_POINTS_PER_SAMPLE];
+#if defined(CONFIG_HPI_ECG_FILTER)
+    int32_t ecg_filtered[ECG_POINTS_PER_SAMPLE]; // ecg_filter.c output
+#endif
     int32_t bioz_sample[BIOZ_POINTS_PER_SAMPLE];
 
     uint8_t ecg_num_samples;
     uint8_t bioz_num_samples;
+    uint16_t ecg_sample_rate; // SPS the batch was taken at
 
     uint16_t rtor;
     uint16_t hr;
@@ -147,6 +157,17 @@ struct hpi_ppg_fi_data_t
     uint32_t 
 }*/
 
+struct hpi_hrv_spectrum_t
+{
+    float vlf_power; // ms^2, 0.0033-0.04 Hz
+    float lf_power;  // ms^2, 0.04-0.15 Hz
+    float hf_power;  // ms^2, 0.15-0.4 Hz
+    float lf_hf_ratio;
+    uint16_t num_intervals;
+    uint16_t duration_s; // Length of the tachogram that was analysed
+    bool valid;
+};
+
 struct hpi_computed_hrv_t
 {
     int32_t hrv_max;
@@ -156,6 +177,23 @@ struct hpi_computed_hrv_t
     float pnn;
     float rmssd;
     bool hrv_ready_flag;
+
+    uint16_t rr_ms; // Interval that produced this update
+    uint8_t artifact_pct; // Share of the window corrected by artifact rejection
+
+    // Poincaré descriptors and short-term DFA exponent of the window
+    float sd1;
+    float sd2;
+    float sd1_sd2;
+    float dfa_alpha1; // 0 until HRV_DFA_MIN_BEATS beats, refreshed with the spectrum
+    bool spectrum_updated; // spectrum was recomputed with this beat
+    struct hpi_hrv_spectrum_t spectrum;
+};
+
+struct hpi_ecg_beat_t
+{
+    int64_t timestamp; // Uptime of the R peak in ms
+    uint32_t rr_us;    // Interval from the previous R peak, 0 for the first beat
 };
 
 struct hpi_hr_t
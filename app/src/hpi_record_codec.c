@@ -0,0 +1,299 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "hpi_record_codec.h"
+
+// Quotients at or above this are escaped and followed by the raw 32 bit value,
+// which bounds the code length of an outlier such as a lead-off step
+#define RICE_ESCAPE 24
+#define RICE_MAX_K 24
+
+struct bit_writer
+{
+    uint8_t *buf;
+    size_t cap;
+    size_t pos; // in bits
+};
+
+struct bit_reader
+{
+    const uint8_t *buf;
+    size_t len;
+    size_t pos; // in bits
+};
+
+static inline uint32_t zigzag_enc(int32_t v)
+{
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t zigzag_dec(uint32_t u)
+{
+    return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+// Second order prediction in modular arithmetic so any int32 input round-trips
+static inline uint32_t residual(const int32_t *s, uint16_t i)
+{
+    uint32_t pred = (i == 1) ? (uint32_t)s[0] : (2u * (uint32_t)s[i - 1] - (uint32_t)s[i - 2]);
+
+    return zigzag_enc((int32_t)((uint32_t)s[i] - pred));
+}
+
+static bool bits_put(struct bit_writer *bw, uint32_t value, uint8_t nbits)
+{
+    if (bw->pos + nbits > bw->cap * 8)
+    {
+        return false;
+    }
+
+    while (nbits > 0)
+    {
+        nbits--;
+        if (value & (1u << nbits))
+        {
+            bw->buf[bw->pos >> 3] |= 0x80 >> (bw->pos & 7);
+        }
+        bw->pos++;
+    }
+
+    return true;
+}
+
+static bool bits_get(struct bit_reader *br, uint8_t nbits, uint32_t *value)
+{
+    if (br->pos + nbits > br->len * 8)
+    {
+        return false;
+    }
+
+    *value = 0;
+    while (nbits > 0)
+    {
+        *value = (*value << 1) | ((br->buf[br->pos >> 3] >> (7 - (br->pos & 7))) & 1);
+        br->pos++;
+        nbits--;
+    }
+
+    return true;
+}
+
+static bool rice_put(struct bit_writer *bw, uint32_t u, uint8_t k)
+{
+    uint32_t q = u >> k;
+
+    if (q >= RICE_ESCAPE)
+    {
+        return bits_put(bw, (1u << RICE_ESCAPE) - 1, RICE_ESCAPE) && bits_put(bw, u, 32);
+    }
+
+    return bits_put(bw, ((1u << q) - 1) << 1, q + 1) && bits_put(bw, u & ((1u << k) - 1), k);
+}
+
+static bool rice_get(struct bit_reader *br, uint8_t k, uint32_t *u)
+{
+    uint32_t q = 0;
+    uint32_t bit;
+    uint32_t rem = 0;
+
+    for (;;)
+    {
+        if (!bits_get(br, 1, &bit))
+        {
+            return false;
+        }
+        if (bit == 0)
+        {
+            break;
+        }
+        if (++q == RICE_ESCAPE)
+        {
+            return bits_get(br, 32, u);
+        }
+    }
+
+    if (k > 0 && !bits_get(br, k, &rem))
+    {
+        return false;
+    }
+
+    *u = (q << k) | rem;
+    return true;
+}
+
+// Rice parameter close to log2 of the mean residual
+static uint8_t rice_choose_k(const int32_t *samples, uint16_t num_samples)
+{
+    uint64_t sum = 0;
+    uint8_t k = 0;
+
+    for (uint16_t i = 1; i < num_samples; i++)
+    {
+        sum += residual(samples, i);
+    }
+
+    while (k < RICE_MAX_K && ((uint64_t)(num_samples - 1) << (k + 1)) <= sum)
+    {
+        k++;
+    }
+
+    return k;
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, v & 0xFFFF);
+    put_le16(p + 2, v >> 16);
+}
+
+static uint16_t get_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+void hpi_record_codec_file_hdr(struct hpi_record_codec_file_hdr_t *hdr, uint8_t log_type, uint16_t sample_rate)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    put_le32((uint8_t *)&hdr->magic, HPI_RECORD_CODEC_MAGIC);
+    hdr->version = HPI_RECORD_CODEC_VERSION;
+    hdr->log_type = log_type;
+    put_le16((uint8_t *)&hdr->sample_rate, sample_rate);
+    put_le16((uint8_t *)&hdr->block_samples, HPI_RECORD_CODEC_BLOCK_SAMPLES);
+}
+
+size_t hpi_record_codec_encode_block(const int32_t *samples, uint16_t num_samples, uint8_t *out)
+{
+    const size_t hdr_len = sizeof(struct hpi_record_codec_block_hdr_t);
+    const size_t raw_len = (num_samples - 1) * sizeof(int32_t);
+    uint8_t k = rice_choose_k(samples, num_samples);
+    struct bit_writer bw = {
+        .buf = out + hdr_len,
+        .cap = raw_len,
+    };
+    bool coded = true;
+
+    memset(bw.buf, 0, bw.cap);
+    for (uint16_t i = 1; i < num_samples && coded; i++)
+    {
+        coded = rice_put(&bw, residual(samples, i), k);
+    }
+
+    // Fall back to raw samples if coding would not save anything
+    size_t payload_len = (bw.pos + 7) / 8;
+    if (!coded || payload_len >= raw_len)
+    {
+        k = HPI_RECORD_CODEC_RAW_BLOCK;
+        payload_len = raw_len;
+        for (uint16_t i = 1; i < num_samples; i++)
+        {
+            put_le32(out + hdr_len + (i - 1) * sizeof(int32_t), (uint32_t)samples[i]);
+        }
+    }
+
+    out[0] = HPI_RECORD_CODEC_BLOCK_SYNC;
+    out[1] = k;
+    put_le16(out + 2, num_samples);
+    put_le16(out + 4, payload_len);
+    put_le32(out + 6, (uint32_t)samples[0]);
+
+    return hdr_len + payload_len;
+}
+
+size_t hpi_record_codec_decode_block(const uint8_t *in, size_t in_len, int32_t *samples, uint16_t *num_samples)
+{
+    const size_t hdr_len = sizeof(struct hpi_record_codec_block_hdr_t);
+    uint16_t n;
+    uint16_t payload_len;
+    uint8_t k;
+
+    if (in_len < hdr_len || in[0] != HPI_RECORD_CODEC_BLOCK_SYNC)
+    {
+        return 0;
+    }
+
+    k = in[1];
+    n = get_le16(in + 2);
+    payload_len = get_le16(in + 4);
+
+    if (n == 0 || n > HPI_RECORD_CODEC_BLOCK_SAMPLES || in_len < hdr_len + payload_len ||
+        (k != HPI_RECORD_CODEC_RAW_BLOCK && k > RICE_MAX_K))
+    {
+        return 0;
+    }
+
+    samples[0] = (int32_t)get_le32(in + 6);
+
+    if (k == HPI_RECORD_CODEC_RAW_BLOCK)
+    {
+        if (payload_len != (n - 1) * sizeof(int32_t))
+        {
+            return 0;
+        }
+        for (uint16_t i = 1; i < n; i++)
+        {
+            samples[i] = (int32_t)get_le32(in + hdr_len + (i - 1) * sizeof(int32_t));
+        }
+    }
+    else
+    {
+        struct bit_reader br = {
+            .buf = in + hdr_len,
+            .len = payload_len,
+        };
+
+        for (uint16_t i = 1; i < n; i++)
+        {
+            uint32_t u;
+            uint32_t pred = (i == 1) ? (uint32_t)samples[0] : (2u * (uint32_t)samples[i - 1] - (uint32_t)samples[i - 2]);
+
+            if (!rice_get(&br, k, &u))
+            {
+                return 0;
+            }
+            samples[i] = (int32_t)(pred + (uint32_t)zigzag_dec(u));
+        }
+    }
+
+    *num_samples = n;
+    return hdr_len + payload_len;
+}
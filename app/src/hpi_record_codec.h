@@ -0,0 +1,88 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+Streaming block codec for ECG/BioZ record files. MAX30001 samples are 18 bit,
+so storing them as int32 spends most of every record on sign extension.
+
+A compressed record is a file header followed by self-contained blocks. Each
+block starts with a keyframe (the absolute first sample); the rest are second
+order deltas, zigzag mapped and Rice coded with a per-block parameter. Blocks
+that would not shrink are stored raw. Records without the header are legacy
+raw little-endian int32 samples. scripts/decode_record.py decodes both.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define HPI_RECORD_CODEC_MAGIC 0x5A434548 // "HECZ"
+#define HPI_RECORD_CODEC_VERSION 1
+
+#define HPI_RECORD_CODEC_BLOCK_SYNC 0xB5
+#define HPI_RECORD_CODEC_RAW_BLOCK 0xFF // rice_k value of an uncoded block
+
+// One second of ECG per block, so a damaged block loses at most a second
+#define HPI_RECORD_CODEC_BLOCK_SAMPLES 128
+
+struct hpi_record_codec_file_hdr_t
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t log_type;
+    uint16_t sample_rate;
+    uint16_t block_samples;
+    uint16_t reserved;
+} __attribute__((packed));
+
+struct hpi_record_codec_block_hdr_t
+{
+    uint8_t sync;
+    uint8_t rice_k;
+    uint16_t num_samples;
+    uint16_t payload_len;
+    int32_t keyframe;
+} __attribute__((packed));
+
+// Worst case is a raw block
+#define HPI_RECORD_CODEC_MAX_BLOCK_BYTES \
+    (sizeof(struct hpi_record_codec_block_hdr_t) + (HPI_RECORD_CODEC_BLOCK_SAMPLES - 1) * sizeof(int32_t))
+
+/* Fill in a file header for a compressed record */
+void hpi_record_codec_file_hdr(struct hpi_record_codec_file_hdr_t *hdr, uint8_t log_type, uint16_t sample_rate);
+
+/* Encode 1..HPI_RECORD_CODEC_BLOCK_SAMPLES samples into out, which must hold
+   HPI_RECORD_CODEC_MAX_BLOCK_BYTES. Returns the number of bytes written. */
+size_t hpi_record_codec_encode_block(const int32_t *samples, uint16_t num_samples, uint8_t *out);
+
+/* Decode one block from in. Returns the number of bytes consumed and sets
+   *num_samples, or 0 if the block is truncated or corrupt. */
+size_t hpi_record_codec_decode_block(const uint8_t *in, size_t in_len, int32_t *samples, uint16_t *num_samples);
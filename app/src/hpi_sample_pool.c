@@ -0,0 +1,95 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <string.h>
+
+#include "hpi_sample_pool.h"
+
+LOG_MODULE_REGISTER(hpi_sample_pool, LOG_LEVEL_INF);
+
+K_MEM_SLAB_DEFINE_STATIC(hpi_sample_slab, sizeof(struct hpi_sample_block), CONFIG_HPI_SAMPLE_POOL_BLOCKS, 4);
+
+static atomic_t sample_pool_alloc_failures = ATOMIC_INIT(0);
+
+struct hpi_sample_block *hpi_sample_block_alloc(enum hpi_sample_block_type type)
+{
+    struct hpi_sample_block *blk;
+
+    // Producers run from work items and must never block on the pool
+    if (k_mem_slab_alloc(&hpi_sample_slab, (void **)&blk, K_NO_WAIT) != 0)
+    {
+        uint32_t failures = atomic_inc(&sample_pool_alloc_failures) + 1;
+        if ((failures % 10) == 1)
+        {
+            LOG_WRN("Sample pool exhausted - %u allocations failed", failures);
+        }
+        return NULL;
+    }
+
+    atomic_set(&blk->refcount, 1);
+    blk->type = type;
+
+    return blk;
+}
+
+struct hpi_sample_block *hpi_sample_block_ref(struct hpi_sample_block *blk)
+{
+    __ASSERT_NO_MSG(blk != NULL && atomic_get(&blk->refcount) > 0);
+
+    atomic_inc(&blk->refcount);
+    return blk;
+}
+
+void hpi_sample_block_unref(struct hpi_sample_block *blk)
+{
+    if (blk == NULL)
+    {
+        return;
+    }
+
+    __ASSERT_NO_MSG(atomic_get(&blk->refcount) > 0);
+
+    // atomic_dec() returns the previous value
+    if (atomic_dec(&blk->refcount) == 1)
+    {
+        k_mem_slab_free(&hpi_sample_slab, (void *)blk);
+    }
+}
+
+uint32_t hpi_sample_pool_num_free(void)
+{
+    return k_mem_slab_num_free_get(&hpi_sample_slab);
+}
+
+uint32_t hpi_sample_pool_alloc_failures(void)
+{
+    return atomic_get(&sample_pool_alloc_failures);
+}
@@ -0,0 +1,71 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+Reference-counted sample blocks shared between the sensor producers and the
+BLE / display / recorder consumers. Queues carry block pointers only.
+*/
+
+#pragma once
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+
+#include "hpi_common_types.h"
+
+enum hpi_sample_block_type
+{
+    HPI_SAMPLE_BLOCK_ECG = 0x00,
+    HPI_SAMPLE_BLOCK_PPG_WR,
+};
+
+struct hpi_sample_block
+{
+    atomic_t refcount;
+    uint8_t type;
+
+    union
+    {
+        struct hpi_ecg_bioz_sensor_data_t ecg;
+        struct hpi_ppg_wr_data_t ppg_wr;
+    };
+};
+
+/* Allocate a block with a reference count of one, or NULL if the pool is empty */
+struct hpi_sample_block *hpi_sample_block_alloc(enum hpi_sample_block_type type);
+
+/* Take an extra reference before handing the block to another consumer */
+struct hpi_sample_block *hpi_sample_block_ref(struct hpi_sample_block *blk);
+
+/* Drop a reference; the block returns to the pool when the last one is dropped */
+void hpi_sample_block_unref(struct hpi_sample_block *blk);
+
+uint32_t hpi_sample_pool_num_free(void);
+uint32_t hpi_sample_pool_alloc_failures(void);
@@ -29,6 +29,7 @@
 
 
 #include "hpi_settings_store.h"
+#include "storage_module.h"
 #include <zephyr/logging/log.h>
 #include <zephyr/fs/fs.h>
 #include <string.h>
@@ -184,6 +185,7 @@ static int settings_write_to_file(void)
 {
     struct fs_file_t file;
     struct settings_file_header header;
+    uint32_t begin = hpi_flash_stats_begin();
     int rc;
     
     LOG_DBG("Attempting to write settings to %s", SETTINGS_FILE_PATH);
@@ -202,6 +204,7 @@ static int settings_write_to_file(void)
     rc = fs_open(&file, SETTINGS_FILE_PATH, FS_O_CREATE | FS_O_WRITE);
     if (rc) {
         LOG_ERR("Failed to create settings file: %d", rc);
+        hpi_flash_stats_end(HPI_FLASH_STATS_KEY_SETTINGS, begin, 0, false, rc);
         return rc;
     }
     
@@ -243,6 +246,7 @@ static int settings_write_to_file(void)
     
 close_file:
     fs_close(&file);
+    hpi_flash_stats_end(HPI_FLASH_STATS_KEY_SETTINGS, begin, sizeof(header) + sizeof(current_settings), rc == 0, rc);
     return rc;
 }
 
@@ -62,9 +62,15 @@ int hpi_sys_sync_time_if_needed(void);
 int hpi_sys_force_time_sync(void);
 struct tm hpi_sys_get_current_time(void);
 
-void hpi_data_set_ecg_record_active(bool active);
-void hpi_data_reset_ecg_record_buffer(void);
+int hpi_data_set_ecg_record_active(bool active);
+int hpi_data_reset_ecg_record_buffer(void);
 bool hpi_data_is_ecg_record_active(void);
 
+// ECG 128/256/512 and BioZ 32/64 SPS; applied when the next measurement starts
+int hpi_ecg_set_sample_rates(uint16_t ecg_sps, uint8_t bioz_sps);
+uint16_t hpi_ecg_get_sample_rate(void);
+
+uint32_t hpi_data_get_wakeup_count(void);
+
 void hpi_data_set_gsr_measurement_active(bool active);
 bool hpi_data_is_gsr_measurement_active(void);
@@ -48,6 +48,7 @@
 #include "hpi_common_types.h"
 #include "hpi_sys.h"
 #include "hw_module.h"
+#include "storage_module.h"
 
 LOG_MODULE_REGISTER(hpi_sys_module, LOG_LEVEL_DBG);
 
@@ -133,28 +134,15 @@ static int hpi_sys_store_update_time(void)
 
     LOG_DBG("Storing last update time");
 
-    struct fs_file_t m_file;
-    fs_file_t_init(&m_file);
-
-    ret = fs_open(&m_file, hpi_sys_update_time_file, FS_O_CREATE | FS_O_WRITE);
-    if (ret != 0)
-    {
-        LOG_ERR("Error opening file %d", ret);
-        return ret;
-    }
-
-    ret = fs_write(&m_file, &g_hpi_last_update, sizeof(g_hpi_last_update));
-    if (ret < 0)
-    {
-        LOG_ERR("Error writing file %d", ret);
-        return ret;
-    }
+    // Queue a snapshot for the storage thread instead of writing flash here
+    k_mutex_lock(&mutex_hpi_last_update_time, K_FOREVER);
+    ret = hpi_storage_write(HPI_STORAGE_PRIO_META, HPI_FLASH_STATS_KEY_SYS, hpi_sys_update_time_file,
+                            &g_hpi_last_update, sizeof(g_hpi_last_update), NULL, NULL);
+    k_mutex_unlock(&mutex_hpi_last_update_time);
 
-    ret = fs_close(&m_file);
     if (ret != 0)
     {
-        LOG_ERR("Error closing file %d", ret);
-        return ret;
+        LOG_ERR("Error queueing update time write %d", ret);
     }
 
     return ret;
@@ -101,6 +101,17 @@ ZBUS_CHAN_DEFINE(ecg_stat_chan, /* Name */
                  ZBUS_MSG_INIT(0) /* Initial value {0} */
 );
 
+#if defined(CONFIG_HPI_ECG_RPEAK_DETECTOR)
+// R peaks from the on-device detector, one message per beat
+ZBUS_CHAN_DEFINE(ecg_beat_chan, /* Name */
+                 struct hpi_ecg_beat_t,
+                 NULL, /* Validator */
+                 NULL, /* User Data */
+                 ZBUS_OBSERVERS(hrv_beat_lis),
+                 ZBUS_MSG_INIT(0) /* Initial value {0} */
+);
+#endif
+
 #if defined(CONFIG_HPI_GSR_STRESS_INDEX)
 ZBUS_CHAN_DEFINE(gsr_stress_chan, /* Name */
                  struct hpi_gsr_stress_index_t,
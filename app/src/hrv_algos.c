@@ -9,71 +9,169 @@
 
 LOG_MODULE_REGISTER(hrv_algos, LOG_LEVEL_DBG);
 
-// HRV calculation state
+// Incremental HRV engine over a sliding window of the last HRV_WINDOW_SIZE
+// RR intervals. Every statistic is updated in O(1) per beat: exact integer
+// running sums for the mean and variance, accumulators over successive
+// differences in arrival order, and monotonic deques for min/max.
 typedef struct {
-    uint32_t rr_intervals[HRV_LIMIT];
+    uint16_t rr_intervals[HRV_WINDOW_SIZE]; // Ring buffer, oldest at head
+    int head;
     int sample_count;
-    int buffer_index;
-    bool buffer_full;
-    
-    // Cached values to avoid recalculation
-    float cached_mean;
-    bool mean_valid;
+
+    // Running sums over the window
+    uint64_t sum;
+    uint64_t sum_sq;
+
+    // Successive differences between neighbours in the window
+    uint64_t diff_sum_sq;
+    int diff_over_50ms;
+
+    // Monotonic deques of beat sequence numbers: values increasing from the
+    // front for min, decreasing for max. Fronts are the window min/max.
+    uint32_t min_dq[HRV_WINDOW_SIZE];
+    uint32_t max_dq[HRV_WINDOW_SIZE];
+    int min_head, min_len;
+    int max_head, max_len;
+
+    uint32_t seq; // Sequence number of the next beat
+
+    // Beats in the window that the artifact stage corrected
+    uint8_t corrected[HRV_WINDOW_SIZE];
+    int artifact_count;
 } hrv_state_t;
 
+// Streaming RR artifact correction ahead of the HRV window. Each raw interval
+// is compared with the median of the last HRV_CLEAN_MEDIAN_LEN raw intervals
+// using a Kubios style threshold scaled to the current rate. Missed beats are
+// split, extra beats merged, short-long ectopic pairs evened out and anything
+// else replaced by the local median. The median length is fixed, so the cost
+// per beat is constant.
+#define HRV_CLEAN_MEDIAN_LEN 11
+#define HRV_CLEAN_MIN_HISTORY 5 // Raw beats needed before the median is trusted
+#define HRV_CLEAN_MAX_OUT 4     // Worst case: flushed pending beat + 3 way split
+#define HRV_RR_MIN_MS 300
+#define HRV_RR_MAX_MS 2000
+
+typedef struct {
+    uint16_t history[HRV_CLEAN_MEDIAN_LEN]; // Raw in-range intervals
+    int history_len;
+    int history_pos;
+    uint16_t pending; // Short interval waiting for the next beat, 0 if none
+} hrv_clean_state_t;
+
+typedef struct {
+    uint16_t rr;
+    bool corrected;
+} hrv_clean_out_t;
+
 // Static state for HRV calculations
-static hrv_state_t hrv_state = {
-    .sample_count = 0,
-    .buffer_index = 0,
-    .buffer_full = false,
-    .cached_mean = 0.0f,
-    .mean_valid = false
-};
+static hrv_state_t hrv_state;
+static hrv_clean_state_t hrv_clean;
+
+static inline uint16_t hrv_rr_at_seq(uint32_t seq)
+{
+    return hrv_state.rr_intervals[seq % HRV_WINDOW_SIZE];
+}
+
+static inline uint32_t hrv_diff_sq(uint16_t a, uint16_t b)
+{
+    int32_t diff = (int32_t)a - (int32_t)b;
+    return (uint32_t)(diff * diff);
+}
+
+/**
+ * @brief Push a beat onto a monotonic deque
+ * @param dq Deque storage
+ * @param head Index of the front element
+ * @param len Number of elements
+ * @param rr New RR interval
+ * @param keep_smaller true for the min deque, false for the max deque
+ */
+static void hrv_deque_push(uint32_t *dq, int head, int *len, uint16_t rr, bool keep_smaller)
+{
+    // Drop entries from the back that can never be the extreme again
+    while (*len > 0) {
+        uint16_t back = hrv_rr_at_seq(dq[(head + *len - 1) % HRV_WINDOW_SIZE]);
+        if (keep_smaller ? (back < rr) : (back > rr)) {
+            break;
+        }
+        (*len)--;
+    }
+
+    dq[(head + *len) % HRV_WINDOW_SIZE] = hrv_state.seq;
+    (*len)++;
+}
 
 /**
- * @brief Add a new RR interval to the circular buffer
+ * @brief Drop the front of a deque if it is the beat leaving the window
+ */
+static void hrv_deque_expire(const uint32_t *dq, int *head, int *len, uint32_t expired_seq)
+{
+    if (*len > 0 && dq[*head] == expired_seq) {
+        *head = (*head + 1) % HRV_WINDOW_SIZE;
+        (*len)--;
+    }
+}
+
+/**
+ * @brief Add a new RR interval, evicting the oldest one once the window is full
  * @param rr_interval RR interval in milliseconds
+ * @param corrected true if the artifact stage produced or changed this interval
  */
-static void hrv_add_sample(uint32_t rr_interval)
+static void hrv_add_sample(uint32_t rr_interval, bool corrected)
 {
-    hrv_state.rr_intervals[hrv_state.buffer_index] = rr_interval;
-    hrv_state.buffer_index = (hrv_state.buffer_index + 1) % HRV_LIMIT;
-    
-    if (hrv_state.sample_count < HRV_LIMIT) {
-        hrv_state.sample_count++;
-    } else {
-        hrv_state.buffer_full = true;
+    uint16_t rr = (uint16_t)MIN(rr_interval, UINT16_MAX);
+
+    if (hrv_state.sample_count == HRV_WINDOW_SIZE) {
+        uint32_t oldest_seq = hrv_state.seq - HRV_WINDOW_SIZE;
+        uint16_t oldest = hrv_rr_at_seq(oldest_seq);
+        uint16_t next = hrv_rr_at_seq(oldest_seq + 1);
+
+        hrv_state.sum -= oldest;
+        hrv_state.sum_sq -= (uint32_t)oldest * oldest;
+        hrv_state.diff_sum_sq -= hrv_diff_sq(next, oldest);
+        hrv_state.diff_over_50ms -= (hrv_diff_sq(next, oldest) > 50 * 50) ? 1 : 0;
+
+        hrv_deque_expire(hrv_state.min_dq, &hrv_state.min_head, &hrv_state.min_len, oldest_seq);
+        hrv_deque_expire(hrv_state.max_dq, &hrv_state.max_head, &hrv_state.max_len, oldest_seq);
+
+        hrv_state.artifact_count -= hrv_state.corrected[oldest_seq % HRV_WINDOW_SIZE];
+
+        hrv_state.head = (hrv_state.head + 1) % HRV_WINDOW_SIZE;
+        hrv_state.sample_count--;
     }
-    
-    // Invalidate cached values when new data is added
-    hrv_state.mean_valid = false;
+
+    if (hrv_state.sample_count > 0) {
+        uint16_t prev = hrv_rr_at_seq(hrv_state.seq - 1);
+
+        hrv_state.diff_sum_sq += hrv_diff_sq(rr, prev);
+        hrv_state.diff_over_50ms += (hrv_diff_sq(rr, prev) > 50 * 50) ? 1 : 0;
+    }
+
+    // Deques compare against the ring, so store the beat first
+    hrv_state.rr_intervals[hrv_state.seq % HRV_WINDOW_SIZE] = rr;
+    hrv_state.corrected[hrv_state.seq % HRV_WINDOW_SIZE] = corrected ? 1 : 0;
+    hrv_state.artifact_count += corrected ? 1 : 0;
+    hrv_deque_push(hrv_state.min_dq, hrv_state.min_head, &hrv_state.min_len, rr, true);
+    hrv_deque_push(hrv_state.max_dq, hrv_state.max_head, &hrv_state.max_len, rr, false);
+
+    hrv_state.sum += rr;
+    hrv_state.sum_sq += (uint32_t)rr * rr;
+    hrv_state.sample_count++;
+    hrv_state.seq++;
 }
 
 /**
- * @brief Calculate mean RR interval with caching
+ * @brief Mean RR interval of the window
  * @return Mean RR interval in milliseconds
  */
 static float hrv_calculate_mean(void)
 {
-    if (hrv_state.mean_valid) {
-        return hrv_state.cached_mean;
-    }
-    
     if (hrv_state.sample_count == 0) {
         return 0.0f;
     }
-    
-    uint64_t sum = 0;
-    int count = hrv_state.buffer_full ? HRV_LIMIT : hrv_state.sample_count;
-    
-    for (int i = 0; i < count; i++) {
-        sum += hrv_state.rr_intervals[i];
-    }
-    
-    hrv_state.cached_mean = (float)sum / count;
-    hrv_state.mean_valid = true;
-    
-    return hrv_state.cached_mean;
+
+    return (float)((double)hrv_state.sum / hrv_state.sample_count);
 }
 
 /**
@@ -82,20 +180,16 @@ static float hrv_calculate_mean(void)
  */
 static float hrv_calculate_sdnn(void)
 {
-    if (hrv_state.sample_count < 2) {
+    int n = hrv_state.sample_count;
+
+    if (n < 2) {
         return 0.0f;
     }
-    
-    float mean = hrv_calculate_mean();
-    float sum_squared_diff = 0.0f;
-    int count = hrv_state.buffer_full ? HRV_LIMIT : hrv_state.sample_count;
-    
-    for (int i = 0; i < count; i++) {
-        float diff = (float)hrv_state.rr_intervals[i] - mean;
-        sum_squared_diff += diff * diff;
-    }
-    
-    return sqrtf(sum_squared_diff / (count - 1));
+
+    // Sums are exact integers, so this has no drift however long it runs
+    double var = ((double)hrv_state.sum_sq - (double)hrv_state.sum * hrv_state.sum / n) / (n - 1);
+
+    return (var > 0.0) ? sqrtf((float)var) : 0.0f;
 }
 
 /**
@@ -107,23 +201,8 @@ static float hrv_calculate_rmssd(void)
     if (hrv_state.sample_count < 2) {
         return 0.0f;
     }
-    
-    float sum_squared_diff = 0.0f;
-    int count = hrv_state.buffer_full ? HRV_LIMIT : hrv_state.sample_count;
-    int differences = 0;
-    
-    for (int i = 0; i < count - 1; i++) {
-        int32_t diff = (int32_t)hrv_state.rr_intervals[(i + 1) % HRV_LIMIT] - 
-                       (int32_t)hrv_state.rr_intervals[i];
-        sum_squared_diff += (float)(diff * diff);
-        differences++;
-    }
-    
-    if (differences == 0) {
-        return 0.0f;
-    }
-    
-    return sqrtf(sum_squared_diff / differences);
+
+    return sqrtf((float)((double)hrv_state.diff_sum_sq / (hrv_state.sample_count - 1)));
 }
 
 /**
@@ -135,69 +214,265 @@ static float hrv_calculate_pnn50(void)
     if (hrv_state.sample_count < 2) {
         return 0.0f;
     }
-    
-    int count_over_50ms = 0;
-    int count = hrv_state.buffer_full ? HRV_LIMIT : hrv_state.sample_count;
-    int total_differences = 0;
-    
-    for (int i = 0; i < count - 1; i++) {
-        int32_t diff = abs((int32_t)hrv_state.rr_intervals[(i + 1) % HRV_LIMIT] - 
-                          (int32_t)hrv_state.rr_intervals[i]);
-        if (diff > 50) {
-            count_over_50ms++;
-        }
-        total_differences++;
-    }
-    
-    if (total_differences == 0) {
-        return 0.0f;
-    }
-    
-    return (float)count_over_50ms / total_differences;
+
+    return (float)hrv_state.diff_over_50ms / (hrv_state.sample_count - 1);
 }
 
 /**
- * @brief Find minimum RR interval in the buffer
+ * @brief Minimum RR interval in the window
  * @return Minimum RR interval in milliseconds
  */
 static uint32_t hrv_calculate_min(void)
 {
-    if (hrv_state.sample_count == 0) {
+    if (hrv_state.min_len == 0) {
         return 0;
     }
-    
-    uint32_t min_val = hrv_state.rr_intervals[0];
-    int count = hrv_state.buffer_full ? HRV_LIMIT : hrv_state.sample_count;
-    
-    for (int i = 1; i < count; i++) {
-        if (hrv_state.rr_intervals[i] < min_val) {
-            min_val = hrv_state.rr_intervals[i];
-        }
-    }
-    
-    return min_val;
+
+    return hrv_rr_at_seq(hrv_state.min_dq[hrv_state.min_head]);
 }
 
 /**
- * @brief Find maximum RR interval in the buffer
+ * @brief Maximum RR interval in the window
  * @return Maximum RR interval in milliseconds
  */
 static uint32_t hrv_calculate_max(void)
 {
-    if (hrv_state.sample_count == 0) {
+    if (hrv_state.max_len == 0) {
         return 0;
     }
-    
-    uint32_t max_val = hrv_state.rr_intervals[0];
-    int count = hrv_state.buffer_full ? HRV_LIMIT : hrv_state.sample_count;
-    
-    for (int i = 1; i < count; i++) {
-        if (hrv_state.rr_intervals[i] > max_val) {
-            max_val = hrv_state.rr_intervals[i];
+
+    return hrv_rr_at_seq(hrv_state.max_dq[hrv_state.max_head]);
+}
+
+/**
+ * @brief Poincaré descriptors of the window
+ * @param sd1 Short-term variability, perpendicular to the identity line (ms)
+ * @param sd2 Long-term variability, along the identity line (ms)
+ *
+ * SD1^2 = Var(dRR)/2 and SD2^2 = 2 SDNN^2 - Var(dRR)/2. The sum of successive
+ * differences telescopes to last - first, so this is O(1) as well.
+ */
+void hrv_get_poincare(float *sd1, float *sd2)
+{
+    int m = hrv_state.sample_count - 1; // Number of successive differences
+
+    *sd1 = 0.0f;
+    *sd2 = 0.0f;
+
+    if (m < 2) {
+        return;
+    }
+
+    int32_t diff_sum = (int32_t)hrv_rr_at_seq(hrv_state.seq - 1) - (int32_t)hrv_rr_at_seq(hrv_state.seq - hrv_state.sample_count);
+    double diff_var = ((double)hrv_state.diff_sum_sq - (double)diff_sum * diff_sum / m) / (m - 1);
+    float sdnn = hrv_calculate_sdnn();
+    double sd2_sq = 2.0 * sdnn * sdnn - 0.5 * diff_var;
+
+    *sd1 = (diff_var > 0.0) ? sqrtf((float)(0.5 * diff_var)) : 0.0f;
+    *sd2 = (sd2_sq > 0.0) ? sqrtf((float)sd2_sq) : 0.0f;
+}
+
+/**
+ * @brief Mean squared residual of linear fits over boxes of n beats
+ * @param n Box length in beats
+ * @param first Sequence number of the first beat analysed
+ * @param count Number of beats analysed
+ * @param mean Integer mean RR of those beats
+ * @return F(n)^2 in ms^2
+ *
+ * Integer throughout apart from the final division per box. Rounding the mean
+ * only adds a linear trend to the profile, which the box fits remove.
+ */
+static double hrv_dfa_fluctuation_sq(int n, uint32_t first, int count, int32_t mean)
+{
+    // x runs 0..n-1 in every box, so its sums are constants
+    const int64_t sx = (int64_t)n * (n - 1) / 2;
+    const int64_t sxx = (int64_t)(n - 1) * n * (2 * n - 1) / 6;
+    const int64_t x_den = n * sxx - sx * sx;
+
+    int boxes = count / n;
+    int32_t profile = 0;
+    double residual = 0.0;
+
+    for (int b = 0; b < boxes; b++) {
+        int64_t sy = 0, sxy = 0, syy = 0;
+
+        for (int x = 0; x < n; x++) {
+            profile += (int32_t)hrv_rr_at_seq(first + b * n + x) - mean;
+            sy += profile;
+            sxy += (int64_t)x * profile;
+            syy += (int64_t)profile * profile;
         }
+
+        // n * SSres = (n Syy - Sy^2) - (n Sxy - Sx Sy)^2 / (n Sxx - Sx^2)
+        int64_t y_var = n * syy - sy * sy;
+        int64_t xy_cov = n * sxy - sx * sy;
+        residual += ((double)y_var - (double)xy_cov * xy_cov / x_den) / n;
     }
-    
-    return max_val;
+
+    return residual / (boxes * n);
+}
+
+/**
+ * @brief Short-term detrended fluctuation analysis exponent
+ * @return DFA alpha1 over box sizes HRV_DFA_BOX_MIN..HRV_DFA_BOX_MAX, or 0
+ *         if the window holds fewer than HRV_DFA_MIN_BEATS beats
+ *
+ * O(window * box sizes), so it is meant to run every few beats rather than
+ * on every one.
+ */
+float hrv_calculate_dfa_alpha1(void)
+{
+    int count = hrv_state.sample_count;
+
+    if (count < HRV_DFA_MIN_BEATS) {
+        return 0.0f;
+    }
+
+    uint32_t first = hrv_state.seq - count;
+    int32_t mean = (int32_t)(hrv_state.sum / count);
+
+    // Least squares slope of log F(n) against log n
+    float sl = 0.0f, sf = 0.0f, sll = 0.0f, slf = 0.0f;
+    int points = 0;
+
+    for (int n = HRV_DFA_BOX_MIN; n <= HRV_DFA_BOX_MAX; n++) {
+        double f_sq = hrv_dfa_fluctuation_sq(n, first, count, mean);
+
+        if (f_sq <= 0.0) {
+            continue;
+        }
+
+        float l = logf((float)n);
+        float f = 0.5f * logf((float)f_sq);
+        sl += l;
+        sf += f;
+        sll += l * l;
+        slf += l * f;
+        points++;
+    }
+
+    float den = points * sll - sl * sl;
+    if (points < 2 || den <= 0.0f) {
+        return 0.0f;
+    }
+
+    return (points * slf - sl * sf) / den;
+}
+
+/**
+ * @brief Median of the raw RR history
+ * @return Median RR interval in milliseconds
+ */
+static uint16_t hrv_clean_median(void)
+{
+    uint16_t sorted[HRV_CLEAN_MEDIAN_LEN];
+    int n = hrv_clean.history_len;
+
+    // Insertion sort of at most HRV_CLEAN_MEDIAN_LEN values
+    for (int i = 0; i < n; i++) {
+        uint16_t v = hrv_clean.history[i];
+        int j = i;
+        while (j > 0 && sorted[j - 1] > v) {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+        sorted[j] = v;
+    }
+
+    return sorted[n / 2];
+}
+
+static void hrv_clean_push_history(uint16_t rr)
+{
+    hrv_clean.history[hrv_clean.history_pos] = rr;
+    hrv_clean.history_pos = (hrv_clean.history_pos + 1) % HRV_CLEAN_MEDIAN_LEN;
+    if (hrv_clean.history_len < HRV_CLEAN_MEDIAN_LEN) {
+        hrv_clean.history_len++;
+    }
+}
+
+static inline bool hrv_clean_near(int32_t value, int32_t target, int32_t threshold)
+{
+    return value >= target - threshold && value <= target + threshold;
+}
+
+static inline void hrv_clean_emit(hrv_clean_out_t *out, int *n, uint32_t rr, bool corrected)
+{
+    out[*n].rr = (uint16_t)rr;
+    out[*n].corrected = corrected;
+    (*n)++;
+}
+
+/**
+ * @brief Run one raw RR interval through the artifact stage
+ * @param rr Raw RR interval in milliseconds
+ * @param out Cleaned intervals to add to the HRV window, oldest first
+ * @return Number of intervals written to out (0 to HRV_CLEAN_MAX_OUT)
+ *
+ * A short interval is held for one beat to tell an extra beat (short+next
+ * is one normal interval) from a premature beat (short+next is two).
+ */
+static int hrv_clean_rr(int32_t rr, hrv_clean_out_t *out)
+{
+    int n = 0;
+    bool in_range = (rr >= HRV_RR_MIN_MS && rr <= HRV_RR_MAX_MS);
+
+    if (hrv_clean.history_len < HRV_CLEAN_MIN_HISTORY) {
+        // No reference yet, so only the physiological range can be checked
+        if (in_range) {
+            hrv_clean_push_history((uint16_t)rr);
+            hrv_clean_emit(out, &n, rr, false);
+        }
+        return n;
+    }
+
+    int32_t median = hrv_clean_median();
+    int32_t threshold = (int32_t)CONFIG_HPI_HRV_ARTIFACT_THRESHOLD_MS * median / 1000;
+
+    // Out of range intervals stay out of the history; everything else goes in,
+    // so the median follows a genuine rate change within a few beats
+    if (in_range) {
+        hrv_clean_push_history((uint16_t)rr);
+    }
+
+    if (hrv_clean.pending) {
+        int32_t sum = hrv_clean.pending + rr;
+        hrv_clean.pending = 0;
+
+        if (hrv_clean_near(sum, median, threshold)) {
+            // Extra beat: drop the spurious detection in between
+            hrv_clean_emit(out, &n, sum, true);
+            return n;
+        }
+        if (hrv_clean_near(sum, 2 * median, threshold)) {
+            // Premature beat and compensatory pause
+            hrv_clean_emit(out, &n, sum / 2, true);
+            hrv_clean_emit(out, &n, sum - sum / 2, true);
+            return n;
+        }
+
+        // Isolated short interval, then judge rr on its own
+        hrv_clean_emit(out, &n, median, true);
+    }
+
+    if (hrv_clean_near(rr, median, threshold)) {
+        hrv_clean_emit(out, &n, rr, false);
+    } else if (rr < median) {
+        hrv_clean.pending = (uint16_t)MAX(rr, 1);
+    } else if (hrv_clean_near(rr, 2 * median, 2 * threshold)) {
+        // Missed beat
+        hrv_clean_emit(out, &n, rr / 2, true);
+        hrv_clean_emit(out, &n, rr - rr / 2, true);
+    } else if (hrv_clean_near(rr, 3 * median, 3 * threshold)) {
+        hrv_clean_emit(out, &n, rr / 3, true);
+        hrv_clean_emit(out, &n, rr / 3, true);
+        hrv_clean_emit(out, &n, rr - 2 * (rr / 3), true);
+    } else {
+        hrv_clean_emit(out, &n, median, true);
+    }
+
+    return n;
 }
 
 /**
@@ -206,12 +481,13 @@ static uint32_t hrv_calculate_max(void)
 void hrv_reset(void)
 {
     memset(&hrv_state, 0, sizeof(hrv_state_t));
+    memset(&hrv_clean, 0, sizeof(hrv_clean_state_t));
     LOG_DBG("HRV calculation state reset");
 }
 
 /**
- * @brief Get current number of samples in the buffer
- * @return Number of samples (0 to HRV_LIMIT)
+ * @brief Get current number of samples in the window
+ * @return Number of samples (0 to HRV_WINDOW_SIZE)
  */
 int hrv_get_sample_count(void)
 {
@@ -227,9 +503,22 @@ bool hrv_is_ready(void)
     return hrv_state.sample_count >= HRV_LIMIT;
 }
 
+/**
+ * @brief Share of the window produced or changed by artifact correction
+ * @return Artifact percentage (0 to 100)
+ */
+uint8_t hrv_get_artifact_percent(void)
+{
+    if (hrv_state.sample_count == 0) {
+        return 0;
+    }
+
+    return (uint8_t)(hrv_state.artifact_count * 100 / hrv_state.sample_count);
+}
+
 /**
  * @brief Main HRV calculation function
- * @param rr_interval New RR interval in milliseconds
+ * @param rr_interval New raw RR interval in milliseconds, cleaned before use
  * @param hrv_max Pointer to store maximum RR interval
  * @param hrv_min Pointer to store minimum RR interval  
  * @param mean Pointer to store mean RR interval
@@ -248,13 +537,17 @@ void calculate_hrv(int32_t rr_interval, int32_t *hrv_max, int32_t *hrv_min,
         return;
     }
     
-    // Validate RR interval range (typical human range: 300-2000ms)
-    if (rr_interval < 300 || rr_interval > 2000) {
-        LOG_WRN("RR interval %d ms out of typical range", rr_interval);
+    // Artifact stage first; one raw beat can yield zero to a few clean ones
+    hrv_clean_out_t clean[HRV_CLEAN_MAX_OUT];
+    int num_clean = hrv_clean_rr(rr_interval, clean);
+
+    if (num_clean == 0) {
+        LOG_DBG("RR interval %d ms held or rejected", rr_interval);
+    }
+
+    for (int i = 0; i < num_clean; i++) {
+        hrv_add_sample(clean[i].rr, clean[i].corrected);
     }
-    
-    // Add new sample to buffer
-    hrv_add_sample((uint32_t)rr_interval);
     
     // Calculate metrics
     *mean = hrv_calculate_mean();
@@ -265,13 +558,13 @@ void calculate_hrv(int32_t rr_interval, int32_t *hrv_max, int32_t *hrv_min,
     *hrv_min = (int32_t)hrv_calculate_min();
     *hrv_ready_flag = hrv_is_ready();
     
-    LOG_DBG("HRV: RR=%d, Mean=%.1f, SDNN=%.1f, RMSSD=%.1f, pNN50=%.3f, Ready=%s",
-            rr_interval, *mean, *sdnn, *rmssd, *pnn50, 
+    LOG_DBG("HRV: RR=%d, Mean=%.1f, SDNN=%.1f, RMSSD=%.1f, pNN50=%.3f, Artifacts=%u%%, Ready=%s",
+            rr_interval, *mean, *sdnn, *rmssd, *pnn50, hrv_get_artifact_percent(),
             *hrv_ready_flag ? "true" : "false");
 }
 
 /**
- * @brief Get raw RR interval buffer for frequency domain analysis
+ * @brief Get the most recent RR intervals, oldest first, for frequency domain analysis
  * @param buffer Pointer to buffer to copy RR intervals to
  * @param buffer_size Size of the buffer
  * @return Number of samples copied
@@ -282,63 +575,13 @@ int hrv_get_rr_intervals(float *buffer, int buffer_size)
         return 0;
     }
     
-    int count = hrv_state.buffer_full ? HRV_LIMIT : hrv_state.sample_count;
-    int samples_to_copy = (count < buffer_size) ? count : buffer_size;
-    
+    int samples_to_copy = MIN(hrv_state.sample_count, buffer_size);
+    int first = hrv_state.sample_count - samples_to_copy;
+
+    // Oldest first, so the series is in beat order
     for (int i = 0; i < samples_to_copy; i++) {
-        buffer[i] = (float)hrv_state.rr_intervals[i];
+        buffer[i] = (float)hrv_state.rr_intervals[(hrv_state.head + first + i) % HRV_WINDOW_SIZE];
     }
     
     return samples_to_copy;
 }
-
-/**
- * @brief Update HRV screens with new RR interval data
- * @param rr_interval New RR interval in milliseconds
- */
-void update_hrv_screens_with_new_data(float rr_interval)
-{
-    // Calculate HRV metrics using optimized algorithm
-    int32_t hrv_max, hrv_min;
-    float mean, sdnn, pnn50, rmssd;
-    bool hrv_ready;
-
-    calculate_hrv((int32_t)rr_interval, &hrv_max, &hrv_min, &mean, &sdnn, &pnn50, &rmssd, &hrv_ready);
-
-    if (hrv_ready) {
-        // Update HRV Summary Screen
-        extern void hpi_hrv_summary_update_metrics(float sdnn, float rmssd, float pnn50, float mean_rr);
-        extern void hpi_hrv_summary_draw_rr_plot(float rr_interval);
-        
-        hpi_hrv_summary_update_metrics(sdnn, rmssd, pnn50, mean);
-        hpi_hrv_summary_draw_rr_plot(rr_interval);
-
-        // Update HRV Frequency Screen (less frequently for performance)
-        static int freq_update_counter = 0;
-        if (++freq_update_counter >= 10) {
-            static float rr_buffer[HRV_LIMIT];
-            int sample_count = hrv_get_rr_intervals(rr_buffer, HRV_LIMIT);
-            
-            if (sample_count >= HRV_LIMIT) {
-                extern void hpi_hrv_frequency_compact_update_spectrum(float *rr_intervals, int num_intervals);
-                hpi_hrv_frequency_compact_update_spectrum(rr_buffer, sample_count);
-            }
-            freq_update_counter = 0;
-        }
-    }
-}
-
-/**
- * @brief Callback for new RR interval detection from sensor
- * @param rr_ms RR interval in milliseconds
- */
-void on_new_rr_interval_detected(float rr_ms)
-{
-
-    
-    hpi_disp_hrv_update_rtor((int)rr_ms);
-    hpi_disp_hrv_draw_plot_rtor(rr_ms);
-
-    // Update new optimized HRV screens
-    update_hrv_screens_with_new_data(rr_ms);
-}
\ No newline at end of file
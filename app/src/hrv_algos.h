@@ -37,7 +37,16 @@
 
 #define FILTERORDER 161 /* DC Removal Numerator Coeff*/
 #define NRCOEFF (0.992)
-#define HRV_LIMIT 20
+#define HRV_LIMIT 20 // Beats needed before HRV metrics are reported
+
+// Sliding window of RR intervals the HRV metrics cover, sized for a standard
+// 5 minute short-term recording
+#define HRV_WINDOW_SIZE CONFIG_HPI_HRV_WINDOW_BEATS
+
+// Short-term DFA box sizes in beats, and the beats needed for enough boxes
+#define HRV_DFA_BOX_MIN 4
+#define HRV_DFA_BOX_MAX 16
+#define HRV_DFA_MIN_BEATS (4 * HRV_DFA_BOX_MAX)
 
 void calculate_pnn_rmssd(unsigned int array[], float *pnn50, float *rmssd);
 float calculate_sdnn(unsigned int array[]);
@@ -46,6 +55,13 @@ int calculate_hrvmin(unsigned int array[]);
 int calculate_hrvmax(unsigned int array[]);
 //struct calculate_hrv(uint8_t heart_rate);
 void calculate_hrv (int32_t heart_rate, int32_t *hrv_max, int32_t *hrv_min, float *mean, float *sdnn, float *pnn, float *rmssd, bool *hrv_ready_flag);
+void hrv_reset(void);
+int hrv_get_sample_count(void);
+bool hrv_is_ready(void);
+uint8_t hrv_get_artifact_percent(void);
+void hrv_get_poincare(float *sd1, float *sd2);
+float hrv_calculate_dfa_alpha1(void);
+int hrv_get_rr_intervals(float *buffer, int buffer_size);
 
 // GSR Stress Index calculation
 #if defined(CONFIG_HPI_GSR_STRESS_INDEX)
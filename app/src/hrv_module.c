@@ -0,0 +1,140 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/zbus/zbus.h>
+#include <string.h>
+
+#include "hrv_module.h"
+#include "hrv_algos.h"
+#include "hrv_spectrum.h"
+#include "hpi_common_types.h"
+
+LOG_MODULE_REGISTER(hrv_module, LOG_LEVEL_INF);
+
+#define HRV_THREAD_STACKSIZE 2048
+#define HRV_THREAD_PRIORITY 9 // Below data and storage, HRV is not time critical
+
+// Recompute the spectrum and DFA alpha1 every this many beats
+#define HRV_SPECTRUM_EVERY_BEATS 10
+
+K_MSGQ_DEFINE(q_hrv_rr, sizeof(uint16_t), 32, 2);
+
+extern struct k_msgq q_plot_hrv;
+
+// Owned by the HRV thread
+static float hrv_rr_buffer[HRV_WINDOW_SIZE];
+static int hrv_beats_since_spectrum;
+static float hrv_dfa_alpha1;
+
+static atomic_t hrv_reset_pending;
+
+void hpi_hrv_submit_rr(uint16_t rr_ms)
+{
+    if (k_msgq_put(&q_hrv_rr, &rr_ms, K_NO_WAIT) != 0)
+    {
+        LOG_WRN("HRV queue full, RR %u ms dropped", rr_ms);
+    }
+}
+
+void hpi_hrv_reset(void)
+{
+    // Applied by the HRV thread before the next beat, so the caller never blocks
+    k_msgq_purge(&q_hrv_rr);
+    atomic_set(&hrv_reset_pending, 1);
+}
+
+static void hrv_process_rr(uint16_t rr_ms)
+{
+    struct hpi_computed_hrv_t hrv = {0};
+
+    calculate_hrv(rr_ms, &hrv.hrv_max, &hrv.hrv_min, &hrv.mean, &hrv.sdnn, &hrv.pnn, &hrv.rmssd,
+                  &hrv.hrv_ready_flag);
+    hrv.rr_ms = rr_ms;
+    hrv.artifact_pct = hrv_get_artifact_percent();
+
+    hrv_get_poincare(&hrv.sd1, &hrv.sd2);
+    hrv.sd1_sd2 = (hrv.sd2 > 0.0f) ? hrv.sd1 / hrv.sd2 : 0.0f;
+
+    if (hrv.hrv_ready_flag && ++hrv_beats_since_spectrum >= HRV_SPECTRUM_EVERY_BEATS)
+    {
+        int n = hrv_get_rr_intervals(hrv_rr_buffer, HRV_WINDOW_SIZE);
+
+        hrv.spectrum_updated = (hrv_spectrum_compute(hrv_rr_buffer, n, &hrv.spectrum) == 0);
+        hrv_dfa_alpha1 = hrv_calculate_dfa_alpha1();
+        hrv_beats_since_spectrum = 0;
+    }
+    hrv.dfa_alpha1 = hrv_dfa_alpha1;
+
+    // Nobody drains the queue while the display is off; the newest beat
+    // matters more than the oldest, so make room for it
+    if (k_msgq_put(&q_plot_hrv, &hrv, K_NO_WAIT) != 0)
+    {
+        struct hpi_computed_hrv_t stale;
+
+        k_msgq_get(&q_plot_hrv, &stale, K_NO_WAIT);
+        k_msgq_put(&q_plot_hrv, &hrv, K_NO_WAIT);
+    }
+}
+
+#if defined(CONFIG_HPI_ECG_RPEAK_DETECTOR)
+static void hrv_beat_listener(const struct zbus_channel *chan)
+{
+    const struct hpi_ecg_beat_t *beat = zbus_chan_const_msg(chan);
+
+    // The first beat after a (re)start has no interval
+    if (beat->rr_us > 0)
+    {
+        hpi_hrv_submit_rr((uint16_t)MIN((beat->rr_us + 500) / 1000, UINT16_MAX));
+    }
+}
+ZBUS_LISTENER_DEFINE(hrv_beat_lis, hrv_beat_listener);
+#endif
+
+static void hrv_thread(void)
+{
+    uint16_t rr_ms;
+
+    for (;;)
+    {
+        k_msgq_get(&q_hrv_rr, &rr_ms, K_FOREVER);
+
+        if (atomic_cas(&hrv_reset_pending, 1, 0))
+        {
+            hrv_reset();
+            hrv_beats_since_spectrum = 0;
+            hrv_dfa_alpha1 = 0.0f;
+        }
+
+        hrv_process_rr(rr_ms);
+    }
+}
+
+K_THREAD_DEFINE(hrv_thread_id, HRV_THREAD_STACKSIZE, hrv_thread, NULL, NULL, NULL, HRV_THREAD_PRIORITY, 0, 0);
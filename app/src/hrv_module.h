@@ -0,0 +1,57 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef hrv_module_h
+#define hrv_module_h
+
+#include <stdint.h>
+
+/*
+HRV service. RR intervals from the ECG front end (the R-peak detector in
+ecg_rpeak.c, or the MAX30001 RTOR register without it) are queued to a
+dedicated thread that runs the time and frequency domain analysis and
+publishes struct hpi_computed_hrv_t on q_plot_hrv. It has no display dependency, so
+HRV keeps running with the screen off; the display thread only renders.
+*/
+
+/**
+ * @brief Queue a new RR interval for analysis
+ * @param rr_ms RR interval in milliseconds
+ *
+ * Safe to call from any thread; drops the interval if the service is behind.
+ */
+void hpi_hrv_submit_rr(uint16_t rr_ms);
+
+/**
+ * @brief Drop all RR history, e.g. when the ECG leads come off
+ */
+void hpi_hrv_reset(void);
+
+#endif
@@ -0,0 +1,225 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+#include <arm_math.h>
+
+#include "hrv_spectrum.h"
+
+LOG_MODULE_REGISTER(hrv_spectrum, LOG_LEVEL_INF);
+
+BUILD_ASSERT(HRV_SPECTRUM_FFT_LEN >= 256 && HRV_SPECTRUM_FFT_LEN <= 4096 &&
+                 (HRV_SPECTRUM_FFT_LEN & (HRV_SPECTRUM_FFT_LEN - 1)) == 0,
+             "arm_rfft_fast_f32 needs a power of two length");
+
+#define VLF_FREQ_MIN 0.0033f
+#define LF_FREQ_MIN 0.04f
+#define HF_FREQ_MIN 0.15f
+#define HF_FREQ_MAX 0.4f
+
+static arm_rfft_fast_instance_f32 rfft_instance;
+static bool rfft_ready;
+
+// Resampled tachogram in, packed complex spectrum out
+static float tachogram[HRV_SPECTRUM_FFT_LEN];
+static float spectrum_buf[HRV_SPECTRUM_FFT_LEN];
+
+/**
+ * @brief Cubic Hermite interpolation of the tachogram within one interval
+ * @param rr_ms RR series
+ * @param num_intervals Length of the series
+ * @param seg Interval whose end beat closes the segment, at least 1
+ * @param frac Position between beat seg-1 (0) and beat seg (1)
+ *
+ * Tangents are central differences over the non-uniform beat times. Linear
+ * interpolation low-pass filters the series and loses a fifth or more of
+ * the HF power at resting heart rates.
+ */
+static float hrv_spectrum_interp(const float *rr_ms, int num_intervals, int seg, float frac)
+{
+    float y0 = rr_ms[seg - 1];
+    float y1 = rr_ms[seg];
+    float h = rr_ms[seg];
+
+    float m0 = (seg >= 2) ? (y1 - rr_ms[seg - 2]) / (rr_ms[seg - 1] + h) : (y1 - y0) / h;
+    float m1 = (seg + 1 < num_intervals) ? (rr_ms[seg + 1] - y0) / (h + rr_ms[seg + 1]) : (y1 - y0) / h;
+
+    float f2 = frac * frac;
+    float f3 = f2 * frac;
+
+    return (2.0f * f3 - 3.0f * f2 + 1.0f) * y0 + (f3 - 2.0f * f2 + frac) * h * m0 +
+           (-2.0f * f3 + 3.0f * f2) * y1 + (f3 - f2) * h * m1;
+}
+
+/**
+ * @brief Resample the newest part of the RR series onto a uniform grid
+ * @return Number of samples written, at most HRV_SPECTRUM_FFT_LEN
+ */
+static int hrv_spectrum_resample(const float *rr_ms, int num_intervals)
+{
+    const float dt_ms = 1000.0f / HRV_SPECTRUM_FS_HZ;
+
+    // Walk back from the newest beat until the span fills the FFT
+    float span_ms = 0.0f;
+    int first = num_intervals - 1;
+    while (first > 0 && span_ms + rr_ms[first] < HRV_SPECTRUM_FFT_LEN * dt_ms) {
+        span_ms += rr_ms[first];
+        first--;
+    }
+
+    if (span_ms <= 0.0f) {
+        return 0;
+    }
+
+    // Each interval is placed at the time of the beat that ends it. Beat times
+    // are relative to the end of rr_ms[first], so the grid starts at 0.
+    int n = MIN((int)(span_ms / dt_ms) + 1, HRV_SPECTRUM_FFT_LEN);
+    int seg = first + 1;
+    float seg_start = 0.0f;
+
+    for (int i = 0; i < n; i++) {
+        float t = i * dt_ms;
+
+        while (seg < num_intervals - 1 && seg_start + rr_ms[seg] < t) {
+            seg_start += rr_ms[seg];
+            seg++;
+        }
+
+        tachogram[i] = hrv_spectrum_interp(rr_ms, num_intervals, seg, MIN((t - seg_start) / rr_ms[seg], 1.0f));
+    }
+
+    return n;
+}
+
+/**
+ * @brief Remove the least squares line and apply a Hann window in place
+ * @return Sum of squared window coefficients, for PSD scaling
+ */
+static float hrv_spectrum_detrend_window(int n)
+{
+    // x is centred on 0 so slope and intercept decouple
+    float xm = (n - 1) / 2.0f;
+    float sy = 0.0f, sxy = 0.0f, sxx = 0.0f;
+
+    for (int i = 0; i < n; i++) {
+        float x = i - xm;
+        sy += tachogram[i];
+        sxy += x * tachogram[i];
+        sxx += x * x;
+    }
+
+    float mean = sy / n;
+    float slope = sxy / sxx;
+    float wsum_sq = 0.0f;
+
+    for (int i = 0; i < n; i++) {
+        float w = 0.5f - 0.5f * cosf(2.0f * PI * i / (n - 1));
+        tachogram[i] = (tachogram[i] - mean - slope * (i - xm)) * w;
+        wsum_sq += w * w;
+    }
+
+    // Zero pad up to the transform length
+    memset(&tachogram[n], 0, (HRV_SPECTRUM_FFT_LEN - n) * sizeof(float));
+
+    return wsum_sq;
+}
+
+int hrv_spectrum_compute(const float *rr_ms, int num_intervals, struct hpi_hrv_spectrum_t *spectrum)
+{
+    if (rr_ms == NULL || spectrum == NULL) {
+        return -EINVAL;
+    }
+
+    memset(spectrum, 0, sizeof(*spectrum));
+    spectrum->num_intervals = (uint16_t)MAX(num_intervals, 0);
+
+    if (num_intervals < 3) {
+        return -ENODATA;
+    }
+
+    if (!rfft_ready) {
+        if (arm_rfft_fast_init_f32(&rfft_instance, HRV_SPECTRUM_FFT_LEN) != ARM_MATH_SUCCESS) {
+            LOG_ERR("RFFT init failed for length %d", HRV_SPECTRUM_FFT_LEN);
+            return -EINVAL;
+        }
+        rfft_ready = true;
+    }
+
+    int n = hrv_spectrum_resample(rr_ms, num_intervals);
+
+    spectrum->duration_s = (uint16_t)(n / HRV_SPECTRUM_FS_HZ);
+    if (spectrum->duration_s < HRV_SPECTRUM_MIN_SECONDS) {
+        return -ENODATA;
+    }
+
+    float wsum_sq = hrv_spectrum_detrend_window(n);
+
+    arm_rfft_fast_f32(&rfft_instance, tachogram, spectrum_buf, 0);
+
+    // Output is packed as [DC, Nyquist, re1, im1, re2, im2, ...]. One-sided
+    // periodogram: P[k] = 2|X[k]|^2 / (fs * sum(w^2)), integrated over df.
+    const float df = (float)HRV_SPECTRUM_FS_HZ / HRV_SPECTRUM_FFT_LEN;
+    const float scale = 2.0f / (HRV_SPECTRUM_FS_HZ * wsum_sq) * df;
+
+    for (int k = 1; k < HRV_SPECTRUM_FFT_LEN / 2; k++) {
+        float f = k * df;
+
+        if (f < VLF_FREQ_MIN) {
+            continue;
+        }
+        if (f >= HF_FREQ_MAX) {
+            break;
+        }
+
+        float re = spectrum_buf[2 * k];
+        float im = spectrum_buf[2 * k + 1];
+        float p = (re * re + im * im) * scale;
+
+        if (f < LF_FREQ_MIN) {
+            spectrum->vlf_power += p;
+        } else if (f < HF_FREQ_MIN) {
+            spectrum->lf_power += p;
+        } else {
+            spectrum->hf_power += p;
+        }
+    }
+
+    spectrum->lf_hf_ratio = (spectrum->hf_power > 0.0f) ? spectrum->lf_power / spectrum->hf_power : 0.0f;
+    spectrum->valid = true;
+
+    LOG_DBG("HRV spectrum: %d beats, %d s, VLF=%.1f LF=%.1f HF=%.1f",
+            num_intervals, spectrum->duration_s, (double)spectrum->vlf_power,
+            (double)spectrum->lf_power, (double)spectrum->hf_power);
+
+    return 0;
+}
@@ -0,0 +1,62 @@
+/*
+ * HealthyPi Move
+ * 
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+/*
+Frequency domain HRV. The RR tachogram is resampled to a uniform 4 Hz series
+with cubic interpolation, linearly detrended, Hann windowed and transformed
+with arm_rfft_fast_f32(). Band powers are integrated from the one-sided
+periodogram in ms^2, using the standard VLF/LF/HF bands.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hpi_common_types.h"
+
+#define HRV_SPECTRUM_FS_HZ 4
+
+// Shortest tachogram analysed; LF needs several cycles of a 25 s period
+#define HRV_SPECTRUM_MIN_SECONDS 60
+
+// Longest tachogram analysed, the most recent beats are used
+#define HRV_SPECTRUM_FFT_LEN CONFIG_HPI_HRV_FFT_LEN
+
+/**
+ * @brief Compute VLF/LF/HF band powers of an RR series
+ * @param rr_ms RR intervals in milliseconds, oldest first
+ * @param num_intervals Number of intervals
+ * @param spectrum Result; valid is false if the series is too short
+ * @return 0 on success, -EINVAL on bad arguments, -ENODATA if too short
+ *
+ * Uses static work buffers, so only one thread may call it.
+ */
+int hrv_spectrum_compute(const float *rr_ms, int num_intervals, struct hpi_hrv_spectrum_t *spectrum);
@@ -76,6 +76,8 @@
 #include "hw_module.h"
 #include "battery_module.h"
 #include "fs_module.h"
+#include "log_module.h"
+#include "storage_module.h"
 #include "ui/move_ui.h"
 #include "hpi_common_types.h"
 #include "ble_module.h"
@@ -333,6 +335,7 @@ static void gpio_keys_cb_handler(struct input_event *evt, void *user_data)
 void hpi_hw_pmic_off(void)
 {
     LOG_INF("Entering Ship Mode");
+    hpi_log_trend_flush_all();
     k_msleep(1000);
     regulator_parent_ship_mode(regulators);
 }
@@ -805,6 +808,7 @@ void hw_module_init(void)
             LOG_INF("MAX32664C probe failed; creating reboot marker and rebooting to recover I2C bus");
             uint8_t marker_data[1] = {1};
             fs_write_buffer_to_file((char *)max32664c_reboot_marker, marker_data, sizeof(marker_data));
+            hpi_storage_flush();
             int exists = fs_check_file_exists(max32664c_reboot_marker);
             if (exists != 0)
             {
@@ -32,15 +32,20 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/device.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <zephyr/fs/fs.h>
 #include <zephyr/fs/littlefs.h>
+#include <zephyr/sys/crc.h>
 #include <time.h>
 
 #include "log_module.h"
 #include "cmd_module.h"
 #include "fs_module.h"
 #include "ui/move_ui.h"
+#include "storage_module.h"
+#include "hpi_sys.h"
 
 LOG_MODULE_REGISTER(log_module, LOG_LEVEL_DBG);
 
@@ -68,90 +73,1360 @@ static const char* const log_paths[] = {
 
 #define LOG_PATHS_COUNT (sizeof(log_paths) / sizeof(log_paths[0]))
 
+// Largest index page sent for one paged index request
+#define LOG_INDEX_PAGE_MAX 64
+#define LOG_MANIFEST_READ_BATCH 8
+
+// Write-back cache for trend points, one per trend log type
+#define TREND_CACHE_SIZE (HPI_TREND_CACHE_MAX_BYTES / 2)   // 16 trend points of HPI_TREND_POINT_SIZE
+#define TREND_CACHE_COUNT (HPI_LOG_TYPE_TREND_BPT - HPI_LOG_TYPE_TREND_HR + 1)
+
+struct hpi_trend_cache
+{
+    int64_t day_ts;               // Day file the buffered points belong to
+    int64_t first_point_uptime;   // Uptime of the oldest buffered point
+    uint16_t fill;
+    uint8_t record_size;
+    uint8_t active;               // Buffer taking new points
+    bool flush_queued;            // A flush job is waiting on the storage thread
+    // The other buffer, full and waiting to be written to its day file
+    int64_t pending_day_ts;
+    uint16_t pending_fill;
+    uint8_t pending_record_size;
+    uint8_t buf[2][TREND_CACHE_SIZE];
+    struct hpi_trend_cache_stats_t stats;
+};
+
+static struct hpi_trend_cache trend_cache[TREND_CACHE_COUNT];
+K_MUTEX_DEFINE(trend_cache_mutex);
+// Serialises trend day file writes, migration and eviction. Taken before
+// trend_cache_mutex when both are needed.
+K_MUTEX_DEFINE(trend_file_mutex);
+
+// Copy buffer for day file migration, protected by trend_file_mutex
+static uint8_t trend_file_buf[TREND_CACHE_SIZE];
+
+// Streaming record writer, runs as jobs on the storage thread
+#define RECORD_SYNC_INTERVAL_CHUNKS 8   // fs_sync every ~8 s of ECG at 128 SPS
+#define RECORD_CTRL_PUT_TIMEOUT_MS 100
+
+K_MEM_SLAB_DEFINE_STATIC(record_chunk_slab, HPI_RECORD_CHUNK_SIZE, CONFIG_HPI_RECORD_CHUNK_COUNT, 4);
+
+// Open record state, only touched on the storage thread
+static struct fs_file_t record_file;
+static char record_fname[50];
+static bool record_file_open;
+static uint32_t record_bytes_written;
+static uint32_t record_crc;
+static uint8_t record_log_type;
+static int64_t record_start_ts;
+static uint16_t record_chunks_since_sync;
+
 // Externs
 extern struct fs_mount_t *mp;
 extern const char *hpi_sys_update_time_file;
 
-static int hpi_log_get_path(char *m_path, uint8_t m_log_type)
+int hpi_log_get_path(char *m_path, uint8_t m_log_type)
+{
+    if (m_path == NULL) {
+        LOG_ERR("Invalid path parameter");
+        return -EINVAL;
+    }
+
+    if (m_log_type < LOG_PATHS_COUNT && log_paths[m_log_type] != NULL) {
+        strcpy(m_path, log_paths[m_log_type]);
+    } else {
+        strcpy(m_path, "/lfs/log/");
+    }
+
+    return 0;
+}
+
+// Timestamp validation function
+// Returns true if timestamp is valid (after Jan 1, 2020 and before Jan 1, 2030)
+// This prevents log files from being created with invalid timestamps that could
+// indicate system time is not properly synchronized or corrupted.
+static bool is_timestamp_valid(int64_t timestamp)
+{
+    // Define reasonable timestamp bounds for the HealthyPi Move device
+    // Jan 1, 2020 00:00:00 UTC = 1577836800 seconds since epoch
+    const int64_t MIN_VALID_TIMESTAMP = 1577836800L;
+    // Jan 1, 2030 00:00:00 UTC = 1893456000 seconds since epoch  
+    const int64_t MAX_VALID_TIMESTAMP = 1893456000L;
+    
+    return (timestamp >= MIN_VALID_TIMESTAMP && timestamp <= MAX_VALID_TIMESTAMP);
+}
+
+// Per log type manifest (<dir>/manifest.idx): a header followed by one entry
+// per data file, kept up to date by the trend and record writers so counts
+// and indexes need no directory walk or per-file fs_stat. A missing or
+// corrupt manifest is rebuilt from the directory on first use.
+#define LOG_MANIFEST_FILE "manifest.idx"
+#define LOG_MANIFEST_MAGIC 0x464E4D48 // "HMNF"
+#define LOG_MANIFEST_VERSION 1
+
+struct log_manifest_hdr
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t log_type;
+    uint16_t reserved;
+} __packed;
+
+static bool manifest_loaded[LOG_PATHS_COUNT];
+static uint16_t manifest_count[LOG_PATHS_COUNT];
+static uint8_t manifest_buf[256];
+K_MUTEX_DEFINE(log_manifest_mutex);
+
+static int manifest_path(char *path, size_t len, uint8_t log_type)
+{
+    char base_path[20];
+
+    if (log_type >= LOG_PATHS_COUNT || log_paths[log_type] == NULL) {
+        return -EINVAL;
+    }
+
+    hpi_log_get_path(base_path, log_type);
+    snprintf(path, len, "%s%s", base_path, LOG_MANIFEST_FILE);
+    return 0;
+}
+
+// CRC32 of a data file, excluding the trend day file header
+static uint32_t manifest_file_crc(const char *fname)
+{
+    struct fs_file_t file;
+    uint32_t crc = 0;
+    uint32_t magic = 0;
+    int ret;
+
+    fs_file_t_init(&file);
+    if (fs_open(&file, fname, FS_O_READ) != 0) {
+        return 0;
+    }
+
+    if (fs_read(&file, &magic, sizeof(magic)) != sizeof(magic) || magic != HPI_TREND_FILE_MAGIC) {
+        fs_seek(&file, 0, FS_SEEK_SET);
+    } else {
+        fs_seek(&file, HPI_TREND_FILE_HDR_SIZE, FS_SEEK_SET);
+    }
+
+    while ((ret = fs_read(&file, manifest_buf, sizeof(manifest_buf))) > 0) {
+        crc = crc32_ieee_update(crc, manifest_buf, ret);
+    }
+
+    fs_close(&file);
+    return crc;
+}
+
+// Must be called with log_manifest_mutex held
+static int manifest_rebuild_locked(uint8_t log_type)
+{
+    struct log_manifest_hdr hdr = {
+        .magic = LOG_MANIFEST_MAGIC,
+        .version = LOG_MANIFEST_VERSION,
+        .log_type = log_type,
+    };
+    static struct fs_dirent entry;
+    struct fs_dir_t dirp;
+    struct fs_file_t file;
+    char m_path[40];
+    char fname[60];
+    uint16_t count = 0;
+    int ret;
+
+    hpi_log_get_path(m_path, log_type);
+    manifest_path(fname, sizeof(fname), log_type);
+
+    LOG_INF("Rebuilding manifest %s", fname);
+
+    fs_file_t_init(&file);
+    CHECK_FS_OP(fs_open(&file, fname, FS_O_CREATE | FS_O_WRITE | FS_O_TRUNC), "open", fname);
+
+    ret = fs_write(&file, &hdr, sizeof(hdr));
+
+    fs_dir_t_init(&dirp);
+    if (ret >= 0 && fs_opendir(&dirp, m_path) == 0) {
+        for (;;) {
+            if (fs_readdir(&dirp, &entry) || entry.name[0] == 0) {
+                break;
+            }
+
+            // Skip directories and derived files such as trend rollups and the manifest
+            if (entry.type == FS_DIR_ENTRY_DIR || strchr(entry.name, '.') != NULL) {
+                continue;
+            }
+
+            char data_name[60];
+            snprintf(data_name, sizeof(data_name), "%s%s", m_path, entry.name);
+
+            struct hpi_log_manifest_entry_t m_entry = {
+                .start_ts = strtoll(entry.name, NULL, 10),
+                .length = entry.size,
+                .crc = manifest_file_crc(data_name),
+                .log_type = log_type,
+            };
+
+            ret = fs_write(&file, &m_entry, sizeof(m_entry));
+            if (ret < 0) {
+                break;
+            }
+            count++;
+        }
+        fs_closedir(&dirp);
+    }
+
+    fs_close(&file);
+
+    if (ret < 0) {
+        LOG_ERR("FAIL: rebuild %s: %d", fname, ret);
+        fs_unlink(fname);
+        return ret;
+    }
+
+    manifest_count[log_type] = count;
+    manifest_loaded[log_type] = true;
+    return 0;
+}
+
+// Must be called with log_manifest_mutex held
+static int manifest_load_locked(uint8_t log_type)
+{
+    struct log_manifest_hdr hdr;
+    struct fs_dirent ent;
+    struct fs_file_t file;
+    char fname[60];
+    int ret;
+
+    if (manifest_path(fname, sizeof(fname), log_type) != 0) {
+        return -EINVAL;
+    }
+
+    if (manifest_loaded[log_type]) {
+        return 0;
+    }
+
+    if (fs_stat(fname, &ent) == 0 && ent.size >= sizeof(hdr) &&
+        (ent.size - sizeof(hdr)) % sizeof(struct hpi_log_manifest_entry_t) == 0) {
+        fs_file_t_init(&file);
+        if (fs_open(&file, fname, FS_O_READ) == 0) {
+            ret = fs_read(&file, &hdr, sizeof(hdr));
+            fs_close(&file);
+
+            if (ret == sizeof(hdr) && hdr.magic == LOG_MANIFEST_MAGIC && hdr.version == LOG_MANIFEST_VERSION) {
+                manifest_count[log_type] = (ent.size - sizeof(hdr)) / sizeof(struct hpi_log_manifest_entry_t);
+                manifest_loaded[log_type] = true;
+                return 0;
+            }
+        }
+    }
+
+    return manifest_rebuild_locked(log_type);
+}
+
+// Reads entries [first, first + count) into entries, returns the number read.
+// Must be called with log_manifest_mutex held.
+static int manifest_read_locked(uint8_t log_type, uint16_t first, uint16_t count,
+                                struct hpi_log_manifest_entry_t *entries)
+{
+    struct fs_file_t file;
+    char fname[60];
+    int ret;
+
+    manifest_path(fname, sizeof(fname), log_type);
+
+    fs_file_t_init(&file);
+    CHECK_FS_OP(fs_open(&file, fname, FS_O_READ), "open", fname);
+
+    ret = fs_seek(&file, sizeof(struct log_manifest_hdr) + (off_t)first * sizeof(*entries), FS_SEEK_SET);
+    if (ret == 0) {
+        ret = fs_read(&file, entries, count * sizeof(*entries));
+    }
+
+    fs_close(&file);
+    return (ret < 0) ? ret : (ret / (int)sizeof(*entries));
+}
+
+// Newest files are the ones being extended, so search from the end, a batch
+// of entries per read with the manifest kept open for the whole scan.
+// Must be called with log_manifest_mutex held.
+static int manifest_find_locked(uint8_t log_type, int64_t start_ts, struct hpi_log_manifest_entry_t *m_entry)
+{
+    struct hpi_log_manifest_entry_t entries[LOG_MANIFEST_READ_BATCH];
+    struct fs_file_t file;
+    char fname[60];
+    int end = manifest_count[log_type];
+    int found = -ENOENT;
+    int ret = 0;
+
+    if (end == 0) {
+        return -ENOENT;
+    }
+
+    manifest_path(fname, sizeof(fname), log_type);
+
+    fs_file_t_init(&file);
+    CHECK_FS_OP(fs_open(&file, fname, FS_O_READ), "open", fname);
+
+    while (end > 0 && found < 0 && ret >= 0) {
+        int first = MAX(end - LOG_MANIFEST_READ_BATCH, 0);
+        int n;
+
+        ret = fs_seek(&file, sizeof(struct log_manifest_hdr) + (off_t)first * sizeof(entries[0]), FS_SEEK_SET);
+        if (ret == 0) {
+            ret = fs_read(&file, entries, (end - first) * sizeof(entries[0]));
+        }
+        if (ret < 0) {
+            break;
+        }
+
+        n = ret / (int)sizeof(entries[0]);
+        for (int i = MIN(n, end - first) - 1; i >= 0; i--) {
+            if (entries[i].start_ts == start_ts) {
+                *m_entry = entries[i];
+                found = first + i;
+                break;
+            }
+        }
+
+        end = first;
+    }
+
+    fs_close(&file);
+    return found;
+}
+
+// Must be called with log_manifest_mutex held
+static int manifest_write_locked(uint8_t log_type, int index, const struct hpi_log_manifest_entry_t *m_entry)
+{
+    struct fs_file_t file;
+    char fname[60];
+    int ret;
+
+    manifest_path(fname, sizeof(fname), log_type);
+
+    fs_file_t_init(&file);
+    CHECK_FS_OP(fs_open(&file, fname, FS_O_WRITE), "open", fname);
+
+    ret = fs_seek(&file, sizeof(struct log_manifest_hdr) + (off_t)index * sizeof(*m_entry), FS_SEEK_SET);
+    if (ret == 0) {
+        ret = fs_write(&file, m_entry, sizeof(*m_entry));
+    }
+
+    fs_close(&file);
+
+    if (ret < 0) {
+        LOG_ERR("FAIL: write %s: %d", fname, ret);
+        // Let the next access rebuild it from the directory
+        manifest_loaded[log_type] = false;
+        return ret;
+    }
+
+    if (index == manifest_count[log_type]) {
+        manifest_count[log_type]++;
+    }
+
+    return 0;
+}
+
+// Record that a data file now has length bytes, folding the newly appended
+// bytes into its CRC32
+static void log_manifest_extend(uint8_t log_type, int64_t start_ts, uint32_t length, const void *data, size_t data_len)
+{
+    struct hpi_log_manifest_entry_t m_entry;
+    int index;
+
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+
+    if (manifest_load_locked(log_type) == 0) {
+        index = manifest_find_locked(log_type, start_ts, &m_entry);
+        if (index < 0) {
+            index = manifest_count[log_type];
+            m_entry = (struct hpi_log_manifest_entry_t){
+                .start_ts = start_ts,
+                .log_type = log_type,
+            };
+        }
+
+        // A rebuild on this access already scanned the appended bytes
+        if (m_entry.length != length) {
+            m_entry.length = length;
+            m_entry.crc = crc32_ieee_update(m_entry.crc, data, data_len);
+            manifest_write_locked(log_type, index, &m_entry);
+        }
+    }
+
+    k_mutex_unlock(&log_manifest_mutex);
+}
+
+static void log_manifest_set(uint8_t log_type, int64_t start_ts, uint32_t length, uint32_t crc)
+{
+    struct hpi_log_manifest_entry_t m_entry = {
+        .start_ts = start_ts,
+        .length = length,
+        .crc = crc,
+        .log_type = log_type,
+    };
+    struct hpi_log_manifest_entry_t old_entry;
+    int index;
+
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+
+    if (manifest_load_locked(log_type) == 0) {
+        index = manifest_find_locked(log_type, start_ts, &old_entry);
+        manifest_write_locked(log_type, (index < 0) ? manifest_count[log_type] : index, &m_entry);
+    }
+
+    k_mutex_unlock(&log_manifest_mutex);
+}
+
+// Removing an entry rewrites the manifest without it; only used when a
+// file is deleted, which is rare compared to appends
+static void log_manifest_remove(uint8_t log_type, int64_t start_ts)
+{
+    struct hpi_log_manifest_entry_t m_entry;
+    struct log_manifest_hdr hdr;
+    struct fs_file_t src;
+    struct fs_file_t dst;
+    char fname[60];
+    char tmp_name[64];
+    uint16_t kept = 0;
+    int ret;
+
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+
+    if (manifest_load_locked(log_type) != 0 || manifest_find_locked(log_type, start_ts, &m_entry) < 0) {
+        goto out;
+    }
+
+    manifest_path(fname, sizeof(fname), log_type);
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", fname);
+
+    fs_file_t_init(&src);
+    fs_file_t_init(&dst);
+
+    if (fs_open(&src, fname, FS_O_READ) != 0) {
+        manifest_loaded[log_type] = false;
+        goto out;
+    }
+
+    ret = fs_open(&dst, tmp_name, FS_O_CREATE | FS_O_WRITE | FS_O_TRUNC);
+    if (ret == 0) {
+        ret = fs_read(&src, &hdr, sizeof(hdr));
+        if (ret == sizeof(hdr)) {
+            ret = fs_write(&dst, &hdr, sizeof(hdr));
+        }
+
+        while (ret >= 0 && fs_read(&src, &m_entry, sizeof(m_entry)) == sizeof(m_entry)) {
+            if (m_entry.start_ts != start_ts) {
+                ret = fs_write(&dst, &m_entry, sizeof(m_entry));
+                kept++;
+            }
+        }
+        fs_close(&dst);
+    }
+    fs_close(&src);
+
+    if (ret >= 0 && fs_unlink(fname) == 0 && fs_rename(tmp_name, fname) == 0) {
+        manifest_count[log_type] = kept;
+    } else {
+        LOG_ERR("FAIL: remove %" PRId64 " from %s", start_ts, fname);
+        fs_unlink(tmp_name);
+        manifest_loaded[log_type] = false;
+    }
+
+out:
+    k_mutex_unlock(&log_manifest_mutex);
+}
+
+static void log_manifest_invalidate(uint8_t log_type)
+{
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+    if (log_type < LOG_PATHS_COUNT) {
+        manifest_loaded[log_type] = false;
+    }
+    k_mutex_unlock(&log_manifest_mutex);
+}
+
+static void trend_file_name(char *fname, size_t len, uint8_t log_type, int64_t day_ts)
+{
+    char base_path[20];
+
+    hpi_log_get_path(base_path, log_type);
+    snprintf(fname, len, "%s%" PRId64, base_path, day_ts);
+}
+
+static void trend_file_hdr_init(struct hpi_trend_file_hdr_t *hdr, uint8_t log_type, uint8_t record_size, int64_t day_ts)
+{
+    memset(hdr, 0, sizeof(*hdr));
+    hdr->magic = HPI_TREND_FILE_MAGIC;
+    hdr->version = HPI_TREND_FILE_VERSION;
+    hdr->log_type = log_type;
+    hdr->record_size = record_size;
+    hdr->day_ts = day_ts;
+    memset(hdr->hour_index, 0xFF, sizeof(hdr->hour_index));
+}
+
+// Every trend record starts with its int64 timestamp
+static void trend_file_hdr_index(struct hpi_trend_file_hdr_t *hdr, const uint8_t *records, uint32_t count, uint32_t first_index)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        int64_t ts;
+        int64_t hour;
+
+        memcpy(&ts, &records[i * hdr->record_size], sizeof(ts));
+        hour = (ts - hdr->day_ts) / 3600;
+
+        if (hour >= 0 && hour < HPI_TREND_FILE_HOURS && hdr->hour_index[hour] == HPI_TREND_HOUR_NONE) {
+            hdr->hour_index[hour] = first_index + i;
+        }
+    }
+}
+
+// Rewrites a headerless (pre-v1) day file into the indexed format.
+// Must be called with trend_file_mutex held.
+static int trend_file_migrate(const char *fname, uint8_t log_type, uint8_t record_size, int64_t day_ts)
+{
+    struct hpi_trend_file_hdr_t hdr;
+    struct fs_file_t src;
+    struct fs_file_t dst;
+    char tmp_name[56];
+    uint32_t index = 0;
+    int ret;
+
+    LOG_INF("Migrating %s to trend file v%d", fname, HPI_TREND_FILE_VERSION);
+
+    snprintf(tmp_name, sizeof(tmp_name), "%s.tmp", fname);
+    trend_file_hdr_init(&hdr, log_type, record_size, day_ts);
+
+    fs_file_t_init(&src);
+    fs_file_t_init(&dst);
+
+    CHECK_FS_OP(fs_open(&src, fname, FS_O_READ), "open", fname);
+
+    ret = fs_open(&dst, tmp_name, FS_O_CREATE | FS_O_WRITE | FS_O_TRUNC);
+    if (ret < 0) {
+        LOG_ERR("FAIL: open %s: %d", tmp_name, ret);
+        fs_close(&src);
+        return ret;
+    }
+
+    // Header is written again once the hour index is complete
+    ret = fs_write(&dst, &hdr, sizeof(hdr));
+
+    while (ret >= 0) {
+        uint32_t count;
+
+        ret = fs_read(&src, trend_file_buf, (sizeof(trend_file_buf) / record_size) * record_size);
+        if (ret <= 0) {
+            break;
+        }
+
+        // A trailing partial record from an interrupted write is dropped
+        count = ret / record_size;
+        trend_file_hdr_index(&hdr, trend_file_buf, count, index);
+        index += count;
+
+        ret = fs_write(&dst, trend_file_buf, count * record_size);
+    }
+
+    if (ret >= 0) {
+        ret = fs_seek(&dst, 0, FS_SEEK_SET);
+    }
+    if (ret >= 0) {
+        ret = fs_write(&dst, &hdr, sizeof(hdr));
+    }
+
+    fs_close(&src);
+    fs_close(&dst);
+
+    if (ret < 0) {
+        LOG_ERR("FAIL: migrate %s: %d", fname, ret);
+        fs_unlink(tmp_name);
+        return ret;
+    }
+
+    CHECK_FS_OP(fs_unlink(fname), "unlink", fname);
+    CHECK_FS_OP(fs_rename(tmp_name, fname), "rename", tmp_name);
+
+    // Length now includes the header, the record CRC is unchanged
+    log_manifest_extend(log_type, day_ts, sizeof(hdr) + index * record_size, NULL, 0);
+
+    return 0;
+}
+
+// Opens a day file and returns its header and record count, migrating
+// legacy files first. Must be called with trend_file_mutex held.
+static int trend_file_open_locked(struct fs_file_t *file, const char *fname, fs_mode_t flags, uint8_t log_type,
+                                  uint8_t record_size, int64_t day_ts, struct hpi_trend_file_hdr_t *hdr,
+                                  uint32_t *num_records)
+{
+    struct fs_dirent ent;
+    int ret;
+
+    if (fs_stat(fname, &ent) == 0 && ent.size > 0) {
+        uint32_t magic = 0;
+
+        fs_file_t_init(file);
+        CHECK_FS_OP(fs_open(file, fname, FS_O_READ), "open", fname);
+        ret = fs_read(file, &magic, sizeof(magic));
+        fs_close(file);
+
+        if (ret != sizeof(magic) || magic != HPI_TREND_FILE_MAGIC) {
+            ret = trend_file_migrate(fname, log_type, record_size, day_ts);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    }
+
+    fs_file_t_init(file);
+    CHECK_FS_OP(fs_open(file, fname, flags), "open", fname);
+
+    ret = fs_read(file, hdr, sizeof(*hdr));
+    if (ret == 0 && (flags & FS_O_CREATE)) {
+        // New file
+        trend_file_hdr_init(hdr, log_type, record_size, day_ts);
+        ret = fs_write(file, hdr, sizeof(*hdr));
+        if (ret == sizeof(*hdr)) {
+            *num_records = 0;
+            return 0;
+        }
+    } else if (ret == sizeof(*hdr) && hdr->magic == HPI_TREND_FILE_MAGIC &&
+               hdr->version == HPI_TREND_FILE_VERSION && hdr->record_size == record_size) {
+        fs_stat(fname, &ent);
+        *num_records = (ent.size - sizeof(*hdr)) / record_size;
+        return 0;
+    }
+
+    LOG_ERR("Bad trend file header in %s", fname);
+    fs_close(file);
+    return -EBADMSG;
+}
+
+// Append raw records to a trend day file and extend its hour index
+static int trend_file_append(uint8_t log_type, const uint8_t *data, size_t data_size, uint8_t record_size, int64_t day_ts)
+{
+    struct hpi_trend_file_hdr_t hdr;
+    struct fs_file_t file;
+    char fname[50];
+    uint32_t num_records;
+    uint16_t old_index[HPI_TREND_FILE_HOURS];
+    int ret;
+
+    trend_file_name(fname, sizeof(fname), log_type, day_ts);
+
+    LOG_DBG("Write to file... %s | Size: %zu", fname, data_size);
+
+    ret = trend_file_open_locked(&file, fname, FS_O_CREATE | FS_O_RDWR, log_type, record_size, day_ts, &hdr, &num_records);
+    if (ret < 0) {
+        return ret;
+    }
+
+    memcpy(old_index, hdr.hour_index, sizeof(old_index));
+    trend_file_hdr_index(&hdr, data, data_size / record_size, num_records);
+
+    ret = fs_seek(&file, sizeof(hdr) + (off_t)num_records * record_size, FS_SEEK_SET);
+    if (ret >= 0) {
+        ret = fs_write(&file, data, data_size);
+    }
+
+    // The header only changes when the batch starts a new hour
+    if (ret >= 0 && memcmp(old_index, hdr.hour_index, sizeof(old_index)) != 0) {
+        ret = fs_seek(&file, 0, FS_SEEK_SET);
+        if (ret >= 0) {
+            ret = fs_write(&file, &hdr, sizeof(hdr));
+        }
+    }
+
+    if (ret >= 0) {
+        ret = fs_sync(&file);
+    }
+
+    fs_close(&file);
+
+    if (ret < 0) {
+        LOG_ERR("FAIL: append %s: %d", fname, ret);
+        return ret;
+    }
+
+    log_manifest_extend(log_type, day_ts, sizeof(hdr) + (num_records + data_size / record_size) * record_size,
+                        data, data_size);
+
+    return 0;
+}
+
+// Copies the points of a day that are still buffered in RAM, oldest first,
+// and returns how many there are. out may be NULL to only count them. Must
+// be called with trend_file_mutex held, so no buffer is half written.
+static uint32_t trend_cache_copy_day(uint8_t log_type, int64_t day_ts, uint8_t record_size, uint8_t *out)
+{
+    struct hpi_trend_cache *cache = &trend_cache[log_type - HPI_LOG_TYPE_TREND_HR];
+    size_t len = 0;
+
+    k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+    if (cache->pending_fill > 0 && cache->pending_day_ts == day_ts && cache->pending_record_size == record_size) {
+        if (out != NULL) {
+            memcpy(out, cache->buf[cache->active ^ 1], cache->pending_fill);
+        }
+        len += cache->pending_fill;
+    }
+    if (cache->fill > 0 && cache->day_ts == day_ts && cache->record_size == record_size) {
+        if (out != NULL) {
+            memcpy(out + len, cache->buf[cache->active], cache->fill);
+        }
+        len += cache->fill;
+    }
+    k_mutex_unlock(&trend_cache_mutex);
+
+    return len / record_size;
+}
+
+int hpi_trend_file_open(uint8_t log_type, int64_t day_ts, uint8_t record_size, struct fs_file_t *file,
+                        struct hpi_trend_file_hdr_t *hdr, uint32_t *num_records, uint8_t *cached,
+                        uint32_t *num_cached)
+{
+    char fname[50];
+    int ret;
+
+    if (log_type < HPI_LOG_TYPE_TREND_HR || log_type > HPI_LOG_TYPE_TREND_BPT) {
+        return -EINVAL;
+    }
+
+    trend_file_name(fname, sizeof(fname), log_type, day_ts);
+
+    // Both are read under the file mutex, so a flush can't move points from
+    // the cache to the file in between
+    k_mutex_lock(&trend_file_mutex, K_FOREVER);
+    ret = trend_file_open_locked(file, fname, FS_O_READ, log_type, record_size, day_ts, hdr, num_records);
+    *num_cached = trend_cache_copy_day(log_type, day_ts, record_size, cached);
+    k_mutex_unlock(&trend_file_mutex);
+
+    if (ret < 0) {
+        *num_records = 0;
+    }
+
+    return ret;
+}
+
+void hpi_trend_file_hour_span(const struct hpi_trend_file_hdr_t *hdr, uint32_t num_records, int from_hour,
+                              int to_hour, uint32_t *start, uint32_t *count)
+{
+    uint32_t first = num_records;
+    uint32_t end = num_records;
+
+    // Empty hours have no entry, so use the next hour that has one
+    for (int h = MAX(from_hour, 0); h < HPI_TREND_FILE_HOURS; h++) {
+        if (hdr->hour_index[h] != HPI_TREND_HOUR_NONE) {
+            first = hdr->hour_index[h];
+            break;
+        }
+    }
+
+    for (int h = MAX(to_hour, 0); h < HPI_TREND_FILE_HOURS; h++) {
+        if (hdr->hour_index[h] != HPI_TREND_HOUR_NONE) {
+            end = hdr->hour_index[h];
+            break;
+        }
+    }
+
+    *start = MIN(first, num_records);
+    *count = (end > *start) ? (MIN(end, num_records) - *start) : 0;
+}
+
+// Hands the buffer taking new points to the writer. Fails while the previous
+// one is still waiting to be written. Must be called with trend_cache_mutex held.
+static int trend_cache_swap_locked(struct hpi_trend_cache *cache)
+{
+    if (cache->pending_fill > 0) {
+        return -EBUSY;
+    }
+
+    cache->pending_day_ts = cache->day_ts;
+    cache->pending_fill = cache->fill;
+    cache->pending_record_size = cache->record_size;
+    cache->active ^= 1;
+    cache->fill = 0;
+
+    return 0;
+}
+
+// Writes the pending buffer, then whatever the active one held at the time.
+// trend_cache_mutex is only held to swap buffers, so the trend thread keeps
+// buffering points while the day file is written.
+static int trend_cache_drain(uint8_t index)
+{
+    struct hpi_trend_cache *cache = &trend_cache[index];
+    uint8_t log_type = HPI_LOG_TYPE_TREND_HR + index;
+    int ret = 0;
+
+    k_mutex_lock(&trend_file_mutex, K_FOREVER);
+
+    for (int pass = 0; pass < 2; pass++) {
+        const uint8_t *buf;
+        uint16_t size;
+        uint8_t record_size;
+        int64_t day_ts;
+        int err;
+
+        k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+        if (cache->pending_fill == 0 && cache->fill > 0) {
+            trend_cache_swap_locked(cache);
+        }
+        buf = cache->buf[cache->active ^ 1];
+        size = cache->pending_fill;
+        record_size = cache->pending_record_size;
+        day_ts = cache->pending_day_ts;
+        k_mutex_unlock(&trend_cache_mutex);
+
+        if (size == 0) {
+            break;
+        }
+
+        uint32_t begin = hpi_flash_stats_begin();
+        err = trend_file_append(log_type, buf, size, record_size, day_ts);
+        hpi_flash_stats_end(log_type, begin, size, true, err);
+
+        k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+        if (err == 0) {
+            cache->stats.flush_count++;
+            cache->stats.bytes_written += size;
+            LOG_DBG("Trend cache %d flushed %u bytes (flushes: %u, points: %u)", log_type, size,
+                    cache->stats.flush_count, cache->stats.points_cached);
+        } else {
+            // Points are dropped rather than retried forever on a broken file
+            cache->stats.flush_errors++;
+            ret = err;
+        }
+        cache->pending_fill = 0;
+        k_mutex_unlock(&trend_cache_mutex);
+    }
+
+    k_mutex_unlock(&trend_file_mutex);
+
+    return ret;
+}
+
+// Runs on the storage thread
+static int trend_cache_flush_job(const struct hpi_storage_job *job)
+{
+    k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+    trend_cache[job->tag].flush_queued = false;
+    k_mutex_unlock(&trend_cache_mutex);
+
+    return trend_cache_drain(job->tag);
+}
+
+// Hand a cache flush to the storage thread. If the queue is full this is
+// retried on the next point or flush interval check. Must be called with
+// trend_cache_mutex held.
+static void trend_cache_queue_flush_locked(uint8_t index)
+{
+    struct hpi_storage_job job = {
+        .fn = trend_cache_flush_job,
+        .tag = index,
+    };
+
+    if (!trend_cache[index].flush_queued &&
+        hpi_storage_submit(HPI_STORAGE_PRIO_TREND, &job, K_NO_WAIT) == 0) {
+        trend_cache[index].flush_queued = true;
+    }
+}
+
+// Buffer a trend point in RAM; the day file is only written by the storage
+// thread once a buffer fills up, the flush interval expires or the day rolls
+// over, or by hpi_log_trend_flush_all() on shutdown
+static int write_trend_to_file(uint8_t log_type, const void *data, size_t data_size, int64_t day_ts)
+{
+    struct hpi_trend_cache *cache;
+    uint8_t index;
+    int ret = 0;
+
+    // Validate timestamp before writing
+    if (!is_timestamp_valid(day_ts)) {
+        LOG_ERR("Invalid timestamp: %" PRId64 " - refusing to write log file", day_ts);
+        return -EINVAL;
+    }
+
+    if (log_type < HPI_LOG_TYPE_TREND_HR || log_type > HPI_LOG_TYPE_TREND_BPT ||
+        data_size > TREND_CACHE_SIZE) {
+        LOG_ERR("Invalid trend point for log type %d", log_type);
+        return -EINVAL;
+    }
+
+    index = log_type - HPI_LOG_TYPE_TREND_HR;
+    cache = &trend_cache[index];
+
+    k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+
+    // Day rollover: the buffered points belong to the previous day file
+    if ((cache->fill > 0 && cache->day_ts != day_ts) || cache->fill + data_size > TREND_CACHE_SIZE) {
+        ret = trend_cache_swap_locked(cache);
+    }
+
+    if (ret == 0) {
+        if (cache->fill == 0) {
+            cache->day_ts = day_ts;
+            cache->record_size = data_size;
+            cache->first_point_uptime = k_uptime_get();
+        }
+
+        memcpy(&cache->buf[cache->active][cache->fill], data, data_size);
+        cache->fill += data_size;
+        cache->stats.points_cached++;
+    } else {
+        // Both buffers are full, the storage thread is too far behind
+        cache->stats.points_dropped++;
+        LOG_WRN("Trend cache %d busy - point dropped", log_type);
+    }
+
+    if (cache->pending_fill > 0 || cache->fill + data_size > TREND_CACHE_SIZE) {
+        trend_cache_queue_flush_locked(index);
+    }
+
+    k_mutex_unlock(&trend_cache_mutex);
+
+    return ret;
+}
+
+void hpi_log_trend_flush_if_due(void)
+{
+    int64_t now = k_uptime_get();
+
+    k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+    for (int i = 0; i < TREND_CACHE_COUNT; i++) {
+        struct hpi_trend_cache *cache = &trend_cache[i];
+
+        if (cache->pending_fill > 0 ||
+            (cache->fill > 0 &&
+             (now - cache->first_point_uptime) >= (CONFIG_HPI_TREND_CACHE_FLUSH_INTERVAL_S * 1000LL))) {
+            trend_cache_queue_flush_locked(i);
+        }
+    }
+    k_mutex_unlock(&trend_cache_mutex);
+}
+
+void hpi_log_trend_flush_all(void)
 {
-    if (m_path == NULL) {
-        LOG_ERR("Invalid path parameter");
-        return -EINVAL;
+    for (int i = 0; i < TREND_CACHE_COUNT; i++) {
+        trend_cache_drain(i);
     }
 
-    if (m_log_type < LOG_PATHS_COUNT && log_paths[m_log_type] != NULL) {
-        strcpy(m_path, log_paths[m_log_type]);
-    } else {
-        strcpy(m_path, "/lfs/log/");
+    LOG_DBG("Trend caches flushed");
+}
+
+int hpi_log_get_trend_cache_stats(uint8_t log_type, struct hpi_trend_cache_stats_t *stats)
+{
+    if (stats == NULL || log_type < HPI_LOG_TYPE_TREND_HR || log_type > HPI_LOG_TYPE_TREND_BPT) {
+        return -EINVAL;
     }
 
+    k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+    *stats = trend_cache[log_type - HPI_LOG_TYPE_TREND_HR].stats;
+    k_mutex_unlock(&trend_cache_mutex);
+
     return 0;
 }
 
-// Timestamp validation function
-// Returns true if timestamp is valid (after Jan 1, 2020 and before Jan 1, 2030)
-// This prevents log files from being created with invalid timestamps that could
-// indicate system time is not properly synchronized or corrupted.
-static bool is_timestamp_valid(int64_t timestamp)
+void *hpi_record_chunk_alloc(void)
 {
-    // Define reasonable timestamp bounds for the HealthyPi Move device
-    // Jan 1, 2020 00:00:00 UTC = 1577836800 seconds since epoch
-    const int64_t MIN_VALID_TIMESTAMP = 1577836800L;
-    // Jan 1, 2030 00:00:00 UTC = 1893456000 seconds since epoch  
-    const int64_t MAX_VALID_TIMESTAMP = 1893456000L;
-    
-    return (timestamp >= MIN_VALID_TIMESTAMP && timestamp <= MAX_VALID_TIMESTAMP);
+    void *chunk;
+
+    if (k_mem_slab_alloc(&record_chunk_slab, &chunk, K_NO_WAIT) != 0) {
+        return NULL;
+    }
+    return chunk;
 }
 
-// Generic file writer function to reduce code duplication
-static int write_trend_to_file(uint8_t log_type, const void *data, size_t data_size, int64_t timestamp)
+void hpi_record_chunk_free(void *chunk)
+{
+    if (chunk != NULL) {
+        k_mem_slab_free(&record_chunk_slab, chunk);
+    }
+}
+
+static int record_open_job(const struct hpi_storage_job *job)
 {
-    struct fs_file_t file;
-    char fname[50];  // Increased size to accommodate full path
     char base_path[20];
-    
-    // Validate timestamp before writing
-    if (!is_timestamp_valid(timestamp)) {
-        LOG_ERR("Invalid timestamp: %" PRId64 " - refusing to write log file", timestamp);
+    int ret;
+
+    if (record_file_open) {
+        LOG_WRN("Record %s still open - closing", record_fname);
+        fs_close(&record_file);
+        record_file_open = false;
+    }
+
+    if (!is_timestamp_valid(job->ts)) {
+        LOG_ERR("Invalid timestamp for record: %" PRId64 " - refusing to write", job->ts);
         return -EINVAL;
     }
-    
-    fs_file_t_init(&file);
-    
-    // Get base path using existing function
-    if (hpi_log_get_path(base_path, log_type) != 0) {
-        LOG_ERR("Failed to get path for log type %d", log_type);
+
+    if (hpi_log_get_path(base_path, job->tag) != 0) {
+        LOG_ERR("Failed to get path for log type %d", job->tag);
         return -EINVAL;
     }
-    
-    snprintf(fname, sizeof(fname), "%s%" PRId64, base_path, timestamp);
-    
-    LOG_DBG("Write to file... %s | Size: %zu", fname, data_size);
-    
-    CHECK_FS_OP(fs_open(&file, fname, FS_O_CREATE | FS_O_RDWR | FS_O_APPEND), "open", fname);
-    CHECK_FS_OP(fs_write(&file, data, data_size), "write", fname);
-    CHECK_FS_OP(fs_sync(&file), "sync", fname);  // Sync before close
-    CHECK_FS_OP(fs_close(&file), "close", fname);
-    
+    snprintf(record_fname, sizeof(record_fname), "%s%" PRId64, base_path, job->ts);
+
+    fs_file_t_init(&record_file);
+    ret = fs_open(&record_file, record_fname, FS_O_CREATE | FS_O_WRITE | FS_O_TRUNC);
+    if (ret < 0) {
+        LOG_ERR("FAIL: open %s: %d", record_fname, ret);
+        return ret;
+    }
+
+    record_file_open = true;
+    record_bytes_written = 0;
+    record_crc = 0;
+    record_log_type = job->tag;
+    record_start_ts = job->ts;
+    record_chunks_since_sync = 0;
+    log_manifest_set(record_log_type, record_start_ts, 0, 0);
+    LOG_INF("Record %s opened", record_fname);
+
     return 0;
 }
 
-void hpi_write_ecg_record_file(int32_t *ecg_record_buffer, uint16_t ecg_record_length, int64_t start_ts)
+static int record_data_job(const struct hpi_storage_job *job)
 {
-    if (ecg_record_buffer == NULL || ecg_record_length == 0) {
-        LOG_ERR("Invalid ECG record parameters");
-        return;
+    int ret = 0;
+
+    if (record_file_open) {
+        uint32_t begin = hpi_flash_stats_begin();
+        bool synced = false;
+
+        ret = fs_write(&record_file, job->data, job->len);
+        if (ret < 0) {
+            LOG_ERR("FAIL: write %s: %d", record_fname, ret);
+        } else {
+            record_bytes_written += ret;
+            record_crc = crc32_ieee_update(record_crc, job->data, ret);
+        }
+
+        // Bound what a power loss can take with it on long recordings
+        if (++record_chunks_since_sync >= RECORD_SYNC_INTERVAL_CHUNKS) {
+            fs_sync(&record_file);
+            synced = true;
+            record_chunks_since_sync = 0;
+        }
+        hpi_flash_stats_end(record_log_type, begin, (ret < 0) ? 0 : ret, synced, ret);
+
+        if (synced) {
+            log_manifest_set(record_log_type, record_start_ts, record_bytes_written, record_crc);
+        }
     }
-    
-    // Validate timestamp before writing
+
+    hpi_record_chunk_free(job->data);
+    return (ret < 0) ? ret : 0;
+}
+
+static int record_close_job(const struct hpi_storage_job *job)
+{
+    int ret = 0;
+
+    if (record_file_open) {
+        uint32_t begin = hpi_flash_stats_begin();
+
+        ret = fs_close(&record_file);
+        if (ret < 0) {
+            LOG_ERR("FAIL: close %s: %d", record_fname, ret);
+        }
+        hpi_flash_stats_end(record_log_type, begin, 0, true, ret);
+        record_file_open = false;
+        log_manifest_set(record_log_type, record_start_ts, record_bytes_written, record_crc);
+        LOG_INF("Record %s closed - %u bytes", record_fname, record_bytes_written);
+    }
+
+    return ret;
+}
+
+static int record_discard_job(const struct hpi_storage_job *job)
+{
+    if (record_file_open) {
+        fs_close(&record_file);
+        record_file_open = false;
+        fs_unlink(record_fname);
+        log_manifest_remove(record_log_type, record_start_ts);
+        LOG_INF("Record %s discarded", record_fname);
+    }
+
+    return 0;
+}
+
+static int record_submit_ctrl(hpi_storage_fn_t fn, uint8_t log_type, int64_t start_ts)
+{
+    struct hpi_storage_job job = {
+        .fn = fn,
+        .tag = log_type,
+        .ts = start_ts,
+    };
+
+    int ret = hpi_storage_submit(HPI_STORAGE_PRIO_RECORD, &job, K_MSEC(RECORD_CTRL_PUT_TIMEOUT_MS));
+    if (ret != 0) {
+        LOG_ERR("Storage record queue full - dropped record control job (%d)", ret);
+    }
+    return ret;
+}
+
+struct record_open_wait
+{
+    struct k_sem done;
+    int result;
+};
+
+static void record_open_done(int result, void *user_data)
+{
+    struct record_open_wait *wait = user_data;
+
+    wait->result = result;
+    k_sem_give(&wait->done);
+}
+
+// Waits for the open to complete, since the caller streams chunks into the
+// record straight away and the writer would silently free them if the file
+// didn't exist
+int hpi_record_open(uint8_t log_type, int64_t start_ts)
+{
+    struct record_open_wait wait;
+    struct hpi_storage_job job = {
+        .fn = record_open_job,
+        .tag = log_type,
+        .ts = start_ts,
+        .done = record_open_done,
+        .user_data = &wait,
+    };
+
     if (!is_timestamp_valid(start_ts)) {
-        LOG_ERR("Invalid timestamp for ECG record: %" PRId64 " - refusing to write", start_ts);
+        LOG_ERR("Invalid timestamp for record: %" PRId64 " - refusing to write", start_ts);
+        return -EINVAL;
+    }
+
+    k_sem_init(&wait.done, 0, 1);
+    int ret = hpi_storage_submit(HPI_STORAGE_PRIO_RECORD, &job, K_MSEC(RECORD_CTRL_PUT_TIMEOUT_MS));
+    if (ret != 0) {
+        LOG_ERR("Storage record queue full - dropped record open (%d)", ret);
+        return ret;
+    }
+
+    k_sem_take(&wait.done, K_FOREVER);
+    return wait.result;
+}
+
+int hpi_record_write_chunk(void *chunk, size_t len)
+{
+    struct hpi_storage_job job = {
+        .fn = record_data_job,
+        .len = len,
+        .data = chunk,
+    };
+
+    if (chunk == NULL || len == 0 || len > HPI_RECORD_CHUNK_SIZE) {
+        hpi_record_chunk_free(chunk);
+        return -EINVAL;
+    }
+
+    // Can't fail for lack of space: every queued chunk holds a slab block
+    int ret = hpi_storage_submit(HPI_STORAGE_PRIO_RECORD, &job, K_NO_WAIT);
+    if (ret != 0) {
+        LOG_ERR("Storage record queue full - dropped %u byte chunk", (unsigned int)len);
+        hpi_record_chunk_free(chunk);
+    }
+    return ret;
+}
+
+int hpi_record_close(void)
+{
+    return record_submit_ctrl(record_close_job, 0, 0);
+}
+
+int hpi_record_discard(void)
+{
+    return record_submit_ctrl(record_discard_job, 0, 0);
+}
+
+// Retention: per log type age and size quotas plus a free space watermark.
+// A pass runs on the storage thread and evicts at most a few files, oldest
+// first, so housekeeping never shows up as a long flash stall. The newest
+// file of each type (today's trend file, the open record) is never evicted.
+#define RETENTION_EVICT_PER_PASS 4
+#define RETENTION_BACKLOG_DELAY_S 10
+#define RETENTION_FIRST_PASS_DELAY_S 60
+
+struct log_retention_quota
+{
+    uint8_t log_type;
+    uint16_t max_days;  // 0 for no age limit
+    uint32_t max_bytes; // 0 for no size limit
+};
+
+static const struct log_retention_quota retention_quotas[] = {
+    {HPI_LOG_TYPE_TREND_HR, CONFIG_HPI_RETENTION_TREND_MAX_DAYS, CONFIG_HPI_RETENTION_TREND_MAX_KB * 1024},
+    {HPI_LOG_TYPE_TREND_SPO2, CONFIG_HPI_RETENTION_TREND_MAX_DAYS, CONFIG_HPI_RETENTION_TREND_MAX_KB * 1024},
+    {HPI_LOG_TYPE_TREND_TEMP, CONFIG_HPI_RETENTION_TREND_MAX_DAYS, CONFIG_HPI_RETENTION_TREND_MAX_KB * 1024},
+    {HPI_LOG_TYPE_TREND_STEPS, CONFIG_HPI_RETENTION_TREND_MAX_DAYS, CONFIG_HPI_RETENTION_TREND_MAX_KB * 1024},
+    {HPI_LOG_TYPE_TREND_BPT, CONFIG_HPI_RETENTION_TREND_MAX_DAYS, CONFIG_HPI_RETENTION_TREND_MAX_KB * 1024},
+    {HPI_LOG_TYPE_ECG_RECORD, CONFIG_HPI_RETENTION_RECORD_MAX_DAYS, CONFIG_HPI_RETENTION_RECORD_MAX_KB * 1024},
+};
+
+struct log_retention_scan
+{
+    int64_t oldest_ts;
+    uint32_t total_bytes;
+    uint16_t count;
+};
+
+static void log_retention_work_handler(struct k_work *work);
+K_WORK_DELAYABLE_DEFINE(retention_work, log_retention_work_handler);
+
+static uint32_t retention_evictions;
+
+static int log_retention_scan(uint8_t log_type, struct log_retention_scan *scan)
+{
+    static struct hpi_log_manifest_entry_t entries[LOG_MANIFEST_READ_BATCH];
+    int ret;
+
+    memset(scan, 0, sizeof(*scan));
+    scan->oldest_ts = INT64_MAX;
+
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+
+    ret = manifest_load_locked(log_type);
+    for (uint16_t i = 0; ret == 0 && i < manifest_count[log_type]; i += LOG_MANIFEST_READ_BATCH) {
+        int n = manifest_read_locked(log_type, i, LOG_MANIFEST_READ_BATCH, entries);
+        if (n < 0) {
+            ret = n;
+            break;
+        }
+
+        for (int j = 0; j < n; j++) {
+            scan->oldest_ts = MIN(scan->oldest_ts, entries[j].start_ts);
+            scan->total_bytes += entries[j].length;
+            scan->count++;
+        }
+    }
+
+    k_mutex_unlock(&log_manifest_mutex);
+    return ret;
+}
+
+// The oldest file may go unless it's the only one or the record being written
+static bool log_retention_can_evict(uint8_t log_type, const struct log_retention_scan *scan)
+{
+    if (scan->count <= 1) {
+        return false;
+    }
+
+    return !(record_file_open && record_log_type == log_type && record_start_ts == scan->oldest_ts);
+}
+
+static void log_retention_evict(uint8_t log_type, int64_t start_ts, const char *reason)
+{
+    char base_path[20];
+    char fname[50];
+    int ret;
+
+    hpi_log_get_path(base_path, log_type);
+    snprintf(fname, sizeof(fname), "%s%" PRId64, base_path, start_ts);
+
+    // Trend day files are also appended to from flush_all callers
+    k_mutex_lock(&trend_file_mutex, K_FOREVER);
+    ret = fs_unlink(fname);
+    if (log_type >= HPI_LOG_TYPE_TREND_HR && log_type <= HPI_LOG_TYPE_TREND_BPT) {
+        char roll_name[56];
+
+        snprintf(roll_name, sizeof(roll_name), "%s" HPI_TREND_ROLLUP_SUFFIX, fname);
+        fs_unlink(roll_name);
+    }
+    k_mutex_unlock(&trend_file_mutex);
+
+    if (ret < 0 && ret != -ENOENT) {
+        LOG_ERR("Retention: FAIL unlink %s: %d", fname, ret);
         return;
     }
-    
-    // Use generic writer for ECG records
-    write_trend_to_file(HPI_LOG_TYPE_ECG_RECORD, ecg_record_buffer, 
-                       ecg_record_length * sizeof(int32_t), start_ts);
+
+    log_manifest_remove(log_type, start_ts);
+    retention_evictions++;
+    LOG_INF("Retention: evicted %s (%s), %u total", fname, reason, retention_evictions);
+}
+
+static int log_retention_free_pct(void)
+{
+    struct fs_statvfs sbuf;
+
+    if (fs_statvfs(mp->mnt_point, &sbuf) != 0 || sbuf.f_blocks == 0) {
+        return 100;
+    }
+
+    return (int)((sbuf.f_bfree * 100) / sbuf.f_blocks);
+}
+
+// Runs on the storage thread
+static int log_retention_job(const struct hpi_storage_job *job)
+{
+    struct log_retention_scan scan;
+    int64_t now = hw_get_sys_time_ts();
+    int budget = RETENTION_EVICT_PER_PASS;
+
+    for (int i = 0; i < ARRAY_SIZE(retention_quotas) && budget > 0; i++) {
+        const struct log_retention_quota *q = &retention_quotas[i];
+
+        while (budget > 0 && log_retention_scan(q->log_type, &scan) == 0 &&
+               log_retention_can_evict(q->log_type, &scan)) {
+            // Ages are only trusted once the clock has been set
+            bool expired = (q->max_days > 0) && is_timestamp_valid(now) &&
+                           (now - scan.oldest_ts) > (int64_t)q->max_days * 86400;
+            bool over_quota = (q->max_bytes > 0) && (scan.total_bytes > q->max_bytes);
+
+            if (!expired && !over_quota) {
+                break;
+            }
+
+            log_retention_evict(q->log_type, scan.oldest_ts, expired ? "age" : "size quota");
+            budget--;
+        }
+    }
+
+    // Below the free space watermark: drop the oldest file of any type
+    while (budget > 0 && log_retention_free_pct() < CONFIG_HPI_RETENTION_MIN_FREE_PCT) {
+        int64_t oldest_ts = INT64_MAX;
+        int victim = -1;
+
+        for (int i = 0; i < ARRAY_SIZE(retention_quotas); i++) {
+            if (log_retention_scan(retention_quotas[i].log_type, &scan) == 0 &&
+                log_retention_can_evict(retention_quotas[i].log_type, &scan) && scan.oldest_ts < oldest_ts) {
+                oldest_ts = scan.oldest_ts;
+                victim = i;
+            }
+        }
+
+        if (victim < 0) {
+            LOG_WRN("Retention: below %d%% free with nothing left to evict", CONFIG_HPI_RETENTION_MIN_FREE_PCT);
+            break;
+        }
+
+        log_retention_evict(retention_quotas[victim].log_type, oldest_ts, "free space");
+        budget--;
+    }
+
+    // A used up budget means there may be more to do, so come back soon
+    k_work_reschedule(&retention_work, K_SECONDS((budget == 0) ? RETENTION_BACKLOG_DELAY_S
+                                                                : CONFIG_HPI_RETENTION_INTERVAL_S));
+    return 0;
+}
+
+static void log_retention_work_handler(struct k_work *work)
+{
+    struct hpi_storage_job job = {
+        .fn = log_retention_job,
+    };
+
+    // Retention is the least urgent storage work; retry later if the queue is busy
+    if (hpi_storage_submit(HPI_STORAGE_PRIO_META, &job, K_NO_WAIT) != 0) {
+        k_work_reschedule(&retention_work, K_SECONDS(RETENTION_BACKLOG_DELAY_S));
+    }
+}
+
+void hpi_log_retention_start(void)
+{
+    k_work_reschedule(&retention_work, K_SECONDS(RETENTION_FIRST_PASS_DELAY_S));
 }
 
 void hpi_hr_trend_wr_point_to_file(struct hpi_hr_trend_point_t m_trend_point, int64_t day_ts)
@@ -184,108 +1459,157 @@ void hpi_steps_trend_wr_point_to_file(struct hpi_steps_t m_steps_point, int64_t
                        sizeof(m_steps_point), day_ts);
 }
 
-// Generic directory iterator function to reduce duplication
-typedef enum {
-    DIR_OP_COUNT,
-    DIR_OP_INDEX
-} dir_operation_t;
+uint16_t log_get_count(uint8_t m_log_type)
+{
+    uint16_t count = 0;
+
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+    if (manifest_load_locked(m_log_type) == 0) {
+        count = manifest_count[m_log_type];
+    }
+    k_mutex_unlock(&log_manifest_mutex);
+
+    LOG_DBG("Total log count: %d", count);
+    return count;
+}
 
-static int iterate_directory(uint8_t log_type, dir_operation_t operation)
+int log_get_index(uint8_t m_log_type)
 {
-    int res;
-    struct fs_dir_t dirp;
-    static struct fs_dirent entry;
-    uint16_t log_count = 0;
-    char m_path[40] = "";
+    static struct hpi_log_manifest_entry_t entries[LOG_MANIFEST_READ_BATCH];
+    int ret;
 
-    fs_dir_t_init(&dirp);
-    hpi_log_get_path(m_path, log_type);
+    // Make sure file sizes in the index include buffered trend points
+    hpi_log_trend_flush_all();
 
-    res = fs_opendir(&dirp, m_path);
-    if (res) {
-        LOG_ERR("Error opening dir %s [%d]", m_path, res);
-        return res;
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+
+    ret = manifest_load_locked(m_log_type);
+    for (uint16_t i = 0; ret == 0 && i < manifest_count[m_log_type]; i += LOG_MANIFEST_READ_BATCH) {
+        int n = manifest_read_locked(m_log_type, i, LOG_MANIFEST_READ_BATCH, entries);
+        if (n < 0) {
+            ret = n;
+            break;
+        }
+
+        for (int j = 0; j < n; j++) {
+            struct hpi_log_index_t m_index = {
+                .start_time = entries[j].start_ts,
+                .log_file_length = entries[j].length,
+                .log_type = m_log_type
+            };
+
+            LOG_DBG("Log File Start: %" PRId64 " | Size: %d | Type: %d",
+                   m_index.start_time, m_index.log_file_length, m_index.log_type);
+            cmdif_send_ble_data_idx((uint8_t *)&m_index, HPI_FILE_IDX_SIZE);
+        }
     }
 
-    LOG_DBG("%s operation on %s", (operation == DIR_OP_COUNT) ? "Count" : "Index", m_path);
-    
-    for (;;) {
-        res = fs_readdir(&dirp, &entry);
+    k_mutex_unlock(&log_manifest_mutex);
+    return ret;
+}
 
-        /* entry.name[0] == 0 means end-of-dir */
-        if (res || entry.name[0] == 0) {
-            if (res < 0) {
-                LOG_ERR("Error reading dir [%d]", res);
-            }
-            if (operation == DIR_OP_COUNT) {
-                LOG_DBG("Total log count: %d", log_count);
-            }
+// Sends up to max_count index entries with a start time after start_after,
+// oldest first, packed into MTU sized notifications and ending with an
+// end-of-index marker. The phone pages by passing the last start time it got.
+int log_get_index_page(uint8_t m_log_type, int64_t start_after, uint16_t max_count)
+{
+    static struct hpi_log_index_t page[LOG_INDEX_PAGE_MAX];
+    static struct hpi_log_manifest_entry_t entries[LOG_MANIFEST_READ_BATCH];
+    uint16_t page_len = 0;
+    bool more = false;
+    int ret;
+
+    if (max_count == 0 || max_count > LOG_INDEX_PAGE_MAX) {
+        max_count = LOG_INDEX_PAGE_MAX;
+    }
+
+    // Make sure file sizes in the index include buffered trend points
+    hpi_log_trend_flush_all();
+
+    k_mutex_lock(&log_manifest_mutex, K_FOREVER);
+
+    // Manifest order is creation order, not necessarily time order, so keep
+    // the max_count oldest entries after start_after in a sorted page
+    ret = manifest_load_locked(m_log_type);
+    for (uint16_t i = 0; ret == 0 && i < manifest_count[m_log_type]; i += LOG_MANIFEST_READ_BATCH) {
+        int n = manifest_read_locked(m_log_type, i, LOG_MANIFEST_READ_BATCH, entries);
+        if (n < 0) {
+            ret = n;
             break;
         }
 
-        if (entry.type != FS_DIR_ENTRY_DIR) {
-            if (operation == DIR_OP_COUNT) {
-                log_count++;
-            } else { // DIR_OP_INDEX
-                char file_name[300];  // Generous buffer size for file paths
-                int path_ret = snprintf(file_name, sizeof(file_name), "%s%s", m_path, entry.name);
-                if (path_ret >= sizeof(file_name)) {
-                    LOG_ERR("File path too long: %s%s", m_path, entry.name);
-                    continue;
-                }
+        for (int j = 0; j < n; j++) {
+            int64_t start_time = entries[j].start_ts;
+
+            if (start_time <= start_after) {
+                continue;
+            }
 
-                struct fs_dirent trend_file_ent;
-                int ret = fs_stat(file_name, &trend_file_ent);
-                if (ret < 0) {
-                    LOG_ERR("FAIL: stat %s: %d", file_name, ret);
-                    if (ret == -ENOENT) {
-                        LOG_ERR("File not found: %s", file_name);
-                    }
+            if (page_len == max_count) {
+                more = true;
+                if (start_time >= page[page_len - 1].start_time) {
                     continue;
                 }
+                page_len--;
+            }
 
-                int64_t filename_int = atoi(trend_file_ent.name);
-                struct hpi_log_index_t m_index = {
-                    .start_time = filename_int,
-                    .log_file_length = trend_file_ent.size,
-                    .log_type = log_type
-                };
-
-                LOG_DBG("Log File Start: %" PRId64 " | Size: %d | Type: %d", 
-                       m_index.start_time, m_index.log_file_length, m_index.log_type);
-                cmdif_send_ble_data_idx((uint8_t *)&m_index, HPI_FILE_IDX_SIZE);
+            int pos = page_len;
+            while (pos > 0 && page[pos - 1].start_time > start_time) {
+                page[pos] = page[pos - 1];
+                pos--;
             }
+
+            page[pos].start_time = start_time;
+            page[pos].log_file_length = entries[j].length;
+            page[pos].log_type = m_log_type;
+            page_len++;
         }
     }
 
-    fs_closedir(&dirp);
-    return (operation == DIR_OP_COUNT) ? log_count : res;
-}
+    k_mutex_unlock(&log_manifest_mutex);
 
-uint16_t log_get_count(uint8_t m_log_type)
-{
-    return iterate_directory(m_log_type, DIR_OP_COUNT);
+    LOG_DBG("Index page for type %d: %d entries, more: %d", m_log_type, page_len, more);
+    cmdif_send_ble_idx_page(m_log_type, page, page_len, more);
+
+    return (ret < 0) ? ret : page_len;
 }
 
-int log_get_index(uint8_t m_log_type)
+static int log_get_file_path(char *file_path, size_t len, uint8_t log_type, int64_t file_id)
 {
-    return iterate_directory(m_log_type, DIR_OP_INDEX);
+    char base_path[40];
+
+    if (hpi_log_get_path(base_path, log_type) != 0) {
+        LOG_ERR("Failed to get path for log type %d", log_type);
+        return -EINVAL;
+    }
+
+    // Buffered trend points belong in the file being fetched
+    hpi_log_trend_flush_all();
+
+    snprintf(file_path, len, "%s%" PRId64, base_path, file_id);
+    return 0;
 }
 
 void log_get(uint8_t log_type, int64_t file_id)
 {
-    char base_path[40];
     char file_path[60];
 
     LOG_DBG("Getting Log type %d, File ID %" PRId64, log_type, file_id);
 
-    if (hpi_log_get_path(base_path, log_type) != 0) {
-        LOG_ERR("Failed to get path for log type %d", log_type);
-        return;
+    if (log_get_file_path(file_path, sizeof(file_path), log_type, file_id) == 0) {
+        transfer_send_file(file_path);
+    }
+}
+
+void log_get_range(uint8_t log_type, int64_t file_id, uint32_t offset, uint32_t length)
+{
+    char file_path[60];
+
+    LOG_DBG("Getting Log type %d, File ID %" PRId64 " Range %u+%u", log_type, file_id, offset, length);
+
+    if (log_get_file_path(file_path, sizeof(file_path), log_type, file_id) == 0) {
+        transfer_send_file_range(file_path, offset, length);
     }
-    
-    snprintf(file_path, sizeof(file_path), "%s%" PRId64, base_path, file_id);
-    transfer_send_file(file_path);
 }
 
 void log_delete(uint16_t file_id)
@@ -355,10 +1679,14 @@ static void wipe_log_types(const uint8_t *log_types, size_t count, const char *d
     char log_file_name[40];
     
     LOG_DBG("Wiping %s", description);
-    
+
+    // Don't let queued writes recreate files after the wipe
+    hpi_storage_flush();
+
     for (size_t i = 0; i < count; i++) {
         if (hpi_log_get_path(log_file_name, log_types[i]) == 0) {
             log_wipe_folder(log_file_name);
+            log_manifest_invalidate(log_types[i]);
         }
     }
 }
@@ -374,6 +1702,18 @@ void log_wipe_trends(void)
         HPI_LOG_TYPE_ECG_RECORD
     };
     
+    // Drop buffered points so they don't recreate the wiped day files. Holding
+    // the file mutex waits out a buffer the storage thread is writing.
+    k_mutex_lock(&trend_file_mutex, K_FOREVER);
+    k_mutex_lock(&trend_cache_mutex, K_FOREVER);
+    for (int i = 0; i < TREND_CACHE_COUNT; i++) {
+        trend_cache[i].fill = 0;
+        trend_cache[i].pending_fill = 0;
+    }
+    k_mutex_unlock(&trend_cache_mutex);
+    k_mutex_unlock(&trend_file_mutex);
+    hpi_trend_rollup_reset();
+
     wipe_log_types(trend_types, sizeof(trend_types), "all trend logs");
     
     fs_unlink(hpi_sys_update_time_file);
@@ -392,4 +1732,5 @@ void log_wipe_records(void)
     };
     
     wipe_log_types(record_types, sizeof(record_types), "all records");
-}
\ No newline at end of file
+}
+
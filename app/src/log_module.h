@@ -31,8 +31,12 @@
 #pragma once
 
 #include <time.h>
+#include <zephyr/fs/fs.h>
 #include "fs_module.h"
 
+// Streaming records are written in chunks of this size by a background writer
+#define HPI_RECORD_CHUNK_SIZE 512
+
 enum hpi_log_types
 {
     HPI_LOG_TYPE_TREND_HR =0x01,
@@ -47,7 +51,51 @@ enum hpi_log_types
     HPI_LOG_TYPE_PPG_FINGER_RECORD,
 };
 
+// Trend day files: a header with an hour index followed by fixed size records
+// in time order. Files written before the header existed are migrated on open.
+#define HPI_TREND_FILE_MAGIC 0x44545048 // "HPTD"
+#define HPI_TREND_FILE_VERSION 1
+#define HPI_TREND_FILE_HOURS 24
+#define HPI_TREND_HOUR_NONE 0xFFFF
+
+struct hpi_trend_file_hdr_t
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t log_type;
+    uint8_t record_size;
+    uint8_t reserved;
+    int64_t day_ts;
+    uint16_t hour_index[HPI_TREND_FILE_HOURS]; // First record of each hour, HPI_TREND_HOUR_NONE if empty
+} __packed;
+
+#define HPI_TREND_FILE_HDR_SIZE sizeof(struct hpi_trend_file_hdr_t)
+
+// Trend points buffered in RAM per log type, across both cache buffers
+#define HPI_TREND_CACHE_MAX_BYTES 512
+
+// One manifest entry per data file; crc is the CRC32 of the file contents
+// after any trend day file header
+struct hpi_log_manifest_entry_t
+{
+    int64_t start_ts;
+    uint32_t length;
+    uint32_t crc;
+    uint8_t log_type;
+    uint8_t reserved[3];
+} __packed;
+
+struct hpi_trend_cache_stats_t
+{
+    uint32_t points_cached;
+    uint32_t flush_count;
+    uint32_t bytes_written;
+    uint32_t flush_errors;
+    uint32_t points_dropped;
+};
+
 char* log_get_current_session_id_str(void);
+int hpi_log_get_path(char *m_path, uint8_t m_log_type);
 void log_session_add_point(uint16_t time, int16_t current, uint16_t impedance);
 //void log_write_to_file(struct tes_session_log_t *m_session_log);
 void log_complete(void);
@@ -55,7 +103,9 @@ void log_wipe_trends(void);
 void log_wipe_records(void);
 
 void log_delete(uint16_t session_id);
+int log_get_index_page(uint8_t m_log_type, int64_t start_after, uint16_t max_count);
 void log_get(uint8_t log_type, int64_t file_id);
+void log_get_range(uint8_t log_type, int64_t file_id, uint32_t offset, uint32_t length);
 int log_get_index(uint8_t m_log_type);
 void log_seq_init(void);
 uint16_t log_get_count(uint8_t m_log_type);
@@ -66,4 +116,27 @@ void hpi_temp_trend_wr_point_to_file(struct hpi_temp_trend_point_t m_temp_point,
 void hpi_steps_trend_wr_point_to_file(struct hpi_steps_t m_steps_point, int64_t day_ts);
 void hpi_bpt_trend_wr_point_to_file(struct hpi_bpt_point_t m_bpt_point, int64_t day_ts);
 
-void hpi_write_ecg_record_file(int32_t *ecg_record_buffer, uint16_t ecg_record_length, int64_t start_ts);
+// Opens a day file for reading and copies the day's points that are still
+// buffered in RAM into cached, which must hold HPI_TREND_CACHE_MAX_BYTES (or
+// be NULL to only count them). num_cached is set even if there is no file.
+int hpi_trend_file_open(uint8_t log_type, int64_t day_ts, uint8_t record_size, struct fs_file_t *file,
+                        struct hpi_trend_file_hdr_t *hdr, uint32_t *num_records, uint8_t *cached,
+                        uint32_t *num_cached);
+void hpi_trend_file_hour_span(const struct hpi_trend_file_hdr_t *hdr, uint32_t num_records, int from_hour,
+                              int to_hour, uint32_t *start, uint32_t *count);
+
+void hpi_log_trend_flush_if_due(void);
+void hpi_log_trend_flush_all(void);
+int hpi_log_get_trend_cache_stats(uint8_t log_type, struct hpi_trend_cache_stats_t *stats);
+
+void *hpi_record_chunk_alloc(void);
+void hpi_record_chunk_free(void *chunk);
+// Blocks until the storage thread has opened the file; must not be called
+// from the storage thread
+int hpi_record_open(uint8_t log_type, int64_t start_ts);
+int hpi_record_write_chunk(void *chunk, size_t len);
+int hpi_record_close(void);
+int hpi_record_discard(void);
+
+// Starts the periodic background retention passes, call once littlefs is mounted
+void hpi_log_retention_start(void);
@@ -42,6 +42,8 @@
 #include "max32664_updater.h"
 #include "hpi_sys.h"
 #include "hpi_user_settings_api.h"
+#include "hpi_sample_pool.h"
+#include "ecg_filter.h"
 
 LOG_MODULE_REGISTER(smf_display, LOG_LEVEL_DBG);
 
@@ -73,10 +75,13 @@ static uint32_t get_sleep_timeout_ms(void)
     return timeout_ms;
 }
 
-K_MSGQ_DEFINE(q_plot_ecg, sizeof(struct hpi_ecg_bioz_sensor_data_t), 128, 1);
-K_MSGQ_DEFINE(q_plot_ppg_wrist, sizeof(struct hpi_ppg_wr_data_t), 32, 1);
+// ECG and wrist PPG plot queues carry struct hpi_sample_block pointers (see hpi_sample_pool.h).
+// Kept well below CONFIG_HPI_SAMPLE_POOL_BLOCKS so an undrained plot queue (display asleep)
+// can't pin enough blocks to starve the BLE and recorder path.
+K_MSGQ_DEFINE(q_plot_ecg, sizeof(struct hpi_sample_block *), 16, 4);
+K_MSGQ_DEFINE(q_plot_ppg_wrist, sizeof(struct hpi_sample_block *), 8, 4);
 K_MSGQ_DEFINE(q_plot_ppg_fi, sizeof(struct hpi_ppg_fi_data_t), 32, 1);
-K_MSGQ_DEFINE(q_plot_hrv, sizeof(struct hpi_computed_hrv_t), 16, 1);
+K_MSGQ_DEFINE(q_plot_hrv, sizeof(struct hpi_computed_hrv_t), 16, 4);
 K_MSGQ_DEFINE(q_plot_gsr, sizeof(struct hpi_gsr_sensor_data_t), 128, 1);
 K_MSGQ_DEFINE(q_disp_boot_msg, sizeof(struct hpi_boot_msg_t), 4, 1);
 
@@ -795,13 +800,13 @@ static void hpi_disp_process_ppg_fi_data(struct hpi_ppg_fi_data_t ppg_sensor_sam
     }
 }
 
-static void hpi_disp_process_ppg_wr_data(struct hpi_ppg_wr_data_t ppg_sensor_sample)
+static void hpi_disp_process_ppg_wr_data(const struct hpi_ppg_wr_data_t *ppg_sensor_sample)
 {
     if (hpi_disp_get_curr_screen() == SCR_SPL_SPO2_MEASURE)
     {
         lv_disp_trig_activity(NULL);
         hpi_disp_spo2_plot_wrist_ppg(ppg_sensor_sample);
-        hpi_disp_spo2_update_progress(ppg_sensor_sample.spo2_valid_percent_complete, ppg_sensor_sample.spo2_state, ppg_sensor_sample.spo2, ppg_sensor_sample.hr);
+        hpi_disp_spo2_update_progress(ppg_sensor_sample->spo2_valid_percent_complete, ppg_sensor_sample->spo2_state, ppg_sensor_sample->spo2, ppg_sensor_sample->hr);
     }
     else if (hpi_disp_get_curr_screen() == SCR_SPL_RAW_PPG)
     {
@@ -809,15 +814,32 @@ static void hpi_disp_process_ppg_wr_data(struct hpi_ppg_wr_data_t ppg_sensor_sam
         lv_disp_trig_activity(NULL);
         hpi_disp_ppg_draw_plotPPG(ppg_sensor_sample);
         /* Update the HR label on raw PPG screen if available */
-        hpi_ppg_disp_update_hr(ppg_sensor_sample.hr);
+        hpi_ppg_disp_update_hr(ppg_sensor_sample->hr);
     }
 }
 
-static void hpi_disp_process_ecg_data(struct hpi_ecg_bioz_sensor_data_t ecg_sensor_sample)
+static void hpi_disp_process_ecg_data(struct hpi_ecg_bioz_sensor_data_t *ecg_sensor_sample)
 {
     if (hpi_disp_get_curr_screen() == SCR_SPL_ECG_SCR2)
     {
-        hpi_ecg_disp_draw_plotECG(ecg_sensor_sample.ecg_samples, ecg_sensor_sample.ecg_num_samples, ecg_sensor_sample.ecg_lead_off);
+        // The chart spans a fixed number of points, so plot faster rates at
+        // the default rate; the phase carries across batches
+        static int plot_phase = 0;
+        int32_t *src = ECG_DISPLAY_SAMPLES(ecg_sensor_sample);
+        int32_t plot[ECG_POINTS_PER_SAMPLE];
+        int step = MAX(ecg_sensor_sample->ecg_sample_rate / ECG_SAMPLE_RATE_SPS, 1);
+        int n = 0;
+
+        for (int i = 0; i < ecg_sensor_sample->ecg_num_samples; i++)
+        {
+            if (plot_phase == 0)
+            {
+                plot[n++] = src[i];
+            }
+            plot_phase = (plot_phase + 1) % step;
+        }
+
+        hpi_ecg_disp_draw_plotECG(plot, n, ecg_sensor_sample->ecg_lead_off);
     }
     else
     {
@@ -828,6 +850,29 @@ static void hpi_disp_process_ecg_data(struct hpi_ecg_bioz_sensor_data_t ecg_sens
     }*/
 }
 
+static void hpi_disp_process_hrv_data(const struct hpi_computed_hrv_t *hrv)
+{
+    if (hpi_disp_get_curr_screen() == SCR_HRV_SUMMARY)
+    {
+        if (hrv->hrv_ready_flag)
+        {
+            hpi_hrv_summary_update_metrics(hrv->sdnn, hrv->rmssd, hrv->pnn, hrv->mean);
+            hpi_hrv_summary_draw_rr_plot(hrv->rr_ms);
+        }
+        if (hrv->spectrum_updated)
+        {
+            hpi_hrv_frequency_compact_update_spectrum(&hrv->spectrum);
+        }
+    }
+    else if (hpi_disp_get_curr_screen() == SCR_SPL_HRV_FREQUENCY)
+    {
+        if (hrv->spectrum_updated)
+        {
+            hpi_hrv_frequency_update_spectrum(&hrv->spectrum);
+        }
+    }
+}
+
 static void hpi_disp_process_gsr_data(struct hpi_gsr_sensor_data_t gsr_sensor_sample)
 {
     if (hpi_disp_get_curr_screen() == SCR_SPL_PLOT_GSR)
@@ -978,7 +1023,13 @@ static void hpi_disp_update_screens(void)
                 LOG_INF("DISPLAY THREAD: Lead disconnected - resetting recording buffer for continuous capture");
                 
                 // Reset the recording buffer without saving incomplete data
-                hpi_data_reset_ecg_record_buffer();
+                if (hpi_data_reset_ecg_record_buffer() != 0)
+                {
+                    // Couldn't start a fresh file - the ECG state machine
+                    // sees the record stopped and cancels the measurement
+                    LOG_ERR("DISPLAY THREAD: ECG record restart failed");
+                    break;
+                }
                 
                 // Reset UI timer state
                 LOG_INF("DISPLAY THREAD: Resetting UI timer state");
@@ -1075,27 +1126,35 @@ void hpi_load_scr_spl(int m_screen, enum scroll_dir m_scroll_dir, uint32_t arg1,
 
 static void st_display_active_run(void *o)
 {
-    struct hpi_ecg_bioz_sensor_data_t ecg_sensor_sample;
+    struct hpi_sample_block *sample_blk;
     struct hpi_gsr_sensor_data_t gsr_sensor_sample;
-    struct hpi_ppg_wr_data_t ppg_sensor_sample;
     struct hpi_ppg_fi_data_t ppg_fi_sensor_sample;
 
-    if (k_msgq_get(&q_plot_ppg_wrist, &ppg_sensor_sample, K_NO_WAIT) == 0)
+    if (k_msgq_get(&q_plot_ppg_wrist, &sample_blk, K_NO_WAIT) == 0)
     {
-        hpi_disp_process_ppg_wr_data(ppg_sensor_sample);
+        hpi_disp_process_ppg_wr_data(&sample_blk->ppg_wr);
+        hpi_sample_block_unref(sample_blk);
     }
 
     // Process multiple ECG samples per cycle to prevent queue backups
     int ecg_processed_count = 0;
-    while (k_msgq_get(&q_plot_ecg, &ecg_sensor_sample, K_NO_WAIT) == 0)
+    while (k_msgq_get(&q_plot_ecg, &sample_blk, K_NO_WAIT) == 0)
     {
-        hpi_disp_process_ecg_data(ecg_sensor_sample);
+        hpi_disp_process_ecg_data(&sample_blk->ecg);
+        hpi_sample_block_unref(sample_blk);
         ecg_processed_count++;
 
         if (ecg_processed_count >= 8)
             break; // Prevent blocking other processing
     }
 
+    // HRV results arrive at most once per beat
+    struct hpi_computed_hrv_t hrv;
+    while (k_msgq_get(&q_plot_hrv, &hrv, K_NO_WAIT) == 0)
+    {
+        hpi_disp_process_hrv_data(&hrv);
+    }
+
     // Process GSR queue data (allow multiple batches per cycle to keep up with producer)
     int gsr_processed_count = 0;
     while (k_msgq_get(&q_plot_gsr, &gsr_sensor_sample, K_NO_WAIT) == 0)
@@ -46,12 +46,16 @@
 #include "ui/move_ui.h"
 #include "hpi_sys.h"
 #include "hpi_user_settings_api.h"
+#include "hpi_sample_pool.h"
+#include "ecg_rpeak.h"
+#include "ecg_filter.h"
 
 LOG_MODULE_REGISTER(smf_ecg, LOG_LEVEL_DBG);
 
 SENSOR_DT_READ_IODEV(max30001_iodev, DT_ALIAS(max30001), SENSOR_CHAN_VOLTAGE);
 
-K_MSGQ_DEFINE(q_ecg_sample, sizeof(struct hpi_ecg_bioz_sensor_data_t), 64, 1);  // Reduced from 128 to 64
+/* Carries struct hpi_sample_block pointers; the samples live in the shared block pool */
+K_MSGQ_DEFINE(q_ecg_sample, sizeof(struct hpi_sample_block *), 64, 4);
 /* Lightweight queue for BioZ-only samples to reduce copy overhead when ECG not needed */
 K_MSGQ_DEFINE(q_bioz_sample, sizeof(struct hpi_bioz_sample_t), 64, 1);
 
@@ -91,98 +95,81 @@ K_MUTEX_DEFINE(ecg_timer_mutex);
 
 ZBUS_CHAN_DECLARE(ecg_stat_chan);
 ZBUS_CHAN_DECLARE(ecg_lead_on_off_chan);
+#if defined(CONFIG_HPI_ECG_RPEAK_DETECTOR)
+ZBUS_CHAN_DECLARE(ecg_beat_chan);
+#endif
 
-#define ECG_SAMPLING_INTERVAL_MS 125
-#define BIOZ_SAMPLING_INTERVAL_MS 62  // ~16 Hz polling for 32 SPS BioZ to prevent FIFO overflow
-#define ECG_RECORD_DURATION_S 30
 #define ECG_STABILIZATION_DURATION_S 5  // Wait 5 seconds for signal to stabilize
 
+// Rates requested over the command interface, and the ones the MAX30001 runs at
+static atomic_t ecg_rate_req = ATOMIC_INIT(ECG_SAMPLE_RATE_SPS);
+static atomic_t bioz_rate_req = ATOMIC_INIT(BIOZ_SAMPLE_RATE_SPS);
+static atomic_t ecg_rate_active = ATOMIC_INIT(ECG_SAMPLE_RATE_SPS);
+static atomic_t bioz_rate_active = ATOMIC_INIT(BIOZ_SAMPLE_RATE_SPS);
+
 // Define maximum sample limits for validation
 #define MAX_ECG_SAMPLES 32
 #define MAX_BIOZ_SAMPLES 32
 
-// ECG Signal Smoothing Configuration
-#define ECG_FILTER_WINDOW_SIZE 5  // Moving average window size
-#define ECG_FILTER_BUFFER_SIZE ECG_FILTER_WINDOW_SIZE
-
-// Allow runtime configuration of smoothing (optional)
-#ifndef CONFIG_ECG_SMOOTHING_ENABLED
-#define CONFIG_ECG_SMOOTHING_ENABLED 0  // Disable smoothing for testing
-#endif
-
-#if CONFIG_ECG_SMOOTHING_ENABLED
-// ECG smoothing filter state
-static int32_t ecg_filter_buffer[ECG_FILTER_BUFFER_SIZE];
-static uint8_t ecg_filter_index = 0;
-static bool ecg_filter_initialized = false;
+static bool get_ecg_active(void);
 
+#if defined(CONFIG_HPI_ECG_RPEAK_DETECTOR)
 /**
- * @brief Apply moving average filter to smooth ECG sample
- * @param raw_sample Raw ECG sample value
- * @return Smoothed ECG sample value
- * 
- * NOTE: ISR-safe version - uses spinlock instead of mutex
+ * @brief Run raw ECG through the R-peak detector and publish detected beats
+ *
+ * The detector restarts whenever ECG stops or the leads come off, so no RR
+ * interval spans a gap. Faster rates are box-averaged down to ECG_RPEAK_FS;
+ * a partial group carries over to the next batch.
  */
-static int32_t ecg_smooth_sample(int32_t raw_sample)
+static void ecg_detect_beats(const struct max30001_encoded_data *edata, uint16_t rate_sps)
 {
-    static struct k_spinlock ecg_filter_lock;
-    k_spinlock_key_t key = k_spin_lock(&ecg_filter_lock);
-    
-    // Add new sample to circular buffer
-    ecg_filter_buffer[ecg_filter_index] = raw_sample;
-    ecg_filter_index = (ecg_filter_index + 1) % ECG_FILTER_BUFFER_SIZE;
-    
-    // Calculate moving average
-    int64_t sum = 0;
-    uint8_t valid_samples = 0;
-    
-    if (!ecg_filter_initialized) {
-        // During initialization, use only available samples
-        for (int i = 0; i <= ecg_filter_index; i++) {
-            sum += ecg_filter_buffer[i];
-            valid_samples++;
-        }
-        
-        if (ecg_filter_index == ECG_FILTER_BUFFER_SIZE - 1) {
-            ecg_filter_initialized = true;
+    static bool rpeak_running = false;
+    static int32_t dec_sum = 0;
+    static int dec_fill = 0;
+    struct hpi_ecg_beat_t beats[4];
+    int32_t dec[ECG_POINTS_PER_SAMPLE];
+    int factor = MAX(rate_sps / ECG_RPEAK_FS, 1);
+    int num_dec = 0;
+
+    if (!get_ecg_active() || edata->ecg_lead_off)
+    {
+        if (rpeak_running)
+        {
+            ecg_rpeak_reset();
+            rpeak_running = false;
         }
-    } else {
-        // Use full window
-        for (int i = 0; i < ECG_FILTER_BUFFER_SIZE; i++) {
-            sum += ecg_filter_buffer[i];
+        dec_sum = 0;
+        dec_fill = 0;
+        return;
+    }
+    rpeak_running = true;
+
+    for (int i = 0; i < edata->num_samples_ecg; i++)
+    {
+        dec_sum += edata->ecg_samples[i];
+        if (++dec_fill >= factor)
+        {
+            dec[num_dec++] = dec_sum / factor;
+            dec_sum = 0;
+            dec_fill = 0;
         }
-        valid_samples = ECG_FILTER_BUFFER_SIZE;
     }
-    
-    int32_t smoothed_sample = (int32_t)(sum / valid_samples);
-    
-    k_spin_unlock(&ecg_filter_lock, key);
-    return smoothed_sample;
-}
 
-/**
- * @brief Reset ECG smoothing filter state
- * ISR-safe version using spinlock
- */
-static void ecg_smooth_reset(void)
-{
-    static struct k_spinlock ecg_filter_lock;
-    k_spinlock_key_t key = k_spin_lock(&ecg_filter_lock);
-    memset(ecg_filter_buffer, 0, sizeof(ecg_filter_buffer));
-    ecg_filter_index = 0;
-    ecg_filter_initialized = false;
-    k_spin_unlock(&ecg_filter_lock, key);
-}
-#else
-// ECG smoothing disabled - no-op functions
-static int32_t ecg_smooth_sample(int32_t raw_sample)
-{
-    return raw_sample;
-}
+    if (num_dec == 0)
+    {
+        return;
+    }
 
-static void ecg_smooth_reset(void)
-{
-    // No-op when smoothing is disabled
+    // The batch was read out of the FIFO at the fetch timestamp; the last
+    // decimated sample sits at the middle of its group, before any carry-over
+    int64_t last_sample_ts = (int64_t)(edata->header.timestamp / 1000000) -
+                             (int64_t)(2 * dec_fill + factor - 1) * 1000 / (2 * rate_sps);
+    int n = ecg_rpeak_process(dec, num_dec, last_sample_ts, beats, ARRAY_SIZE(beats));
+
+    for (int i = 0; i < n; i++)
+    {
+        zbus_chan_pub(&ecg_beat_chan, &beats[i], K_NO_WAIT);
+    }
 }
 #endif
 
@@ -327,11 +314,11 @@ static void get_ecg_timer_values(uint32_t *last_timer, int *countdown)
     k_mutex_unlock(&ecg_timer_mutex);
 }
 
-// Function to reset ECG timer countdown to full duration (30s)
+// Function to reset ECG timer countdown to full duration (ECG_RECORD_DURATION_S)
 void hpi_ecg_reset_countdown_timer(void)
 {
     k_mutex_lock(&ecg_timer_mutex, K_FOREVER);
-    ecg_countdown_val = ECG_RECORD_DURATION_S;  // Reset to 30 seconds
+    ecg_countdown_val = ECG_RECORD_DURATION_S;  // Reset to full recording length
     ecg_last_timer_val = k_uptime_get_32();     // Update timestamp
     k_mutex_unlock(&ecg_timer_mutex);
     
@@ -342,7 +329,7 @@ void hpi_ecg_reset_countdown_timer(void)
         .ts_complete = 0,
         .status = HPI_ECG_STATUS_STREAMING,
         .hr = get_ecg_hr(),
-        .progress_timer = ECG_RECORD_DURATION_S};  // Show 30 seconds
+        .progress_timer = ECG_RECORD_DURATION_S};  // Show full recording length
     zbus_chan_pub(&ecg_stat_chan, &ecg_stat, K_NO_WAIT);
 }
 
@@ -386,10 +373,12 @@ static void sensor_ecg_process_decode(uint8_t *buf, uint32_t buf_len)
     }
 
     const struct max30001_encoded_data *edata = (const struct max30001_encoded_data *)buf;
-    struct hpi_ecg_bioz_sensor_data_t ecg_sensor_sample;
+    struct hpi_sample_block *blk;
+    struct hpi_ecg_bioz_sensor_data_t *ecg_sensor_sample;
 
     uint8_t ecg_num_samples = edata->num_samples_ecg;
     uint8_t bioz_samples = edata->num_samples_bioz;
+    uint16_t ecg_rate = (uint16_t)atomic_get(&ecg_rate_active);
 
     // Validate sample counts to prevent buffer overflows
     if (ecg_num_samples > MAX_ECG_SAMPLES || bioz_samples > MAX_BIOZ_SAMPLES) {
@@ -403,31 +392,11 @@ static void sensor_ecg_process_decode(uint8_t *buf, uint32_t buf_len)
 
     if (ecg_num_samples > 0 || bioz_samples > 0) 
     {
-    ecg_sensor_sample.ecg_num_samples = edata->num_samples_ecg;
-    ecg_sensor_sample.bioz_num_samples = edata->num_samples_bioz;
-
-        // Apply smoothing filter to ECG samples if enabled
-        for (int i = 0; i < edata->num_samples_ecg; i++)
-        {
-            int32_t raw_sample = edata->ecg_samples[i];
-            ecg_sensor_sample.ecg_samples[i] = ecg_smooth_sample(raw_sample);
-        }
-
-        for (int i = 0; i < edata->num_samples_bioz; i++)
-        {
-            ecg_sensor_sample.bioz_sample[i] = edata->bioz_samples[i];
-        }
-
-    ecg_sensor_sample.hr = edata->hr;
-    ecg_sensor_sample.rtor = edata->rri;
-
         set_ecg_hr(edata->hr);
         // ecg_bioz_sensor_sample.rrint = edata->rri;
 
         // LOG_DBG("RRI: %d", edata->rri);
 
-    ecg_sensor_sample.ecg_lead_off = edata->ecg_lead_off;
-
         // Thread-safe lead detection logic with debouncing
         bool current_lead_state = get_ecg_lead_on_off();
         LOG_DBG("ECG sensor data: ecg_lead_off=%d, current_lead_state=%s, debouncing=%s", 
@@ -485,11 +454,58 @@ static void sensor_ecg_process_decode(uint8_t *buf, uint32_t buf_len)
             // else: already in lead-on state, nothing to do
         }
 
+#if defined(CONFIG_HPI_ECG_RPEAK_DETECTOR)
+        ecg_detect_beats(edata, ecg_rate);
+#endif
+
         if (get_ecg_active() || get_gsr_active())
         {
-    int ret = k_msgq_put(&q_ecg_sample, &ecg_sensor_sample, K_NO_WAIT);
+            // Decode once into a pool block; BLE, plot and recorder share it by reference
+            blk = hpi_sample_block_alloc(HPI_SAMPLE_BLOCK_ECG);
+            if (blk == NULL) {
+                LOG_WRN("ECG/GSR sample dropped - sample pool empty");
+                return;
+            }
+            ecg_sensor_sample = &blk->ecg;
+
+            ecg_sensor_sample->ecg_num_samples = edata->num_samples_ecg;
+            ecg_sensor_sample->bioz_num_samples = edata->num_samples_bioz;
+            ecg_sensor_sample->ecg_sample_rate = ecg_rate;
+
+            for (int i = 0; i < edata->num_samples_ecg; i++)
+            {
+                ecg_sensor_sample->ecg_samples[i] = edata->ecg_samples[i];
+            }
+
+#if defined(CONFIG_HPI_ECG_FILTER)
+            // One cascade call per FIFO batch; GSR shares the block but isn't ECG
+            if (get_ecg_active())
+            {
+                ecg_filter_process(ecg_sensor_sample->ecg_samples, ecg_sensor_sample->ecg_filtered,
+                                   edata->num_samples_ecg);
+            }
+            else
+            {
+                memcpy(ecg_sensor_sample->ecg_filtered, ecg_sensor_sample->ecg_samples,
+                       edata->num_samples_ecg * sizeof(int32_t));
+            }
+#endif
+
+            for (int i = 0; i < edata->num_samples_bioz; i++)
+            {
+                ecg_sensor_sample->bioz_sample[i] = edata->bioz_samples[i];
+            }
+
+            ecg_sensor_sample->hr = edata->hr;
+            ecg_sensor_sample->rtor = edata->rri;
+            ecg_sensor_sample->rrint = edata->rrint;
+            ecg_sensor_sample->ecg_lead_off = edata->ecg_lead_off;
+
+            // Our reference is handed over to the queue on success
+            int ret = k_msgq_put(&q_ecg_sample, &blk, K_NO_WAIT);
             if (ret != 0) {
                 LOG_WRN("ECG/GSR sample dropped - queue full (ret=%d)", ret);
+                hpi_sample_block_unref(blk);
             }
         }
     }
@@ -501,7 +517,7 @@ static void sensor_ecg_process_decode(uint8_t *buf, uint32_t buf_len)
 
 static void work_ecg_sample_handler(struct k_work *work)
 {
-    uint8_t ecg_bioz_buf[512];
+    uint8_t ecg_bioz_buf[sizeof(struct max30001_encoded_data)] __aligned(4);
     int ret;
     
     ret = sensor_read(&max30001_iodev, &max30001_read_rtio_poll_ctx, ecg_bioz_buf, sizeof(ecg_bioz_buf));
@@ -543,6 +559,7 @@ static void sensor_bioz_only_process_decode(uint8_t *buf, uint32_t buf_len)
 
     // Zero out ECG portion since this decoder only handles BioZ
     sample.ecg_num_samples = 0;
+    sample.ecg_sample_rate = 0;
     sample.bioz_num_samples = bioz_samples;
     for (int i = 0; i < bioz_samples; i++) {
         sample.bioz_sample[i] = edata->bioz_samples[i];
@@ -569,7 +586,7 @@ static void sensor_bioz_only_process_decode(uint8_t *buf, uint32_t buf_len)
 
 static void work_bioz_sample_handler(struct k_work *work)
 {
-    uint8_t ecg_bioz_buf[512];
+    uint8_t ecg_bioz_buf[sizeof(struct max30001_encoded_data)] __aligned(4);
     int ret;
 
     ret = sensor_read(&max30001_iodev, &max30001_read_rtio_poll_ctx, ecg_bioz_buf, sizeof(ecg_bioz_buf));
@@ -602,6 +619,130 @@ static void bioz_sampling_handler(struct k_timer *dummy)
 K_TIMER_DEFINE(tmr_ecg_sampling, ecg_sampling_handler, NULL);
 K_TIMER_DEFINE(tmr_bioz_sampling, bioz_sampling_handler, NULL);
 
+// Set when the driver paces FIFO reads from INTB; the poll timers then stay off
+static bool max30001_fifo_irq = false;
+
+static void max30001_fifo_trigger_handler(const struct device *dev, const struct sensor_trigger *trig)
+{
+    // Runs on the system workqueue like the timer work items. The FIFO is
+    // drained even when nobody is sampling, so the level interrupt clears;
+    // the BioZ decoder drops the samples unless GSR is active.
+    if (get_ecg_active())
+    {
+        work_ecg_sample_handler(NULL);
+    }
+    else
+    {
+        work_bioz_sample_handler(NULL);
+    }
+}
+
+static void max30001_fifo_irq_init(void)
+{
+    static const struct sensor_trigger fifo_trig = {
+        .type = SENSOR_TRIG_FIFO_WATERMARK,
+        .chan = SENSOR_CHAN_ALL,
+    };
+
+    if (!device_is_ready(max30001_dev))
+    {
+        return;
+    }
+
+    int ret = sensor_trigger_set(max30001_dev, &fifo_trig, max30001_fifo_trigger_handler);
+    if (ret == 0)
+    {
+        max30001_fifo_irq = true;
+        LOG_INF("MAX30001 FIFO serviced from INTB watermark interrupt");
+    }
+    else
+    {
+        LOG_INF("MAX30001 FIFO interrupt unavailable (%d), polling", ret);
+    }
+}
+
+static void max30001_poll_start(struct k_timer *tmr, uint32_t interval_ms)
+{
+    if (!max30001_fifo_irq)
+    {
+        k_timer_start(tmr, K_MSEC(interval_ms), K_MSEC(interval_ms));
+    }
+}
+
+// Poll intervals, only used when the MAX30001 INTB line isn't available.
+// ECG is read once per watermark; the 8 deep BioZ FIFO twice.
+static uint32_t ecg_poll_interval_ms(void)
+{
+    uint32_t sps = atomic_get(&ecg_rate_active);
+
+    return MAX30001_ECG_FIT_FOR_RATE(sps) * 1000 / sps;
+}
+
+static uint32_t bioz_poll_interval_ms(void)
+{
+    uint32_t sps = atomic_get(&bioz_rate_active);
+
+    return MAX30001_BIOZ_FIT_FOR_RATE(sps) * 1000 / sps / 2;
+}
+
+int hpi_ecg_set_sample_rates(uint16_t ecg_sps, uint8_t bioz_sps)
+{
+    if ((ecg_sps != 128 && ecg_sps != 256 && ecg_sps != 512) || (bioz_sps != 32 && bioz_sps != 64))
+    {
+        return -EINVAL;
+    }
+
+    atomic_set(&ecg_rate_req, ecg_sps);
+    atomic_set(&bioz_rate_req, bioz_sps);
+    LOG_INF("ECG/BioZ rates set to %u/%u SPS for the next measurement", ecg_sps, bioz_sps);
+    return 0;
+}
+
+uint16_t hpi_ecg_get_sample_rate(void)
+{
+    return (uint16_t)atomic_get(&ecg_rate_active);
+}
+
+/**
+ * @brief Program any requested rate change into the MAX30001
+ *
+ * Reprogramming restarts both FIFOs, so a channel is only changed while it
+ * is stopped.
+ */
+static void hw_max30001_apply_rates(void)
+{
+    struct sensor_value rate = {0};
+    int ecg_sps = atomic_get(&ecg_rate_req);
+    int bioz_sps = atomic_get(&bioz_rate_req);
+
+    if (!get_ecg_active() && ecg_sps != atomic_get(&ecg_rate_active))
+    {
+        rate.val1 = ecg_sps;
+        if (sensor_attr_set(max30001_dev, SENSOR_CHAN_ALL, MAX30001_ATTR_ECG_RATE, &rate) == 0)
+        {
+            atomic_set(&ecg_rate_active, ecg_sps);
+            ecg_filter_set_rate(ecg_sps);
+        }
+        else
+        {
+            LOG_ERR("Failed to set ECG rate %d SPS", ecg_sps);
+        }
+    }
+
+    if (!get_gsr_active() && bioz_sps != atomic_get(&bioz_rate_active))
+    {
+        rate.val1 = bioz_sps;
+        if (sensor_attr_set(max30001_dev, SENSOR_CHAN_ALL, MAX30001_ATTR_BIOZ_RATE, &rate) == 0)
+        {
+            atomic_set(&bioz_rate_active, bioz_sps);
+        }
+        else
+        {
+            LOG_ERR("Failed to set BioZ rate %d SPS", bioz_sps);
+        }
+    }
+}
+
 static int hw_max30001_bioz_enable(void) __attribute__((unused));
 static int hw_max30001_bioz_enable(void)
 {
@@ -711,12 +852,13 @@ static void st_ecg_idle_entry(void *o)
     if (k_sem_take(&sem_gsr_start, K_NO_WAIT) == 0)
     {
         LOG_INF("Starting GSR (BioZ) measurement for %d seconds", GSR_MEASUREMENT_DURATION_S);
+        hw_max30001_apply_rates();
         int ret = hw_max30001_gsr_enable();
         if (ret == 0) {
             hpi_data_set_gsr_measurement_active(true);
             gsr_measurement_start_time = k_uptime_get();
             gsr_measurement_in_progress = true;
-            k_timer_start(&tmr_bioz_sampling, K_MSEC(BIOZ_SAMPLING_INTERVAL_MS), K_MSEC(BIOZ_SAMPLING_INTERVAL_MS));
+            max30001_poll_start(&tmr_bioz_sampling, bioz_poll_interval_ms());
             LOG_INF("GSR (BioZ) measurement started successfully");
         } else {
             LOG_ERR("Failed to start GSR (BioZ) measurement: %d", ret);
@@ -790,11 +932,16 @@ static void st_ecg_stream_entry(void *o)
             LOG_ERR("Failed to enable ECG in stream entry: %d", ret);
             return;
         }
-        k_timer_start(&tmr_ecg_sampling, K_MSEC(ECG_SAMPLING_INTERVAL_MS), K_MSEC(ECG_SAMPLING_INTERVAL_MS));
+        max30001_poll_start(&tmr_ecg_sampling, ecg_poll_interval_ms());
     }
     
     // Start actual recording
-    hpi_data_set_ecg_record_active(true);
+    ret = hpi_data_set_ecg_record_active(true);
+    if (ret != 0) {
+        // Stream run sees the record inactive and cancels the measurement
+        LOG_ERR("Failed to start ECG record: %d", ret);
+        return;
+    }
     
     // Timer initialization - start paused until lead ON is detected
     set_ecg_timer_values(k_uptime_get_32(), ECG_RECORD_DURATION_S);
@@ -822,13 +969,23 @@ static void st_ecg_stream_entry(void *o)
 
 static void st_ecg_stream_run(void *o)
 {
+    // The data module stops the record if it couldn't be started or had to
+    // be discarded; back out the same way a UI cancel does
+    if (!hpi_data_is_ecg_record_active())
+    {
+        LOG_ERR("ECG SMF: Recording stopped by data module - cancelling");
+        smf_set_state(SMF_CTX(&s_ecg_obj), &ecg_states[HPI_ECG_STATE_IDLE]);
+        hpi_load_screen(SCR_ECG, SCROLL_DOWN);
+        return;
+    }
+
     // Check for lead reconnection requiring stabilization
     if (k_sem_take(&sem_ecg_lead_on_stabilize, K_NO_WAIT) == 0)
     {
         LOG_INF("ECG SMF: Lead reconnected - entering stabilization phase");
         
-        // Reset software smoothing filter for clean start
-        ecg_smooth_reset();
+        // Restart the filter chain so the lead-on step doesn't ring through it
+        ecg_filter_reset();
         
         // Note: We don't reset FIFO here - the sensor is already running
         // and FIFO reset during active operation might cause issues
@@ -840,7 +997,7 @@ static void st_ecg_stream_run(void *o)
     }
 
     // LOG_DBG("ECG/BioZ SM Stream Run");
-    // Stream for ECG duration (30s)
+    // Stream for ECG duration (ECG_RECORD_DURATION_S)
     if (hpi_data_is_ecg_record_active() == true)
     {
         uint32_t last_timer;
@@ -1014,12 +1171,13 @@ static void st_ecg_stabilizing_entry(void *o)
     // Check if this is initial stabilization or re-stabilization during recording
     bool is_recording_active = hpi_data_is_ecg_record_active();
 
-    // Always reset ECG smoothing filter for clean start
-    ecg_smooth_reset();
+    // Always restart the ECG filter chain for a clean start
+    ecg_filter_reset();
 
     // Only enable ECG and start sampling if not already active (initial start)
     if (!is_recording_active) {
         LOG_INF("Initial stabilization - enabling ECG and starting sampling");
+        hw_max30001_apply_rates();
         
         // Enable ECG but don't start recording yet
         ret = hw_max30001_ecg_enable();
@@ -1028,7 +1186,7 @@ static void st_ecg_stabilizing_entry(void *o)
             return;
         }
         
-        k_timer_start(&tmr_ecg_sampling, K_MSEC(ECG_SAMPLING_INTERVAL_MS), K_MSEC(ECG_SAMPLING_INTERVAL_MS));
+        max30001_poll_start(&tmr_ecg_sampling, ecg_poll_interval_ms());
     } else {
         LOG_INF("Re-stabilization during active recording - syncing MAX30001");
         
@@ -1050,10 +1208,8 @@ static void st_ecg_stabilizing_entry(void *o)
     zbus_chan_pub(&ecg_stat_chan, &ecg_stat, K_NO_WAIT);
     
     LOG_INF("ECG stabilization started - waiting %d seconds", ECG_STABILIZATION_DURATION_S);
-#if CONFIG_ECG_SMOOTHING_ENABLED
-    LOG_INF("ECG smoothing enabled with window size %d", ECG_FILTER_WINDOW_SIZE);
-#else
-    LOG_INF("ECG smoothing disabled - using raw samples");
+#if !defined(CONFIG_HPI_ECG_FILTER)
+    LOG_INF("ECG filter chain disabled - using raw samples");
 #endif
 }
 
@@ -1142,6 +1298,8 @@ void smf_ecg_thread(void)
 
     LOG_INF("ECG SMF Thread Started");
 
+    max30001_fifo_irq_init();
+
     smf_set_initial(SMF_CTX(&s_ecg_obj), &ecg_states[HPI_ECG_STATE_IDLE]);
 
     for (;;)
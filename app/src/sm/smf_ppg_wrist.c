@@ -39,6 +39,7 @@ LOG_MODULE_REGISTER(smf_ppg_wrist, LOG_LEVEL_DBG);
 #include "max32664c.h"
 #include "hpi_common_types.h"
 #include "hpi_sys.h"
+#include "hpi_sample_pool.h"
 #include "ui/move_ui.h"
 
 // State machine parameters
@@ -85,7 +86,8 @@ K_SEM_DEFINE(sem_start_one_shot_spo2, 0, 1);
 K_SEM_DEFINE(sem_stop_one_shot_spo2, 0, 1);
 K_SEM_DEFINE(sem_spo2_cancel, 0, 1);
 
-K_MSGQ_DEFINE(q_ppg_wrist_sample, sizeof(struct hpi_ppg_wr_data_t), 64, 1);
+/* Carries struct hpi_sample_block pointers; the samples live in the shared block pool */
+K_MSGQ_DEFINE(q_ppg_wrist_sample, sizeof(struct hpi_sample_block *), 64, 4);
 
 // RTIO context with memory pool for async sensor reads
 RTIO_DEFINE_WITH_MEMPOOL(max32664c_read_rtio_async_ctx, 4, 4, 4, 512, 4);
@@ -195,7 +197,9 @@ static int get_measured_spo2(uint16_t *spo2_value, enum spo2_meas_state *status)
 static void sensor_ppg_wrist_decode(uint8_t *buf, uint32_t buf_len)
 {
     const struct max32664c_encoded_data *edata = (const struct max32664c_encoded_data *)buf;
-    struct hpi_ppg_wr_data_t ppg_sensor_sample;
+    struct hpi_sample_block *blk;
+    struct hpi_ppg_wr_data_t ppg_scratch;
+    struct hpi_ppg_wr_data_t *ppg_sensor_sample;
 
     uint16_t _n_samples = edata->num_samples;
 
@@ -247,43 +251,49 @@ static void sensor_ppg_wrist_decode(uint8_t *buf, uint32_t buf_len)
         }
         if (_n_samples > 0)
         {
-            ppg_sensor_sample.ppg_num_samples = _n_samples;
+            // Decode once into a pool block that BLE and the plot share by reference.
+            // If the pool is exhausted the batch is still decoded into a scratch
+            // copy so the SCD and SpO2 logic below keeps running; it is just not forwarded.
+            blk = hpi_sample_block_alloc(HPI_SAMPLE_BLOCK_PPG_WR);
+            ppg_sensor_sample = (blk != NULL) ? &blk->ppg_wr : &ppg_scratch;
+
+            ppg_sensor_sample->ppg_num_samples = _n_samples;
 
             for (int i = 0; i < _n_samples; i++)
             {
-                ppg_sensor_sample.raw_red[i] = edata->red_samples[i];
-                ppg_sensor_sample.raw_ir[i] = edata->ir_samples[i];
-                ppg_sensor_sample.raw_green[i] = edata->green_samples[i];
+                ppg_sensor_sample->raw_red[i] = edata->red_samples[i];
+                ppg_sensor_sample->raw_ir[i] = edata->ir_samples[i];
+                ppg_sensor_sample->raw_green[i] = edata->green_samples[i];
             }
 
             if (edata->chip_op_mode == MAX32664C_OP_MODE_RAW)
             {
-                ppg_sensor_sample.hr = 0;
-                ppg_sensor_sample.spo2 = 0;
-                ppg_sensor_sample.rtor = 0;
-                ppg_sensor_sample.scd_state = 0;
+                ppg_sensor_sample->hr = 0;
+                ppg_sensor_sample->spo2 = 0;
+                ppg_sensor_sample->rtor = 0;
+                ppg_sensor_sample->scd_state = 0;
             }
             else
             {
-                ppg_sensor_sample.hr = edata->hr;
-                ppg_sensor_sample.spo2 = edata->spo2;
-                ppg_sensor_sample.rtor = edata->rtor;
-                ppg_sensor_sample.scd_state = edata->scd_state;
-                ppg_sensor_sample.hr_confidence = edata->hr_confidence;
-                ppg_sensor_sample.spo2_confidence = edata->spo2_confidence;
-                ppg_sensor_sample.spo2_excessive_motion = edata->spo2_excessive_motion;
-                ppg_sensor_sample.spo2_valid_percent_complete = edata->spo2_valid_percent_complete;
-                ppg_sensor_sample.spo2_state = edata->spo2_state;
-                ppg_sensor_sample.spo2_low_pi = edata->spo2_low_pi;
+                ppg_sensor_sample->hr = edata->hr;
+                ppg_sensor_sample->spo2 = edata->spo2;
+                ppg_sensor_sample->rtor = edata->rtor;
+                ppg_sensor_sample->scd_state = edata->scd_state;
+                ppg_sensor_sample->hr_confidence = edata->hr_confidence;
+                ppg_sensor_sample->spo2_confidence = edata->spo2_confidence;
+                ppg_sensor_sample->spo2_excessive_motion = edata->spo2_excessive_motion;
+                ppg_sensor_sample->spo2_valid_percent_complete = edata->spo2_valid_percent_complete;
+                ppg_sensor_sample->spo2_state = edata->spo2_state;
+                ppg_sensor_sample->spo2_low_pi = edata->spo2_low_pi;
             }
 
             // Update current SCD state for general tracking
-            m_curr_scd_state = ppg_sensor_sample.scd_state;
+            m_curr_scd_state = ppg_sensor_sample->scd_state;
 
             // Process SCD state changes for power optimization in ACTIVE state
             if (m_curr_state == PPG_SAMP_STATE_ACTIVE && edata->chip_op_mode == MAX32664C_OP_MODE_ALGO_AEC)
             {
-                if (ppg_sensor_sample.scd_state == MAX32664C_SCD_STATE_ON_SKIN)
+                if (ppg_sensor_sample->scd_state == MAX32664C_SCD_STATE_ON_SKIN)
                 {
                     // Reset off-skin timer if back on skin
                     if (off_skin_timer_active)
@@ -292,7 +302,7 @@ static void sensor_ppg_wrist_decode(uint8_t *buf, uint32_t buf_len)
                         k_work_cancel_delayable(&work_off_skin_threshold);
                     }
                 }
-                else if (ppg_sensor_sample.scd_state == MAX32664C_SCD_STATE_OFF_SKIN)
+                else if (ppg_sensor_sample->scd_state == MAX32664C_SCD_STATE_OFF_SKIN)
                 {
                     // Start off-skin timer if not already started
                     if (!off_skin_timer_active)
@@ -304,36 +314,41 @@ static void sensor_ppg_wrist_decode(uint8_t *buf, uint32_t buf_len)
                 }
             }
 
-            if ((ppg_sensor_sample.spo2_valid_percent_complete == 100) && spo2_measurement_in_progress)
+            if ((ppg_sensor_sample->spo2_valid_percent_complete == 100) && spo2_measurement_in_progress)
             {
                 k_sem_give(&sem_stop_one_shot_spo2);
-                if (ppg_sensor_sample.spo2_confidence > 50)
+                if (ppg_sensor_sample->spo2_confidence > 50)
                 {
                     struct hpi_spo2_point_t spo2_chan_value = {
                         .timestamp = hw_get_sys_time_ts(),
-                        .spo2 = ppg_sensor_sample.spo2,
+                        .spo2 = ppg_sensor_sample->spo2,
                     };
                     zbus_chan_pub(&spo2_chan, &spo2_chan_value, K_SECONDS(1));
 
-                    smf_ppg_spo2_last_measured_value = ppg_sensor_sample.spo2;
+                    smf_ppg_spo2_last_measured_value = ppg_sensor_sample->spo2;
                     smf_ppg_spo2_last_measured_time = hw_get_sys_time_ts();
-                    hpi_sys_set_last_spo2_update(ppg_sensor_sample.spo2, smf_ppg_spo2_last_measured_time);
-                    set_measured_spo2(ppg_sensor_sample.spo2, SPO2_MEAS_SUCCESS);
+                    hpi_sys_set_last_spo2_update(ppg_sensor_sample->spo2, smf_ppg_spo2_last_measured_time);
+                    set_measured_spo2(ppg_sensor_sample->spo2, SPO2_MEAS_SUCCESS);
                 }
                 spo2_measurement_in_progress = false;
             }
 
-            if (ppg_sensor_sample.spo2_state == SPO2_MEAS_TIMEOUT)
+            if (ppg_sensor_sample->spo2_state == SPO2_MEAS_TIMEOUT)
             {
                 k_sem_give(&sem_stop_one_shot_spo2);
                 set_measured_spo2(0, SPO2_MEAS_TIMEOUT);
                 spo2_measurement_in_progress = false;
             }
 
-            m_curr_scd_state = ppg_sensor_sample.scd_state;
-            if (ppg_sensor_sample.scd_state == MAX32664C_SCD_STATE_ON_SKIN)
+            m_curr_scd_state = ppg_sensor_sample->scd_state;
+            if (blk != NULL)
             {
-                k_msgq_put(&q_ppg_wrist_sample, &ppg_sensor_sample, K_MSEC(1));
+                // Our reference is handed over to the queue on success
+                if ((ppg_sensor_sample->scd_state != MAX32664C_SCD_STATE_ON_SKIN) ||
+                    (k_msgq_put(&q_ppg_wrist_sample, &blk, K_MSEC(1)) != 0))
+                {
+                    hpi_sample_block_unref(blk);
+                }
             }
         }
     }
@@ -0,0 +1,418 @@
+/*
+ * HealthyPi Move
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/fs/fs.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "storage_module.h"
+#include "log_module.h"
+#include "hw_module.h"
+
+LOG_MODULE_REGISTER(storage_module, LOG_LEVEL_INF);
+
+#define STORAGE_THREAD_STACKSIZE 3072
+#define STORAGE_THREAD_PRIORITY 8
+
+// Short wait for the write/append/unlink helpers, which are used from
+// threads that would rather drop metadata than stall
+#define STORAGE_PUT_TIMEOUT_MS 50
+
+// Record data jobs are bounded by the record chunk slab, the extra slots
+// are for record control jobs
+K_MSGQ_DEFINE(q_storage_record, sizeof(struct hpi_storage_job), CONFIG_HPI_RECORD_CHUNK_COUNT + 4, 4);
+K_MSGQ_DEFINE(q_storage_trend, sizeof(struct hpi_storage_job), CONFIG_HPI_STORAGE_QUEUE_LEN, 4);
+K_MSGQ_DEFINE(q_storage_meta, sizeof(struct hpi_storage_job), CONFIG_HPI_STORAGE_QUEUE_LEN, 4);
+
+static struct k_msgq *const storage_queues[HPI_STORAGE_PRIO_COUNT] = {
+    [HPI_STORAGE_PRIO_RECORD] = &q_storage_record,
+    [HPI_STORAGE_PRIO_TREND] = &q_storage_trend,
+    [HPI_STORAGE_PRIO_META] = &q_storage_meta,
+};
+
+// Copies of write/append payloads until the worker has written them
+K_HEAP_DEFINE(storage_heap, CONFIG_HPI_STORAGE_HEAP_SIZE);
+
+// Flash I/O statistics keys, in the order of flash_stats[]
+static const uint8_t flash_stats_keys[] = {
+    HPI_LOG_TYPE_TREND_HR,
+    HPI_LOG_TYPE_TREND_SPO2,
+    HPI_LOG_TYPE_TREND_TEMP,
+    HPI_LOG_TYPE_TREND_STEPS,
+    HPI_LOG_TYPE_TREND_BPT,
+    HPI_LOG_TYPE_ECG_RECORD,
+    HPI_LOG_TYPE_BIOZ_RECORD,
+    HPI_LOG_TYPE_PPG_WRIST_RECORD,
+    HPI_LOG_TYPE_PPG_FINGER_RECORD,
+    HPI_FLASH_STATS_KEY_SYS,
+    HPI_FLASH_STATS_KEY_SETTINGS,
+};
+
+#define FLASH_STATS_COUNT ARRAY_SIZE(flash_stats_keys)
+
+static struct hpi_flash_io_stats_t flash_stats[FLASH_STATS_COUNT];
+static struct k_spinlock flash_stats_lock;
+
+static int flash_stats_slot(uint8_t key)
+{
+    for (int i = 0; i < FLASH_STATS_COUNT; i++)
+    {
+        if (flash_stats_keys[i] == key)
+        {
+            return i;
+        }
+    }
+
+    return -EINVAL;
+}
+
+void hpi_flash_stats_end(uint8_t key, uint32_t begin, size_t bytes, bool synced, int result)
+{
+    uint32_t latency_us = k_cyc_to_us_floor32(k_cycle_get_32() - begin);
+    int slot = flash_stats_slot(key);
+    int bucket = 0;
+
+    if (slot < 0)
+    {
+        return;
+    }
+
+    while (bucket < HPI_FLASH_LAT_BUCKETS - 1 && (latency_us >> (bucket + 1)) != 0)
+    {
+        bucket++;
+    }
+
+    K_SPINLOCK(&flash_stats_lock)
+    {
+        struct hpi_flash_io_stats_t *stats = &flash_stats[slot];
+
+        if (result < 0)
+        {
+            stats->errors++;
+        }
+        else
+        {
+            stats->bytes_written += bytes;
+            stats->write_ops++;
+            stats->sync_ops += synced ? 1 : 0;
+        }
+        stats->max_latency_us = MAX(stats->max_latency_us, latency_us);
+        stats->latency_hist[bucket]++;
+    }
+}
+
+size_t hpi_flash_stats_keys(const uint8_t **keys)
+{
+    *keys = flash_stats_keys;
+    return FLASH_STATS_COUNT;
+}
+
+int hpi_flash_stats_get(uint8_t key, struct hpi_flash_io_stats_t *stats)
+{
+    int slot = flash_stats_slot(key);
+
+    if (slot < 0)
+    {
+        return slot;
+    }
+
+    K_SPINLOCK(&flash_stats_lock)
+    {
+        *stats = flash_stats[slot];
+    }
+
+    return 0;
+}
+
+void hpi_flash_stats_reset(uint8_t key)
+{
+    int slot = flash_stats_slot(key);
+
+    K_SPINLOCK(&flash_stats_lock)
+    {
+        if (key == HPI_FLASH_STATS_KEY_ALL)
+        {
+            memset(flash_stats, 0, sizeof(flash_stats));
+        }
+        else if (slot >= 0)
+        {
+            memset(&flash_stats[slot], 0, sizeof(flash_stats[slot]));
+        }
+    }
+}
+
+void hpi_flash_stats_print_usb(uint8_t key)
+{
+    struct hpi_flash_io_stats_t stats;
+    char line[96];
+    int len;
+
+    for (int i = 0; i < FLASH_STATS_COUNT; i++)
+    {
+        if (key != HPI_FLASH_STATS_KEY_ALL && key != flash_stats_keys[i])
+        {
+            continue;
+        }
+
+        hpi_flash_stats_get(flash_stats_keys[i], &stats);
+
+        len = snprintf(line, sizeof(line), "flash 0x%02X: %u B, %u writes, %u syncs, %u errors, max %u us\r\n",
+                       flash_stats_keys[i], stats.bytes_written, stats.write_ops, stats.sync_ops, stats.errors,
+                       stats.max_latency_us);
+        send_usb_cdc(line, MIN(len, sizeof(line) - 1));
+
+        len = snprintf(line, sizeof(line), "  lat log2(us):");
+        for (int b = 0; b < HPI_FLASH_LAT_BUCKETS; b++)
+        {
+            len += snprintf(&line[len], sizeof(line) - len, " %u", stats.latency_hist[b]);
+            if (len >= sizeof(line) - 14)
+            {
+                send_usb_cdc(line, len);
+                len = 0;
+            }
+        }
+        len += snprintf(&line[len], sizeof(line) - len, "\r\n");
+        send_usb_cdc(line, len);
+    }
+}
+
+static int storage_queue_data(enum hpi_storage_prio prio, uint8_t stats_key, uint8_t op, const char *path,
+                              const void *data, size_t len, hpi_storage_done_t done, void *user_data)
+{
+    struct hpi_storage_job job = {
+        .op = op,
+        .tag = stats_key,
+        .len = len,
+        .done = done,
+        .user_data = user_data,
+    };
+    int ret;
+
+    if (prio >= HPI_STORAGE_PRIO_COUNT || path == NULL || strlen(path) >= sizeof(job.path) || len > UINT16_MAX)
+    {
+        return -EINVAL;
+    }
+    strcpy(job.path, path);
+
+    if (len > 0)
+    {
+        job.data = k_heap_alloc(&storage_heap, len, K_NO_WAIT);
+        if (job.data == NULL)
+        {
+            LOG_ERR("Storage heap full - dropped %u byte write to %s", (unsigned int)len, path);
+            return -ENOMEM;
+        }
+        memcpy(job.data, data, len);
+    }
+
+    ret = k_msgq_put(storage_queues[prio], &job, K_MSEC(STORAGE_PUT_TIMEOUT_MS));
+    if (ret != 0)
+    {
+        LOG_ERR("Storage queue %d full - dropped op %d on %s", prio, op, path);
+        k_heap_free(&storage_heap, job.data);
+        return -EAGAIN;
+    }
+
+    return 0;
+}
+
+int hpi_storage_write(enum hpi_storage_prio prio, uint8_t stats_key, const char *path, const void *data, size_t len,
+                      hpi_storage_done_t done, void *user_data)
+{
+    return storage_queue_data(prio, stats_key, HPI_STORAGE_OP_WRITE, path, data, len, done, user_data);
+}
+
+int hpi_storage_append(enum hpi_storage_prio prio, uint8_t stats_key, const char *path, const void *data, size_t len,
+                       hpi_storage_done_t done, void *user_data)
+{
+    return storage_queue_data(prio, stats_key, HPI_STORAGE_OP_APPEND, path, data, len, done, user_data);
+}
+
+int hpi_storage_unlink(enum hpi_storage_prio prio, const char *path, hpi_storage_done_t done, void *user_data)
+{
+    return storage_queue_data(prio, HPI_FLASH_STATS_KEY_SYS, HPI_STORAGE_OP_UNLINK, path, NULL, 0, done, user_data);
+}
+
+int hpi_storage_submit(enum hpi_storage_prio prio, const struct hpi_storage_job *job, k_timeout_t timeout)
+{
+    struct hpi_storage_job call = *job;
+
+    if (prio >= HPI_STORAGE_PRIO_COUNT || job->fn == NULL)
+    {
+        return -EINVAL;
+    }
+    call.op = HPI_STORAGE_OP_CALL;
+
+    return k_msgq_put(storage_queues[prio], &call, timeout);
+}
+
+static void storage_flush_done(int result, void *user_data)
+{
+    k_sem_give((struct k_sem *)user_data);
+}
+
+static int storage_flush_marker(const struct hpi_storage_job *job)
+{
+    return 0;
+}
+
+int hpi_storage_flush(void)
+{
+    struct k_sem done_sem;
+    struct hpi_storage_job job = {
+        .fn = storage_flush_marker,
+        .done = storage_flush_done,
+        .user_data = &done_sem,
+    };
+    int ret;
+
+    // A marker in the lowest priority queue completes only after everything
+    // queued before it, since higher priority queues are always drained first
+    k_sem_init(&done_sem, 0, 1);
+    ret = hpi_storage_submit(HPI_STORAGE_PRIO_META, &job, K_FOREVER);
+    if (ret == 0)
+    {
+        k_sem_take(&done_sem, K_FOREVER);
+    }
+
+    return ret;
+}
+
+static int storage_write_file(const struct hpi_storage_job *job)
+{
+    struct fs_file_t file;
+    fs_mode_t flags = FS_O_CREATE | FS_O_WRITE;
+    uint32_t begin = hpi_flash_stats_begin();
+    int ret;
+
+    flags |= (job->op == HPI_STORAGE_OP_APPEND) ? FS_O_APPEND : FS_O_TRUNC;
+
+    fs_file_t_init(&file);
+    ret = fs_open(&file, job->path, flags);
+    if (ret < 0)
+    {
+        LOG_ERR("FAIL: open %s: %d", job->path, ret);
+        hpi_flash_stats_end(job->tag, begin, 0, false, ret);
+        return ret;
+    }
+
+    ret = fs_write(&file, job->data, job->len);
+    if (ret >= 0 && ret != job->len)
+    {
+        ret = -ENOSPC;
+    }
+    if (ret < 0)
+    {
+        LOG_ERR("FAIL: write %s: %d", job->path, ret);
+    }
+
+    // Closing commits the file, so it counts as the sync
+    int close_ret = fs_close(&file);
+    ret = (ret < 0) ? ret : close_ret;
+    hpi_flash_stats_end(job->tag, begin, job->len, true, ret);
+
+    return ret;
+}
+
+static void storage_run_job(struct hpi_storage_job *job)
+{
+    int ret;
+
+    switch (job->op)
+    {
+    case HPI_STORAGE_OP_WRITE:
+    case HPI_STORAGE_OP_APPEND:
+        ret = storage_write_file(job);
+        k_heap_free(&storage_heap, job->data);
+        break;
+
+    case HPI_STORAGE_OP_UNLINK:
+        ret = fs_unlink(job->path);
+        if (ret < 0 && ret != -ENOENT)
+        {
+            LOG_ERR("FAIL: unlink %s: %d", job->path, ret);
+        }
+        break;
+
+    case HPI_STORAGE_OP_CALL:
+        ret = job->fn(job);
+        break;
+
+    default:
+        ret = -EINVAL;
+        break;
+    }
+
+    if (job->done != NULL)
+    {
+        job->done(ret, job->user_data);
+    }
+}
+
+static void storage_thread(void)
+{
+    struct hpi_storage_job job;
+    struct k_poll_event storage_events[HPI_STORAGE_PRIO_COUNT];
+
+    for (int i = 0; i < HPI_STORAGE_PRIO_COUNT; i++)
+    {
+        k_poll_event_init(&storage_events[i], K_POLL_TYPE_MSGQ_DATA_AVAILABLE, K_POLL_MODE_NOTIFY_ONLY,
+                          storage_queues[i]);
+    }
+
+    for (;;)
+    {
+        k_poll(storage_events, HPI_STORAGE_PRIO_COUNT, K_FOREVER);
+
+        for (int i = 0; i < HPI_STORAGE_PRIO_COUNT; i++)
+        {
+            storage_events[i].state = K_POLL_STATE_NOT_READY;
+        }
+
+        // One job at a time from the highest priority queue that has one, so
+        // a record chunk never waits behind a backlog of trend or metadata jobs
+        int prio = 0;
+        while (prio < HPI_STORAGE_PRIO_COUNT)
+        {
+            if (k_msgq_get(storage_queues[prio], &job, K_NO_WAIT) == 0)
+            {
+                storage_run_job(&job);
+                prio = 0;
+            }
+            else
+            {
+                prio++;
+            }
+        }
+    }
+}
+
+K_THREAD_DEFINE(storage_thread_id, STORAGE_THREAD_STACKSIZE, storage_thread, NULL, NULL, NULL, STORAGE_THREAD_PRIORITY, 0, 0);
@@ -0,0 +1,140 @@
+/*
+ * HealthyPi Move
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Copyright (c) 2025 Protocentral Electronics
+ *
+ * Author: Ashwin Whitchurch, Protocentral Electronics
+ * Contact: ashwin@protocentral.com
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef storage_module_h
+#define storage_module_h
+
+#include <zephyr/kernel.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+Single storage worker that owns littlefs writes. Other threads queue write,
+append, unlink or call jobs and get an optional completion callback, so sensor
+and UI threads never wait on a flash erase. Queues are served strictly by
+priority.
+*/
+
+enum hpi_storage_prio
+{
+    HPI_STORAGE_PRIO_RECORD = 0,
+    HPI_STORAGE_PRIO_TREND,
+    HPI_STORAGE_PRIO_META,
+    HPI_STORAGE_PRIO_COUNT,
+};
+
+enum hpi_storage_op
+{
+    HPI_STORAGE_OP_WRITE,  // Replace the file with data
+    HPI_STORAGE_OP_APPEND, // Append data, creating the file if needed
+    HPI_STORAGE_OP_UNLINK,
+    HPI_STORAGE_OP_CALL,   // Run fn on the storage thread
+};
+
+#define HPI_STORAGE_PATH_MAX 40
+
+struct hpi_storage_job;
+
+typedef int (*hpi_storage_fn_t)(const struct hpi_storage_job *job);
+typedef void (*hpi_storage_done_t)(int result, void *user_data);
+
+struct hpi_storage_job
+{
+    uint8_t op;
+    uint8_t tag;    // Free for CALL jobs
+    uint16_t len;
+    void *data;     // Heap copy for WRITE/APPEND, caller owned for CALL
+    int64_t ts;     // Free for CALL jobs
+    hpi_storage_fn_t fn;
+    hpi_storage_done_t done;
+    void *user_data;
+    char path[HPI_STORAGE_PATH_MAX];
+};
+
+/* Queue a copy of data to replace / be appended to path. Fails with -ENOMEM
+   if the copy doesn't fit in the storage heap, or -EAGAIN if the queue is full.
+   stats_key is the flash I/O statistics key the write is accounted to. */
+int hpi_storage_write(enum hpi_storage_prio prio, uint8_t stats_key, const char *path, const void *data, size_t len,
+                      hpi_storage_done_t done, void *user_data);
+int hpi_storage_append(enum hpi_storage_prio prio, uint8_t stats_key, const char *path, const void *data, size_t len,
+                       hpi_storage_done_t done, void *user_data);
+int hpi_storage_unlink(enum hpi_storage_prio prio, const char *path, hpi_storage_done_t done, void *user_data);
+
+/* Queue a HPI_STORAGE_OP_CALL job; the job is copied into the queue */
+int hpi_storage_submit(enum hpi_storage_prio prio, const struct hpi_storage_job *job, k_timeout_t timeout);
+
+/* Wait until every job queued before this call has completed. Must not be
+   called from the storage thread. */
+int hpi_storage_flush(void);
+
+/*
+Flash I/O statistics, keyed by enum hpi_log_types plus the keys below. Each
+key counts bytes written, write and sync operations, errors and a log2
+histogram of operation latency: bucket i counts operations that took
+[2^i, 2^(i+1)) microseconds, the first and last buckets are open ended.
+*/
+
+#define HPI_FLASH_STATS_KEY_SYS 0x20      // System metadata, calibration vectors, markers
+#define HPI_FLASH_STATS_KEY_SETTINGS 0x21 // User settings store
+#define HPI_FLASH_STATS_KEY_ALL 0xFF      // All keys, for hpi_flash_stats_reset() and the stats command
+
+#define HPI_FLASH_LAT_BUCKETS 20
+
+struct hpi_flash_io_stats_t
+{
+    uint32_t bytes_written;
+    uint32_t write_ops;
+    uint32_t sync_ops;
+    uint32_t errors;
+    uint32_t max_latency_us;
+    uint32_t latency_hist[HPI_FLASH_LAT_BUCKETS];
+};
+
+/* Time an operation: pass the value returned by hpi_flash_stats_begin() to
+   hpi_flash_stats_end() along with what the operation did */
+static inline uint32_t hpi_flash_stats_begin(void)
+{
+    return k_cycle_get_32();
+}
+
+void hpi_flash_stats_end(uint8_t key, uint32_t begin, size_t bytes, bool synced, int result);
+
+/* Tracked keys, returns their number */
+size_t hpi_flash_stats_keys(const uint8_t **keys);
+
+/* Returns -EINVAL for a key that isn't tracked */
+int hpi_flash_stats_get(uint8_t key, struct hpi_flash_io_stats_t *stats);
+void hpi_flash_stats_reset(uint8_t key);
+
+/* Print the statistics of one or all keys to the USB CDC console */
+void hpi_flash_stats_print_usb(uint8_t key);
+
+#endif
@@ -48,6 +48,7 @@
 #include "fs_module.h"
 #include "trends.h"
 #include "log_module.h"
+#include "storage_module.h"
 
 LOG_MODULE_REGISTER(trends_module, LOG_LEVEL_DBG);
 
@@ -64,8 +65,6 @@ LOG_MODULE_REGISTER(trends_module, LOG_LEVEL_DBG);
 #define TEMP_TREND_MINUTE_PTS 12
 
 #define NUM_HOURS 24
-#define MAX_POINTS_PER_HOUR 60
-#define MAX_POINTS_SPO2_PER_HOUR 10
 
 // Store raw HR values for the current minute
 static uint16_t m_hr_curr_minute[60] = {0};   // Assumed max 60 points per minute
@@ -79,10 +78,51 @@ static uint8_t m_trends_curr_minute_counter = 0;
 static uint8_t m_trends_temp_minute_sample_counter = 0;
 static uint8_t m_trends_hr_minute_sample_counter = 0;
 
-// Static buffers to avoid large stack allocations (51KB total)
-// These replace the problematic stack arrays in hpi_trend_load_trend()
-static struct hpi_hr_trend_point_t trend_day_points[NUM_HOURS][MAX_POINTS_PER_HOUR];
-static struct hpi_hr_trend_point_t trend_point_all[1440];
+// Table-driven trend engine
+//
+// Each trend type has a descriptor giving its on-flash record size, a decoder
+// into the common hpi_trend_sample_t and how samples aggregate, so loading,
+// rollups and range queries share one streaming path for all trend types.
+// Hourly/daily rollups are kept next to the raw minute file as <day_ts>.roll
+// and updated as points arrive.
+#define TREND_RECENT_PTS 60
+#define TREND_READ_PTS 16
+#define TREND_SECONDS_PER_DAY 86400
+
+enum hpi_trend_agg
+{
+    TREND_AGG_MEAN, // Minute values are averaged
+    TREND_AGG_SUM,  // Minute values are increments and are totalled
+};
+
+struct hpi_trend_desc
+{
+    uint8_t log_type;
+    uint8_t record_size;
+    enum hpi_trend_agg agg;
+    void (*decode)(const uint8_t *raw, struct hpi_trend_sample_t *sample);
+};
+
+struct hpi_trend_state
+{
+    struct hpi_trend_rollup_file_t roll;
+    int8_t curr_hour;             // Hour of the last added point, -1 if none
+    bool dirty;
+    int64_t dirty_since;          // Uptime of the first unsaved update
+
+    // Last hour of minute samples for the hour chart
+    struct hpi_trend_sample_t recent[TREND_RECENT_PTS];
+    uint8_t recent_head;
+    uint8_t recent_count;
+};
+
+static struct hpi_trend_state trend_states[TREND_TYPE_COUNT];
+
+// Scratch shared by all streaming reads, protected by trend_engine_mutex
+static uint8_t trend_read_buf[TREND_READ_PTS * HPI_TREND_POINT_SIZE];
+static uint8_t trend_cache_buf[HPI_TREND_CACHE_MAX_BYTES];
+static struct hpi_trend_rollup_file_t trend_query_roll;
+K_MUTEX_DEFINE(trend_engine_mutex);
 
 // Time variables
 static struct tm m_trend_sys_time_tm;
@@ -202,6 +242,536 @@ static int64_t hpi_trend_get_day_start_ts(int64_t *today_time_ts)
     return timeutil_timegm64(&today_time_tm);
 }
 
+static void trend_decode_hr(const uint8_t *raw, struct hpi_trend_sample_t *sample)
+{
+    struct hpi_hr_trend_point_t point;
+
+    memcpy(&point, raw, sizeof(point));
+    sample->timestamp = point.timestamp;
+    sample->max = point.max;
+    sample->min = point.min;
+    sample->avg = point.avg;
+    sample->latest = point.latest;
+}
+
+static void trend_decode_temp(const uint8_t *raw, struct hpi_trend_sample_t *sample)
+{
+    struct hpi_temp_trend_point_t point;
+
+    memcpy(&point, raw, sizeof(point));
+    sample->timestamp = point.timestamp;
+    sample->max = point.max;
+    sample->min = point.min;
+    sample->avg = point.avg;
+    sample->latest = point.latest;
+}
+
+static void trend_decode_spo2(const uint8_t *raw, struct hpi_trend_sample_t *sample)
+{
+    struct hpi_spo2_point_t point;
+
+    memcpy(&point, raw, sizeof(point));
+    sample->timestamp = point.timestamp;
+    sample->max = point.spo2;
+    sample->min = point.spo2;
+    sample->avg = point.spo2;
+    sample->latest = point.spo2;
+}
+
+static void trend_decode_steps(const uint8_t *raw, struct hpi_trend_sample_t *sample)
+{
+    struct hpi_steps_t point;
+
+    memcpy(&point, raw, sizeof(point));
+    sample->timestamp = point.timestamp;
+    sample->max = point.steps;
+    sample->min = point.steps;
+    sample->avg = point.steps;
+    sample->latest = point.steps;
+}
+
+// Systolic/diastolic map onto max/min, avg carries the mean arterial pressure
+static void trend_decode_bpt(const uint8_t *raw, struct hpi_trend_sample_t *sample)
+{
+    struct hpi_bpt_point_t point;
+
+    memcpy(&point, raw, sizeof(point));
+    sample->timestamp = point.timestamp;
+    sample->max = point.sys;
+    sample->min = point.dia;
+    sample->avg = point.dia + (point.sys - point.dia) / 3;
+    sample->latest = point.sys;
+}
+
+static const struct hpi_trend_desc trend_descs[TREND_TYPE_COUNT] = {
+    [TREND_HR] = {HPI_LOG_TYPE_TREND_HR, sizeof(struct hpi_hr_trend_point_t), TREND_AGG_MEAN, trend_decode_hr},
+    [TREND_SPO2] = {HPI_LOG_TYPE_TREND_SPO2, sizeof(struct hpi_spo2_point_t), TREND_AGG_MEAN, trend_decode_spo2},
+    [TREND_TEMP] = {HPI_LOG_TYPE_TREND_TEMP, sizeof(struct hpi_temp_trend_point_t), TREND_AGG_MEAN, trend_decode_temp},
+    [TREND_BPT] = {HPI_LOG_TYPE_TREND_BPT, sizeof(struct hpi_bpt_point_t), TREND_AGG_MEAN, trend_decode_bpt},
+    [TREND_STEPS] = {HPI_LOG_TYPE_TREND_STEPS, sizeof(struct hpi_steps_t), TREND_AGG_SUM, trend_decode_steps},
+};
+
+BUILD_ASSERT(sizeof(struct hpi_hr_trend_point_t) <= HPI_TREND_POINT_SIZE &&
+             sizeof(struct hpi_temp_trend_point_t) <= HPI_TREND_POINT_SIZE &&
+             sizeof(struct hpi_spo2_point_t) <= HPI_TREND_POINT_SIZE &&
+             sizeof(struct hpi_steps_t) <= HPI_TREND_POINT_SIZE &&
+             sizeof(struct hpi_bpt_point_t) <= HPI_TREND_POINT_SIZE);
+
+typedef void (*trend_sample_cb_t)(const struct hpi_trend_sample_t *sample, void *ctx);
+
+static void trend_rollup_path(char *fname, size_t len, enum trend_type m_trend_type, int64_t day_ts)
+{
+    char base_path[20];
+
+    hpi_log_get_path(base_path, trend_descs[m_trend_type].log_type);
+    snprintf(fname, len, "%s%" PRId64 HPI_TREND_ROLLUP_SUFFIX, base_path, day_ts);
+}
+
+uint16_t hpi_trend_rec_value(enum trend_type m_trend_type, const struct hpi_trend_rollup_rec_t *rec)
+{
+    if (m_trend_type >= TREND_TYPE_COUNT || rec->count == 0)
+    {
+        return 0;
+    }
+
+    if (trend_descs[m_trend_type].agg == TREND_AGG_SUM)
+    {
+        return MIN(rec->sum, UINT16_MAX);
+    }
+
+    return rec->sum / rec->count;
+}
+
+static void trend_rec_add(struct hpi_trend_rollup_rec_t *rec, const struct hpi_trend_sample_t *sample)
+{
+    if (rec->count == 0 || sample->max > rec->max)
+    {
+        rec->max = sample->max;
+    }
+    if ((sample->min != 0) && (rec->min == 0 || sample->min < rec->min))
+    {
+        rec->min = sample->min;
+    }
+    rec->sum += sample->avg;
+    rec->latest = sample->latest;
+    rec->count++;
+}
+
+static void trend_rec_merge(struct hpi_trend_rollup_rec_t *dst, const struct hpi_trend_rollup_rec_t *src)
+{
+    if (src->count == 0)
+    {
+        return;
+    }
+
+    if (dst->count == 0 || src->max > dst->max)
+    {
+        dst->max = src->max;
+    }
+    if ((src->min != 0) && (dst->min == 0 || src->min < dst->min))
+    {
+        dst->min = src->min;
+    }
+    dst->sum += src->sum;
+    dst->latest = src->latest;
+    dst->count += src->count;
+}
+
+// Returns the hour the sample was added to, or -1 if it lies outside the day
+static int trend_rollup_apply(struct hpi_trend_rollup_file_t *roll, const struct hpi_trend_sample_t *sample)
+{
+    int64_t hour = (sample->timestamp - roll->day_ts) / 3600;
+
+    // The day record counts every raw point so it can be checked against the file size
+    trend_rec_add(&roll->day, sample);
+
+    if (hour < 0 || hour >= NUM_HOURS)
+    {
+        LOG_ERR("Trend point %" PRId64 " outside day %" PRId64, sample->timestamp, roll->day_ts);
+        return -1;
+    }
+
+    trend_rec_add(&roll->hours[hour], sample);
+    return hour;
+}
+
+static void trend_push_recent(struct hpi_trend_state *state, const struct hpi_trend_sample_t *sample)
+{
+    state->recent[state->recent_head] = *sample;
+    state->recent_head = (state->recent_head + 1) % TREND_RECENT_PTS;
+    if (state->recent_count < TREND_RECENT_PTS)
+    {
+        state->recent_count++;
+    }
+}
+
+static void trend_cb_rollup(const struct hpi_trend_sample_t *sample, void *ctx)
+{
+    trend_rollup_apply(ctx, sample);
+}
+
+static void trend_cb_recent(const struct hpi_trend_sample_t *sample, void *ctx)
+{
+    trend_push_recent(ctx, sample);
+}
+
+static void trend_cb_live_rebuild(const struct hpi_trend_sample_t *sample, void *ctx)
+{
+    struct hpi_trend_state *state = ctx;
+
+    trend_rollup_apply(&state->roll, sample);
+    trend_push_recent(state, sample);
+}
+
+struct trend_range_ctx
+{
+    int64_t start_ts;
+    int64_t end_ts;
+    struct hpi_trend_rollup_rec_t *rec;
+};
+
+static void trend_cb_range(const struct hpi_trend_sample_t *sample, void *ctx)
+{
+    struct trend_range_ctx *range = ctx;
+
+    if (sample->timestamp >= range->start_ts && sample->timestamp < range->end_ts)
+    {
+        trend_rec_add(range->rec, sample);
+    }
+}
+
+// Number of raw points of a day, on flash or still buffered by the log
+// module. Must be called with trend_engine_mutex held.
+static uint32_t trend_day_raw_points(enum trend_type m_trend_type, int64_t day_ts)
+{
+    struct hpi_trend_file_hdr_t hdr;
+    struct fs_file_t file;
+    uint32_t num_records;
+    uint32_t num_cached;
+
+    if (hpi_trend_file_open(trend_descs[m_trend_type].log_type, day_ts, trend_descs[m_trend_type].record_size,
+                            &file, &hdr, &num_records, NULL, &num_cached) == 0)
+    {
+        fs_close(&file);
+    }
+
+    return num_records + num_cached;
+}
+
+// Range of the buffered points in trend_cache_buf that fall in hours
+// [from_hour, to_hour). They are in time order, so the range is contiguous.
+static void trend_cached_hour_span(enum trend_type m_trend_type, int64_t day_ts, uint32_t num_cached,
+                                   int from_hour, int to_hour, uint32_t *start, uint32_t *count)
+{
+    const struct hpi_trend_desc *desc = &trend_descs[m_trend_type];
+    uint32_t first = num_cached;
+    uint32_t end = num_cached;
+
+    for (uint32_t i = 0; i < num_cached; i++)
+    {
+        struct hpi_trend_sample_t sample;
+        int64_t hour;
+
+        desc->decode(&trend_cache_buf[i * desc->record_size], &sample);
+        hour = (sample.timestamp - day_ts) / 3600;
+
+        if (first == num_cached && hour >= from_hour)
+        {
+            first = i;
+        }
+        if (hour >= to_hour)
+        {
+            end = i;
+            break;
+        }
+    }
+
+    *start = first;
+    *count = (end > first) ? (end - first) : 0;
+}
+
+// Streams the raw points of hours [from_hour, to_hour) of a day through a
+// small buffer, seeking straight to them with the file's hour index. Points
+// the log module hasn't written yet follow the ones on flash, so nothing has
+// to be flushed first. With max_tail > 0 only the last max_tail of those
+// points are read.
+// Must be called with trend_engine_mutex held.
+static int trend_stream_day(enum trend_type m_trend_type, int64_t day_ts, int from_hour, int to_hour,
+                            uint32_t max_tail, trend_sample_cb_t cb, void *ctx)
+{
+    const struct hpi_trend_desc *desc = &trend_descs[m_trend_type];
+    struct hpi_trend_file_hdr_t hdr;
+    struct fs_file_t file;
+    uint32_t num_records;
+    uint32_t num_cached;
+    uint32_t start = 0;
+    uint32_t count = 0;
+    uint32_t cached_start;
+    uint32_t cached_count;
+    bool have_file;
+    int ret;
+
+    ret = hpi_trend_file_open(desc->log_type, day_ts, desc->record_size, &file, &hdr, &num_records, trend_cache_buf,
+                              &num_cached);
+    if (ret < 0 && num_cached == 0)
+    {
+        return ret;
+    }
+    have_file = (ret == 0);
+
+    if (have_file)
+    {
+        hpi_trend_file_hour_span(&hdr, num_records, from_hour, to_hour, &start, &count);
+    }
+    trend_cached_hour_span(m_trend_type, day_ts, num_cached, from_hour, to_hour, &cached_start, &cached_count);
+
+    if (max_tail > 0 && count + cached_count > max_tail)
+    {
+        uint32_t skip = count + cached_count - max_tail;
+        uint32_t skip_file = MIN(skip, count);
+
+        start += skip_file;
+        count -= skip_file;
+        cached_start += skip - skip_file;
+        cached_count -= skip - skip_file;
+    }
+
+    ret = 0;
+    if (have_file)
+    {
+        ret = fs_seek(&file, HPI_TREND_FILE_HDR_SIZE + (off_t)start * desc->record_size, FS_SEEK_SET);
+    }
+
+    while (ret == 0 && count > 0)
+    {
+        uint32_t batch = MIN(count, TREND_READ_PTS);
+
+        ret = fs_read(&file, trend_read_buf, batch * desc->record_size);
+        if (ret < (int)(batch * desc->record_size))
+        {
+            ret = (ret < 0) ? ret : -EIO;
+            break;
+        }
+        ret = 0;
+
+        for (uint32_t i = 0; i < batch; i++)
+        {
+            struct hpi_trend_sample_t sample;
+
+            desc->decode(&trend_read_buf[i * desc->record_size], &sample);
+            cb(&sample, ctx);
+        }
+
+        count -= batch;
+    }
+
+    if (have_file)
+    {
+        fs_close(&file);
+    }
+
+    if (ret < 0)
+    {
+        LOG_ERR("FAIL: read trend %d day %" PRId64 ": %d", m_trend_type, day_ts, ret);
+        return ret;
+    }
+
+    for (uint32_t i = cached_start; i < cached_start + cached_count; i++)
+    {
+        struct hpi_trend_sample_t sample;
+
+        desc->decode(&trend_cache_buf[i * desc->record_size], &sample);
+        cb(&sample, ctx);
+    }
+
+    return 0;
+}
+
+// Reads a saved rollup and checks it still matches the raw file
+static bool trend_read_rollup_file(enum trend_type m_trend_type, int64_t day_ts, uint32_t raw_points,
+                                   struct hpi_trend_rollup_file_t *roll)
+{
+    struct fs_file_t file;
+    char fname[40];
+    int ret;
+
+    trend_rollup_path(fname, sizeof(fname), m_trend_type, day_ts);
+
+    fs_file_t_init(&file);
+    if (fs_open(&file, fname, FS_O_READ) != 0)
+    {
+        return false;
+    }
+
+    ret = fs_read(&file, roll, sizeof(*roll));
+    fs_close(&file);
+
+    return (ret == sizeof(*roll)) && (roll->day_ts == day_ts) && (roll->day.count == raw_points);
+}
+
+// Queues a copy of the rollup for the storage thread
+static int trend_write_rollup_file(enum trend_type m_trend_type, const struct hpi_trend_rollup_file_t *roll)
+{
+    char fname[40];
+
+    trend_rollup_path(fname, sizeof(fname), m_trend_type, roll->day_ts);
+
+    return hpi_storage_write(HPI_STORAGE_PRIO_TREND, trend_descs[m_trend_type].log_type, fname, roll, sizeof(*roll),
+                             NULL, NULL);
+}
+
+static void trend_save_state(enum trend_type m_trend_type)
+{
+    struct hpi_trend_state *state = &trend_states[m_trend_type];
+
+    trend_write_rollup_file(m_trend_type, &state->roll);
+    state->dirty = false;
+}
+
+// Makes day_ts the live day of a trend type. A rollup whose point count
+// doesn't match the raw minute file (missing, older firmware, or lost before
+// a flush) is rebuilt from the raw file. Must be called with
+// trend_engine_mutex held.
+static void trend_open_live_day(enum trend_type m_trend_type, int64_t day_ts)
+{
+    struct hpi_trend_state *state = &trend_states[m_trend_type];
+    uint32_t raw_points;
+
+    if (state->dirty)
+    {
+        trend_save_state(m_trend_type);
+    }
+
+    memset(state, 0, sizeof(*state));
+    state->roll.day_ts = day_ts;
+    state->curr_hour = -1;
+
+    raw_points = trend_day_raw_points(m_trend_type, day_ts);
+    if (raw_points == 0)
+    {
+        return;
+    }
+
+    if (trend_read_rollup_file(m_trend_type, day_ts, raw_points, &state->roll))
+    {
+        // Only the tail is needed to refill the hour chart
+        trend_stream_day(m_trend_type, day_ts, 0, NUM_HOURS, TREND_RECENT_PTS, trend_cb_recent, state);
+        return;
+    }
+
+    LOG_INF("Rebuilding trend rollup %d for day %" PRId64 " (%u points)", m_trend_type, day_ts, raw_points);
+
+    memset(&state->roll, 0, sizeof(state->roll));
+    state->roll.day_ts = day_ts;
+    trend_stream_day(m_trend_type, day_ts, 0, NUM_HOURS, 0, trend_cb_live_rebuild, state);
+
+    state->dirty = true;
+    state->dirty_since = k_uptime_get();
+}
+
+// Rollup of any day: the live state for the current day, otherwise the saved
+// rollup, rebuilt and saved again if stale. Must be called with
+// trend_engine_mutex held.
+static int trend_get_day_rollup(enum trend_type m_trend_type, int64_t day_ts, struct hpi_trend_rollup_file_t *roll)
+{
+    uint32_t raw_points;
+    int ret;
+
+    if (trend_states[m_trend_type].roll.day_ts == day_ts)
+    {
+        *roll = trend_states[m_trend_type].roll;
+        return 0;
+    }
+
+    memset(roll, 0, sizeof(*roll));
+    roll->day_ts = day_ts;
+
+    raw_points = trend_day_raw_points(m_trend_type, day_ts);
+    if (raw_points == 0)
+    {
+        return -ENOENT;
+    }
+
+    if (trend_read_rollup_file(m_trend_type, day_ts, raw_points, roll))
+    {
+        return 0;
+    }
+
+    memset(roll, 0, sizeof(*roll));
+    roll->day_ts = day_ts;
+
+    ret = trend_stream_day(m_trend_type, day_ts, 0, NUM_HOURS, 0, trend_cb_rollup, roll);
+    if (ret == 0)
+    {
+        trend_write_rollup_file(m_trend_type, roll);
+    }
+
+    return ret;
+}
+
+// Called before the raw point is written so a rebuild never counts it twice
+static void trend_add_point(enum trend_type m_trend_type, const void *point, int64_t day_ts)
+{
+    struct hpi_trend_state *state = &trend_states[m_trend_type];
+    struct hpi_trend_sample_t sample;
+    int8_t prev_hour;
+    int hour;
+
+    trend_descs[m_trend_type].decode(point, &sample);
+
+    k_mutex_lock(&trend_engine_mutex, K_FOREVER);
+
+    if (state->roll.day_ts != day_ts)
+    {
+        trend_open_live_day(m_trend_type, day_ts);
+    }
+
+    prev_hour = state->curr_hour;
+    hour = trend_rollup_apply(&state->roll, &sample);
+    trend_push_recent(state, &sample);
+    if (hour >= 0)
+    {
+        state->curr_hour = hour;
+    }
+
+    if (!state->dirty)
+    {
+        state->dirty = true;
+        state->dirty_since = k_uptime_get();
+    }
+
+    // Persist each completed hour
+    if (prev_hour >= 0 && prev_hour != state->curr_hour)
+    {
+        trend_save_state(m_trend_type);
+    }
+
+    k_mutex_unlock(&trend_engine_mutex);
+}
+
+static void trend_save_if_due(void)
+{
+    int64_t now = k_uptime_get();
+
+    k_mutex_lock(&trend_engine_mutex, K_FOREVER);
+    for (int i = 0; i < TREND_TYPE_COUNT; i++)
+    {
+        if (trend_states[i].dirty &&
+            (now - trend_states[i].dirty_since) >= (CONFIG_HPI_TREND_CACHE_FLUSH_INTERVAL_S * 1000LL))
+        {
+            trend_save_state(i);
+        }
+    }
+    k_mutex_unlock(&trend_engine_mutex);
+}
+
+void hpi_trend_rollup_reset(void)
+{
+    k_mutex_lock(&trend_engine_mutex, K_FOREVER);
+    memset(trend_states, 0, sizeof(trend_states));
+    k_mutex_unlock(&trend_engine_mutex);
+}
+
 void hpi_trend_record_thread(void)
 {
     struct hpi_hr_trend_point_t trend_hr_minute;
@@ -219,6 +789,7 @@ void hpi_trend_record_thread(void)
         {
             int64_t today_ts = hpi_trend_get_day_start_ts(&trend_hr_minute.timestamp);
             LOG_DBG("Recd HR point: %" PRId64 "| %d | %d | %d", trend_hr_minute.timestamp, trend_hr_minute.max, trend_hr_minute.min, trend_hr_minute.avg);
+            trend_add_point(TREND_HR, &trend_hr_minute, today_ts);
             hpi_hr_trend_wr_point_to_file(trend_hr_minute, today_ts);
         }
 
@@ -226,6 +797,7 @@ void hpi_trend_record_thread(void)
         {
             int64_t today_ts = hpi_trend_get_day_start_ts(&trend_temp.timestamp);
             LOG_DBG("Recd Temp point: %" PRId64 "| %d | %d | %d", trend_temp.timestamp, trend_temp.max, trend_temp.min, trend_temp.avg);
+            trend_add_point(TREND_TEMP, &trend_temp, today_ts);
             hpi_temp_trend_wr_point_to_file(trend_temp, today_ts);
         }
 
@@ -233,6 +805,7 @@ void hpi_trend_record_thread(void)
         {
             int64_t today_ts = hpi_trend_get_day_start_ts(&trend_spo2.timestamp);
             LOG_DBG("Recd SpO2 point: %" PRId64 "| %d ", trend_spo2.timestamp, trend_spo2.spo2);
+            trend_add_point(TREND_SPO2, &trend_spo2, today_ts);
             hpi_spo2_trend_wr_point_to_file(trend_spo2, today_ts);
         }
 
@@ -240,6 +813,7 @@ void hpi_trend_record_thread(void)
         {
             int64_t today_ts = hpi_trend_get_day_start_ts(&trend_steps.timestamp);
             LOG_DBG("Recd Steps point: %" PRId64 "| %d ", trend_steps.timestamp, trend_steps.steps);
+            trend_add_point(TREND_STEPS, &trend_steps, today_ts);
             hpi_steps_trend_wr_point_to_file(trend_steps, today_ts);
         }
         
@@ -247,153 +821,166 @@ void hpi_trend_record_thread(void)
         {
             int64_t today_ts = hpi_trend_get_day_start_ts(&trend_bpt.timestamp);
             LOG_DBG("Recd BPT point: %" PRId64 "| %d | %d | %d", trend_bpt.timestamp, trend_bpt.sys, trend_bpt.dia, trend_bpt.hr);
+            trend_add_point(TREND_BPT, &trend_bpt, today_ts);
             hpi_bpt_trend_wr_point_to_file(trend_bpt, today_ts);
         }
 
+        hpi_log_trend_flush_if_due();
+        trend_save_if_due();
+
         k_sleep(K_SECONDS(2));
     }
 }
 
 int hpi_trend_load_trend(struct hpi_hourly_trend_point_t *hourly_trend_points, struct hpi_minutely_trend_point_t *minutely_trend_points, int *num_points, enum trend_type m_trend_type)
 {
-    struct fs_file_t file;
+    struct hpi_trend_state *state;
+    int64_t day_ts = hpi_trend_get_day_start_ts(&m_trend_time_ts);
     int ret = 0;
 
-    struct fs_dirent trend_file_ent;
-    char fname[30];
-
-    uint16_t num_trend_points;
-
-    int64_t day_ts = hpi_trend_get_day_start_ts(&m_trend_time_ts);
+    if (m_trend_type >= TREND_TYPE_COUNT)
+    {
+        LOG_ERR("Invalid trend type");
+        return -1;
+    }
 
-    fs_file_t_init(&file);
+    state = &trend_states[m_trend_type];
 
-    // Clear static buffers before use
-    memset(trend_day_points, 0, sizeof(trend_day_points));
-    memset(trend_point_all, 0, sizeof(trend_point_all));
+    k_mutex_lock(&trend_engine_mutex, K_FOREVER);
 
-    if (m_trend_type == TREND_HR)
+    if (state->roll.day_ts != day_ts)
     {
-        sprintf(fname, "/lfs/trhr/%" PRId64, day_ts);
+        trend_open_live_day(m_trend_type, day_ts);
     }
-    else if (m_trend_type == TREND_SPO2)
+
+    *num_points = state->roll.day.count;
+
+    if (state->roll.day.count == 0)
     {
-        sprintf(fname, "/lfs/trspo2/%" PRId64, day_ts);
+        LOG_DBG("No trend points for day %" PRId64, day_ts);
+        ret = -ENOENT;
+        goto out;
     }
-    else
+
+    for (int i = 0; i < NUM_HOURS; i++)
     {
-        LOG_ERR("Invalid trend type");
-        return -1;
+        const struct hpi_trend_rollup_rec_t *rec = &state->roll.hours[i];
+
+        hourly_trend_points[i].hour_no = i;
+        hourly_trend_points[i].max = rec->max;
+        hourly_trend_points[i].min = rec->min;
+        hourly_trend_points[i].avg = hpi_trend_rec_value(m_trend_type, rec);
+        hourly_trend_points[i].latest = rec->latest;
     }
 
-    ret = fs_stat(fname, &trend_file_ent);
-    if (ret < 0)
+    int8_t minute_counter = 0;
+    uint8_t oldest = (state->recent_head + TREND_RECENT_PTS - state->recent_count) % TREND_RECENT_PTS;
+    for (int i = 0; i < state->recent_count; i++)
     {
-        LOG_ERR("FAIL: stat %s: %d", fname, ret);
-        if (ret == -ENOENT)
+        const struct hpi_trend_sample_t *sample = &state->recent[(oldest + i) % TREND_RECENT_PTS];
+
+        if (sample->timestamp > m_trend_time_ts - 3600)
         {
-            *num_points = 0;
-            LOG_ERR("File not found: %s", fname);
+            minutely_trend_points[minute_counter].minute_no = minute_counter;
+            minutely_trend_points[minute_counter].max = sample->max;
+            minutely_trend_points[minute_counter].min = sample->min;
+            minutely_trend_points[minute_counter].avg = sample->avg;
+            minutely_trend_points[minute_counter].latest = sample->latest;
+            minute_counter++;
         }
-        return ret;
     }
 
-    LOG_DBG("Read from file %s | Size: %d", fname, trend_file_ent.size);
-
-    num_trend_points = trend_file_ent.size / sizeof(struct hpi_hr_trend_point_t);
-    *num_points = num_trend_points;
-
-    LOG_DBG("Num Trend Points: %d", num_trend_points);
+out:
+    k_mutex_unlock(&trend_engine_mutex);
+    return ret;
+}
 
-    ret = fs_open(&file, fname, FS_O_READ);
+int hpi_trend_load_day(enum trend_type m_trend_type, int64_t day_ts, struct hpi_hourly_trend_point_t *hourly_trend_points, int *num_points)
+{
+    int ret;
 
-    if (ret < 0)
+    if (m_trend_type >= TREND_TYPE_COUNT)
     {
-        LOG_ERR("FAIL: open %s: %d", fname, ret);
+        return -EINVAL;
     }
 
-    struct hpi_hr_trend_point_t hr_trend_point;
+    k_mutex_lock(&trend_engine_mutex, K_FOREVER);
 
-    int bucket_counts[NUM_HOURS] = {0};
+    ret = trend_get_day_rollup(m_trend_type, day_ts, &trend_query_roll);
+    *num_points = trend_query_roll.day.count;
 
-    for (int i = 0; i < num_trend_points; i++)
+    for (int i = 0; i < NUM_HOURS; i++)
     {
-        ret = fs_read(&file, &hr_trend_point, sizeof(hr_trend_point));
-        if (ret < 0)
-        {
-            LOG_ERR("FAIL: read %s: %d", fname, ret);
-        }
-        trend_point_all[i] = hr_trend_point;
-    }
+        const struct hpi_trend_rollup_rec_t *rec = &trend_query_roll.hours[i];
 
-    ret = fs_close(&file);
-    ret = fs_sync(&file);
+        hourly_trend_points[i].hour_no = i;
+        hourly_trend_points[i].max = rec->max;
+        hourly_trend_points[i].min = rec->min;
+        hourly_trend_points[i].avg = hpi_trend_rec_value(m_trend_type, rec);
+        hourly_trend_points[i].latest = rec->latest;
+    }
 
-    for (int i = 0; i < num_trend_points; i++)
-    {
-        struct tm *time_info = gmtime(&trend_point_all[i].timestamp);
-        int hour = time_info->tm_hour;
+    k_mutex_unlock(&trend_engine_mutex);
+    return ret;
+}
 
-        if (bucket_counts[hour] < MAX_POINTS_PER_HOUR)
-        {
-            trend_day_points[hour][bucket_counts[hour]] = trend_point_all[i];
-            bucket_counts[hour]++;
-        }
-        else
-        {
-            LOG_DBG("Bucket overflow for hour %d\n", hour);
-        }
-    }
+int hpi_trend_query_range(enum trend_type m_trend_type, int64_t start_ts, int64_t end_ts, struct hpi_trend_rollup_rec_t *result)
+{
+    int64_t day_ts;
 
-    int8_t minute_counter = 0;
-    for (int i = 0; i < num_trend_points; i++)
+    if (m_trend_type >= TREND_TYPE_COUNT || result == NULL || end_ts <= start_ts)
     {
-        if (trend_point_all[i].timestamp > m_trend_time_ts - 3600)
-        {
-            if (minute_counter >= 60)
-            {
-                LOG_ERR("Minute counter overflow");
-                break;
-            }
-            minutely_trend_points[minute_counter++].avg = trend_point_all[i].avg;
-        }
+        return -EINVAL;
     }
 
-    for (int i = 0; i < NUM_HOURS; i++)
-    {
-        // printf("Hour %d: %d points\n", i, bucket_counts[i]);
+    memset(result, 0, sizeof(*result));
 
-        hourly_trend_points[i].hour_no = i;
-        hourly_trend_points[i].avg = 0;
-        hourly_trend_points[i].max = 0;
-        hourly_trend_points[i].min = 0;
+    k_mutex_lock(&trend_engine_mutex, K_FOREVER);
 
-        uint16_t max = 0;
-        uint16_t min = 255;
+    for (day_ts = hpi_trend_get_day_start_ts(&start_ts); day_ts < end_ts; day_ts += TREND_SECONDS_PER_DAY)
+    {
+        int64_t from = MAX(start_ts, day_ts);
+        int64_t to = MIN(end_ts, day_ts + TREND_SECONDS_PER_DAY);
 
-        for (int j = 0; j < bucket_counts[i]; j++)
+        if ((from - day_ts) % 3600 == 0 && (to - day_ts) % 3600 == 0)
         {
-            if (trend_day_points[i][j].max > max)
+            // Hour aligned, served from the rollup without touching raw points
+            if (trend_get_day_rollup(m_trend_type, day_ts, &trend_query_roll) != 0)
             {
-                hourly_trend_points[i].max = trend_day_points[i][j].max;
+                continue;
             }
-            if (trend_day_points[i][j].min < min)
+
+            if (from == day_ts && to == day_ts + TREND_SECONDS_PER_DAY)
+            {
+                trend_rec_merge(result, &trend_query_roll.day);
+            }
+            else
             {
-                hourly_trend_points[i].min = trend_day_points[i][j].min;
+                for (int h = (from - day_ts) / 3600; h < (to - day_ts) / 3600; h++)
+                {
+                    trend_rec_merge(result, &trend_query_roll.hours[h]);
+                }
             }
-            hourly_trend_points[i].avg += trend_day_points[i][j].avg;
-            // printf("  Timestamp: %" PRIx64 "\n", trend_day_points[i][j].timestamp);
         }
-        if (bucket_counts[i] > 0)
+        else
         {
-            hourly_trend_points[i].avg /= bucket_counts[i];
+            struct trend_range_ctx range = {
+                .start_ts = from,
+                .end_ts = to,
+                .rec = result,
+            };
+            // Only the hours overlapping the range are read
+            trend_stream_day(m_trend_type, day_ts, (from - day_ts) / 3600, ((to - day_ts) + 3599) / 3600, 0,
+                             trend_cb_range, &range);
         }
-
-        // LOG_DBG("Hour %d: | %d | %d | %d", hr_hourly_trend_points[i].hour_no, hr_hourly_trend_points[i].max, hr_hourly_trend_points[i].min, hr_hourly_trend_points[i].avg);
     }
-    return 0;
+
+    k_mutex_unlock(&trend_engine_mutex);
+
+    return (result->count > 0) ? 0 : -ENOENT;
 }
 
+
 static void trend_spo2_listener(const struct zbus_channel *chan)
 {
     const struct hpi_spo2_point_t *hpi_spo2 = zbus_chan_const_msg(chan);
@@ -462,7 +1049,8 @@ ZBUS_LISTENER_DEFINE(trend_sys_time_lis, trend_sys_time_listener);
 #define THREAD_SAMPLE_THREAD_STACK_SIZE 1024
 #define THREAD_SAMPLE_THREAD_PRIORITY 5
 
-#define TREND_RECORD_THREAD_STACK_SIZE 2048
+// Rollup rebuilds stream day files from this thread as well
+#define TREND_RECORD_THREAD_STACK_SIZE 3072
 #define TREND_RECORD_THREAD_PRIORITY 5
 
-K_THREAD_DEFINE(trend_record_thread_id, TREND_RECORD_THREAD_STACK_SIZE, hpi_trend_record_thread, NULL, NULL, NULL, TREND_RECORD_THREAD_PRIORITY, 0, 2000);
\ No newline at end of file
+K_THREAD_DEFINE(trend_record_thread_id, TREND_RECORD_THREAD_STACK_SIZE, hpi_trend_record_thread, NULL, NULL, NULL, TREND_RECORD_THREAD_PRIORITY, 0, 2000);
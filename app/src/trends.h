@@ -51,6 +51,9 @@ struct hpi_temp_trend_point_t
 
 #define HPI_TREND_POINT_SIZE 16
 
+// Hourly/daily rollup kept next to each raw trend day file as <day_ts>.roll
+#define HPI_TREND_ROLLUP_SUFFIX ".roll"
+
 struct hpi_log_index_t
 {
     int64_t start_time;
@@ -69,6 +72,23 @@ struct hpi_hourly_trend_point_t
     uint16_t latest; 
 };
 
+// One rollup record covers an hour, or the whole day
+struct hpi_trend_rollup_rec_t
+{
+    uint16_t max;
+    uint16_t min;
+    uint32_t sum;
+    uint16_t count;
+    uint16_t latest;
+};
+
+struct hpi_trend_rollup_file_t
+{
+    int64_t day_ts;
+    struct hpi_trend_rollup_rec_t hours[24];
+    struct hpi_trend_rollup_rec_t day;
+};
+
 struct hpi_minutely_trend_point_t
 {
     uint8_t minute_no;
@@ -84,6 +104,22 @@ enum trend_type
     TREND_SPO2,
     TREND_TEMP,
     TREND_BPT,
+    TREND_STEPS,
+    TREND_TYPE_COUNT,
+};
+
+// Common decoded form of a raw trend point of any type
+struct hpi_trend_sample_t
+{
+    int64_t timestamp;
+    uint16_t max;
+    uint16_t min;
+    uint16_t avg;
+    uint16_t latest;
 };
 
 int hpi_trend_load_trend(struct hpi_hourly_trend_point_t *hourly_trend_points, struct hpi_minutely_trend_point_t *minute_trend_points, int *num_points, enum trend_type m_trend_type);
+int hpi_trend_load_day(enum trend_type m_trend_type, int64_t day_ts, struct hpi_hourly_trend_point_t *hourly_trend_points, int *num_points);
+int hpi_trend_query_range(enum trend_type m_trend_type, int64_t start_ts, int64_t end_ts, struct hpi_trend_rollup_rec_t *result);
+uint16_t hpi_trend_rec_value(enum trend_type m_trend_type, const struct hpi_trend_rollup_rec_t *rec);
+void hpi_trend_rollup_reset(void);
@@ -316,7 +316,7 @@ void draw_scr_spo2_select(enum scroll_dir m_scroll_dir, uint32_t arg1, uint32_t
 int hpi_disp_reset_all_last_updated(void);
 
 void hpi_disp_spo2_load_trend(void);
-void hpi_disp_spo2_plot_wrist_ppg(struct hpi_ppg_wr_data_t ppg_sensor_sample);
+void hpi_disp_spo2_plot_wrist_ppg(const struct hpi_ppg_wr_data_t *ppg_sensor_sample);
 void hpi_disp_spo2_plot_fi_ppg(struct hpi_ppg_fi_data_t ppg_sensor_sample);
 
 void hpi_disp_spo2_update_progress(int progress, enum spo2_meas_state state, int spo2, int hr);
@@ -368,7 +368,7 @@ void gesture_down_scr_pulldown(void);
 void gesture_down_scr_bpt_cal_required(void);
 
 // PPG screen functions
-void hpi_disp_ppg_draw_plotPPG(struct hpi_ppg_wr_data_t ppg_sensor_sample);
+void hpi_disp_ppg_draw_plotPPG(const struct hpi_ppg_wr_data_t *ppg_sensor_sample);
 void hpi_ppg_disp_update_hr(int hr);
 void hpi_ppg_check_signal_timeout(void);  // Check for signal timeout periodically
 
@@ -418,12 +418,12 @@ void hpi_hrv_summary_set_update_enabled(bool enabled);
 
 // HRV Frequency Analysis screen functions
 void draw_scr_hrv_frequency(enum scroll_dir m_scroll_dir, uint32_t arg1, uint32_t arg2, uint32_t arg3, uint32_t arg4);
-void hpi_hrv_frequency_update_spectrum(float *rr_intervals, int num_intervals);
+void hpi_hrv_frequency_update_spectrum(const struct hpi_hrv_spectrum_t *spectrum);
 void hpi_hrv_frequency_update_display(void);
 
 // HRV Frequency Compact screen functions (optimized for small round displays)
 void draw_scr_hrv_frequency_compact(enum scroll_dir m_scroll_dir);
-void hpi_hrv_frequency_compact_update_spectrum(float *rr_intervals, int num_intervals);
+void hpi_hrv_frequency_compact_update_spectrum(const struct hpi_hrv_spectrum_t *spectrum);
 void hpi_hrv_frequency_compact_update_display(void);
 
 // Settings screen functions
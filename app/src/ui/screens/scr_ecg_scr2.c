@@ -132,11 +132,11 @@ void draw_scr_ecg_scr2(enum scroll_dir m_scroll_dir, uint32_t arg1, uint32_t arg
     arc_ecg_zone = lv_arc_create(scr_ecg_scr2);
     lv_obj_set_size(arc_ecg_zone, 370, 370);  // 185px radius
     lv_obj_center(arc_ecg_zone);
-    lv_arc_set_range(arc_ecg_zone, 0, 30);  // Timer range: 0-30 seconds
+    lv_arc_set_range(arc_ecg_zone, 0, ECG_RECORD_DURATION_S);  // Timer range: 0 to recording length
     
     // Background arc: Full 270° track (gray)
     lv_arc_set_bg_angles(arc_ecg_zone, 135, 45);  // Full background arc
-    lv_arc_set_value(arc_ecg_zone, 30);  // Start at full (30 seconds), will countdown to 0
+    lv_arc_set_value(arc_ecg_zone, ECG_RECORD_DURATION_S);  // Start at full, will countdown to 0
     
     // Style the progress arc - orange theme for ECG measurement
     lv_obj_set_style_arc_color(arc_ecg_zone, lv_color_hex(0x333333), LV_PART_MAIN);    // Background track
@@ -166,7 +166,7 @@ void draw_scr_ecg_scr2(enum scroll_dir m_scroll_dir, uint32_t arg1, uint32_t arg
 
     // Timer value
     label_timer = lv_label_create(cont_timer);
-    lv_label_set_text(label_timer, "30");
+    lv_label_set_text_fmt(label_timer, "%d", ECG_RECORD_DURATION_S);
     lv_obj_add_style(label_timer, &style_body_medium, LV_PART_MAIN);
     lv_obj_set_style_text_color(label_timer, lv_color_white(), LV_PART_MAIN);
     lv_obj_set_style_pad_left(label_timer, 8, LV_PART_MAIN);
@@ -362,12 +362,12 @@ void hpi_ecg_disp_update_timer(int time_left)
     static char time_buf[8];
     
     if (time_left != last_time) { // Only update if changed
-        // Check if in stabilization phase (time > 30s means we're stabilizing)
-        bool is_stabilizing = (time_left > 30);
+        // Check if in stabilization phase (time > recording length means we're stabilizing)
+        bool is_stabilizing = (time_left > ECG_RECORD_DURATION_S);
         
         if (is_stabilizing) {
             // Show stabilization countdown (35s = 5s stabilizing, 30s = starting recording)
-            int stabilization_time = time_left - 30;
+            int stabilization_time = time_left - ECG_RECORD_DURATION_S;
             
             // Update timer label with stabilization time
             if (stabilization_time < 10) {
@@ -407,19 +407,23 @@ void hpi_ecg_disp_update_timer(int time_left)
                 time_buf[0] = '0' + (time_left / 10);
                 time_buf[1] = '0' + (time_left % 10);
                 time_buf[2] = '\0';
-            } else {
+            } else if (time_left < 1000) {
                 time_buf[0] = '0' + (time_left / 100);
                 time_buf[1] = '0' + ((time_left / 10) % 10);
                 time_buf[2] = '0' + (time_left % 10);
                 time_buf[3] = '\0';
+            } else {
+                // Long (Holter-style) recordings
+                snprintf(time_buf, sizeof(time_buf), "%d", time_left);
             }
             
             lv_label_set_text(label_timer, time_buf);
             
             // Update the progress arc to show progress towards completion
             if (arc_ecg_zone != NULL) {
-                // Show progress: empty at start (30s), full at end (0s)
-                int arc_value = (time_left < 0) ? 30 : ((time_left > 30) ? 0 : (30 - time_left));
+                // Show progress: empty at start (full length), full at end (0s)
+                int arc_value = (time_left < 0) ? ECG_RECORD_DURATION_S :
+                                ((time_left > ECG_RECORD_DURATION_S) ? 0 : (ECG_RECORD_DURATION_S - time_left));
                 lv_arc_set_value(arc_ecg_zone, arc_value);
                 
                 // Change arc color based on timer state: Orange when running, gray when paused
@@ -33,37 +33,12 @@ extern lv_style_t style_white_small;
 extern lv_style_t style_scr_black;
 extern lv_style_t style_red_medium;
 
-// Frequency domain analysis constants
-#define LF_FREQ_MIN 0.04f   // Low frequency minimum (Hz)
-#define LF_FREQ_MAX 0.15f   // Low frequency maximum (Hz) 
-#define HF_FREQ_MIN 0.15f   // High frequency minimum (Hz)
-#define HF_FREQ_MAX 0.4f    // High frequency maximum (Hz)
-
 // Static variables for HRV frequency analysis
 static float lf_power = 0.0f;
 static float hf_power = 0.0f;
 static float lf_hf_ratio = 0.0f;
 static float stress_score = 0.0f;
 
-// Simple frequency domain analysis functions
-static float calculate_power_in_band(float *psd, int psd_length, float fs, float freq_min, float freq_max)
-{
-    float power = 0.0f;
-    float freq_resolution = fs / (2.0f * psd_length);
-    
-    int start_idx = (int)(freq_min / freq_resolution);
-    int end_idx = (int)(freq_max / freq_resolution);
-    
-    if (end_idx >= psd_length) end_idx = psd_length - 1;
-    if (start_idx < 0) start_idx = 0;
-    
-    for (int i = start_idx; i <= end_idx; i++) {
-        power += psd[i];
-    }
-    
-    return power * freq_resolution;
-}
-
 static void calculate_stress_metrics(float lf, float hf, float *stress, float *parasympathetic, float *sympathetic)
 {
     float total_power = lf + hf;
@@ -281,44 +256,14 @@ void draw_scr_hrv_frequency(enum scroll_dir m_scroll_dir, uint32_t arg1, uint32_
     hpi_show_screen(scr_hrv_frequency, m_scroll_dir);
 }
 
-void hpi_hrv_frequency_update_spectrum(float *rr_intervals, int num_intervals)
+void hpi_hrv_frequency_update_spectrum(const struct hpi_hrv_spectrum_t *spectrum)
 {
-    // This is a simplified version - in a real implementation you would:
-    // 1. Apply window function to RR intervals
-    // 2. Perform FFT
-    // 3. Calculate power spectral density
-    // 4. Integrate power in LF and HF bands
-    
-    // For demonstration, we'll use simplified calculations
-    if (num_intervals < 10) return;
-    
-    // Calculate variance in different frequency bands (simplified)
-    float variance_total = 0.0f;
-    float mean_rr = 0.0f;
-    
-    // Calculate mean
-    for (int i = 0; i < num_intervals; i++) {
-        mean_rr += rr_intervals[i];
-    }
-    mean_rr /= num_intervals;
-    
-    // Calculate total variance
-    for (int i = 0; i < num_intervals; i++) {
-        float diff = rr_intervals[i] - mean_rr;
-        variance_total += diff * diff;
-    }
-    variance_total /= (num_intervals - 1);
-    
-    // Simulate LF and HF power (in real implementation, use FFT)
-    // This is a simplified estimation
-    lf_power = variance_total * 0.6f; // Assume 60% of power in LF band
-    hf_power = variance_total * 0.4f; // Assume 40% of power in HF band
-    
-    if (hf_power > 0) {
-        lf_hf_ratio = lf_power / hf_power;
-    } else {
-        lf_hf_ratio = 0.0f;
-    }
+    // Band powers come from hrv_spectrum_compute(), off the UI thread
+    if (spectrum == NULL || !spectrum->valid) return;
+
+    lf_power = spectrum->lf_power;
+    hf_power = spectrum->hf_power;
+    lf_hf_ratio = spectrum->lf_hf_ratio;
     
     // Calculate autonomic balance metrics
     float parasympathetic_activity, sympathetic_activity;
@@ -176,31 +176,12 @@ void draw_scr_hrv_frequency_compact(enum scroll_dir m_scroll_dir)
     hpi_show_screen(scr_hrv_frequency_compact, m_scroll_dir);
 }
 
-void hpi_hrv_frequency_compact_update_spectrum(float *rr_intervals, int num_intervals)
+void hpi_hrv_frequency_compact_update_spectrum(const struct hpi_hrv_spectrum_t *spectrum)
 {
-    // Simplified frequency analysis for compact display
-    if (num_intervals < 10) return;
-    
-    // Calculate simplified power estimates
-    float variance_total = 0.0f;
-    float mean_rr = 0.0f;
-    
-    // Calculate mean
-    for (int i = 0; i < num_intervals; i++) {
-        mean_rr += rr_intervals[i];
-    }
-    mean_rr /= num_intervals;
-    
-    // Calculate variance
-    for (int i = 0; i < num_intervals; i++) {
-        float diff = rr_intervals[i] - mean_rr;
-        variance_total += diff * diff;
-    }
-    variance_total /= (num_intervals - 1);
-    
-    // Simplified power distribution
-    lf_power_compact = variance_total * 0.65f;
-    hf_power_compact = variance_total * 0.35f;
+    if (spectrum == NULL || !spectrum->valid) return;
+
+    lf_power_compact = spectrum->lf_power;
+    hf_power_compact = spectrum->hf_power;
     
     stress_score_compact = get_stress_percentage(lf_power_compact, hf_power_compact);
     
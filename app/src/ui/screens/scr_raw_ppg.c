@@ -254,24 +254,24 @@ static void hpi_ppg_update_signal_status(enum hpi_ppg_status scd_state)
     }
 }
 
-void hpi_disp_ppg_draw_plotPPG(struct hpi_ppg_wr_data_t ppg_sensor_sample)
+void hpi_disp_ppg_draw_plotPPG(const struct hpi_ppg_wr_data_t *ppg_sensor_sample)
 {
     // Update last data received timestamp
     last_ppg_data_time = k_uptime_get_32();
 
     // Store the SCD state for use in periodic timeout checks
-    last_scd_state = ppg_sensor_sample.scd_state;
+    last_scd_state = ppg_sensor_sample->scd_state;
 
     // Update signal status based on SCD state
-    hpi_ppg_update_signal_status(ppg_sensor_sample.scd_state);
+    hpi_ppg_update_signal_status(ppg_sensor_sample->scd_state);
 
-    uint32_t *data_ppg = ppg_sensor_sample.raw_green;
+    const uint32_t *data_ppg = ppg_sensor_sample->raw_green;
 
     // Find min/max in current batch for accurate tracking
     uint32_t batch_min = UINT32_MAX;
     uint32_t batch_max = 0;
     
-    for (int i = 0; i < ppg_sensor_sample.ppg_num_samples; i++)
+    for (int i = 0; i < ppg_sensor_sample->ppg_num_samples; i++)
     {
         if (data_ppg[i] < batch_min) batch_min = data_ppg[i];
         if (data_ppg[i] > batch_max) batch_max = data_ppg[i];
@@ -297,7 +297,7 @@ void hpi_disp_ppg_draw_plotPPG(struct hpi_ppg_wr_data_t ppg_sensor_sample)
     }
 
     // Plot all samples
-    for (int i = 0; i < ppg_sensor_sample.ppg_num_samples; i++)
+    for (int i = 0; i < ppg_sensor_sample->ppg_num_samples; i++)
     {
         lv_chart_set_next_value(chart_ppg, ser_ppg, data_ppg[i]);
         hpi_ppg_disp_add_samples(1);
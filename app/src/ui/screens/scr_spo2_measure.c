@@ -211,9 +211,9 @@ void hpi_disp_spo2_update_progress(int progress, enum spo2_meas_state state, int
     }
 }
 
-void hpi_disp_spo2_plot_wrist_ppg(struct hpi_ppg_wr_data_t ppg_sensor_sample)
+void hpi_disp_spo2_plot_wrist_ppg(const struct hpi_ppg_wr_data_t *ppg_sensor_sample)
 {
-    uint32_t *data_ppg = ppg_sensor_sample.raw_green;
+    const uint32_t *data_ppg = ppg_sensor_sample->raw_green;
 
     /* Simple DC removal: EMA baseline and plot residual centered to avoid LVGL coord wrap. */
     static float baseline_ema = 0.0f;
@@ -221,7 +221,7 @@ void hpi_disp_spo2_plot_wrist_ppg(struct hpi_ppg_wr_data_t ppg_sensor_sample)
     const float alpha = 0.005f; /* small alpha for slow baseline tracking */
 
     /* Cache locals to reduce repeated global accesses */
-    int num = ppg_sensor_sample.ppg_num_samples;
+    int num = ppg_sensor_sample->ppg_num_samples;
     float local_ymin = y_min_ppg;
     float local_ymax = y_max_ppg;
     float local_base = baseline_ema;
@@ -266,6 +266,76 @@ static int max30001_enable_bioz(const struct device *dev, bool bioz_en)
     return _max30001RegWrite(dev, CNFG_GEN, data->chip_cfg.reg_cnfg_gen.all);
 }
 
+// Program the watermarks for the current rates and restart both FIFOs, so
+// no record taken at the old rate is read back
+static void max30001_update_fifo_thresholds(const struct device *dev)
+{
+    struct max30001_data *data = dev->data;
+
+    data->efit_samples = MAX30001_ECG_FIT_FOR_RATE(data->ecg_rate_sps);
+    data->bfit_samples = MAX30001_BIOZ_FIT_FOR_RATE(data->bioz_rate_sps);
+
+    _max30001RegWrite(dev, MNGR_INT, MAX30001_MNGR_INT_FIT(data->efit_samples, data->bfit_samples));
+    max30001_fifo_reset(dev);
+    max30001_synch(dev);
+}
+
+static int max30001_set_ecg_rate(const struct device *dev, int sps)
+{
+    struct max30001_data *data = dev->data;
+
+    // Rates for FMSTR = 0b00 (32768 Hz)
+    switch (sps)
+    {
+    case 512:
+        data->chip_cfg.reg_cnfg_ecg.bit.rate = 0b00;
+        break;
+    case 256:
+        data->chip_cfg.reg_cnfg_ecg.bit.rate = 0b01;
+        break;
+    case 128:
+        data->chip_cfg.reg_cnfg_ecg.bit.rate = 0b10;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    // 40 Hz is the only low-pass at 128 SPS; faster rates keep the QRS
+    // detail with the 100 Hz one
+    data->chip_cfg.reg_cnfg_ecg.bit.dlpf = (sps == 128) ? 0b01 : 0b10;
+
+    data->ecg_rate_sps = sps;
+    _max30001RegWrite(dev, CNFG_ECG, data->chip_cfg.reg_cnfg_ecg.all);
+    max30001_update_fifo_thresholds(dev);
+
+    LOG_INF("ECG rate %d SPS, EFIT %d", sps, data->efit_samples);
+    return 0;
+}
+
+static int max30001_set_bioz_rate(const struct device *dev, int sps)
+{
+    struct max30001_data *data = dev->data;
+
+    switch (sps)
+    {
+    case 64:
+        data->chip_cfg.reg_cnfg_bioz.bit.rate = 0;
+        break;
+    case 32:
+        data->chip_cfg.reg_cnfg_bioz.bit.rate = 1;
+        break;
+    default:
+        return -EINVAL;
+    }
+
+    data->bioz_rate_sps = sps;
+    _max30001RegWrite(dev, CNFG_BIOZ, data->chip_cfg.reg_cnfg_bioz.all);
+    max30001_update_fifo_thresholds(dev);
+
+    LOG_INF("BioZ rate %d SPS, BFIT %d", sps, data->bfit_samples);
+    return 0;
+}
+
 static void max30001_enable_rtor(const struct device *dev)
 {
     _max30001RegWrite(dev, CNFG_RTOR1, 0x3fc600);
@@ -492,6 +562,10 @@ static int max30001_attr_set(const struct device *dev,
         _max30001RegWrite(dev, CNFG_EMUX, data->chip_cfg.reg_cnfg_emux.all);
         LOG_INF("ECG lead configuration set for %s hand", val->val1 ? "right" : "left");
         break;
+    case MAX30001_ATTR_ECG_RATE:
+        return max30001_set_ecg_rate(dev, val->val1);
+    case MAX30001_ATTR_BIOZ_RATE:
+        return max30001_set_bioz_rate(dev, val->val1);
     default:
         return -ENOTSUP;
     }
@@ -569,6 +643,8 @@ static int max30001_chip_init(const struct device *dev)
     }
 
     // ECG Configuration
+    data->ecg_rate_sps = MAX30001_ECG_RATE_DEFAULT;
+    data->bioz_rate_sps = MAX30001_BIOZ_RATE_DEFAULT;
     data->chip_cfg.reg_cnfg_ecg.bit.rate = 0b10;             // 128 SPS
     data->chip_cfg.reg_cnfg_ecg.bit.gain = config->ecg_gain; // From DTS
     data->chip_cfg.reg_cnfg_ecg.bit.dlpf = 0b01;             // 40 Hz
@@ -629,7 +705,9 @@ static int max30001_chip_init(const struct device *dev)
     k_sleep(K_MSEC(100));
 
     //_max30001RegWrite(dev, MNGR_INT, 0x190000); // EFIT=4, BFIT=2
-    _max30001RegWrite(dev, MNGR_INT, 0x7B0000); // EFIT=16, BFIT=8
+    data->efit_samples = MAX30001_ECG_FIT_FOR_RATE(data->ecg_rate_sps);
+    data->bfit_samples = MAX30001_BIOZ_FIT_FOR_RATE(data->bioz_rate_sps);
+    _max30001RegWrite(dev, MNGR_INT, MAX30001_MNGR_INT_FIT(data->efit_samples, data->bfit_samples)); // 0x7B0000
     //_max30001RegWrite(dev, MNGR_INT, 0x3B0000); // EFIT=8, BFIT=4
     //_max30001RegWrite(dev, MNGR_INT, 0x080000); // EFIT=2, BFIT=2
     //_max30001RegWrite(dev, MNGR_INT, 0x000000); // EFIT=1, BFIT=1
@@ -639,7 +717,13 @@ static int max30001_chip_init(const struct device *dev)
     //_max30001RegWrite(dev, MNGR_DYN, 0x7FFFFF); //  Enable manual fast recovery
     k_sleep(K_MSEC(100));
 
-    //_max30001RegWrite(dev, EN_INT, 0x800003); // Disable all interrupts
+#ifdef CONFIG_MAX30001_TRIGGER
+    err = max30001_init_interrupt(dev);
+    if (err < 0)
+    {
+        return err;
+    }
+#endif
 
     if (config->rtor_enabled)
     {
@@ -664,6 +748,9 @@ static const struct sensor_driver_api max30001_api_funcs = {
     .attr_set = max30001_attr_set,
     .sample_fetch = max30001_sample_fetch,
     .channel_get = max30001_channel_get,
+#ifdef CONFIG_MAX30001_TRIGGER
+    .trigger_set = max30001_trigger_set,
+#endif
 
 #ifdef CONFIG_SENSOR_ASYNC_API
     .submit = max30001_submit,
@@ -698,12 +785,29 @@ static int max30001_pm_action(const struct device *dev, enum pm_device_action ac
  * Main instantiation macro, which selects the correct bus-specific
  * instantiation macros for the instance.
  */
+#ifdef CONFIG_SENSOR_ASYNC_API
+// Bus RTIO context for the chained FIFO reads: up to 4 register reads of
+// 2 SQEs each, a FIFO reset and the completion callback
+#define MAX30001_RTIO_DEFINE(inst)                                        \
+    SPI_DT_IODEV_DEFINE(max30001_iodev_##inst, DT_DRV_INST(inst),         \
+                        MAX30001_SPI_OPERATION, 0U);                      \
+    RTIO_DEFINE(max30001_rtio_ctx_##inst, 16, 16);
+#define MAX30001_RTIO_CONFIG(inst)                                        \
+    .rtio_ctx = &max30001_rtio_ctx_##inst,                                \
+    .iodev = &max30001_iodev_##inst,
+#else
+#define MAX30001_RTIO_DEFINE(inst)
+#define MAX30001_RTIO_CONFIG(inst)
+#endif
+
 #define MAX30001_DEFINE(inst)                                             \
+    MAX30001_RTIO_DEFINE(inst)                                            \
     static struct max30001_data max30001_data_##inst;                     \
     static const struct max30001_config max30001_config_##inst =          \
         {                                                                 \
             .spi = SPI_DT_SPEC_INST_GET(                                  \
                 inst, MAX30001_SPI_OPERATION, 0),                         \
+            MAX30001_RTIO_CONFIG(inst)                                    \
             .ecg_gain = DT_INST_PROP(inst, ecg_gain),                     \
             .bioz_gain = DT_INST_PROP(inst, bioz_gain),                   \
             .bioz_cgmag = DT_INST_PROP(inst, bioz_cgmag),                 \
@@ -718,6 +822,8 @@ static int max30001_pm_action(const struct device *dev, enum pm_device_action ac
             .ecg_dcloff_enabled = DT_INST_PROP(inst, ecg_dcloff_enable),  \
             .ecg_dcloff_current = DT_INST_PROP(inst, ecg_dcloff_current), \
             .ecg_invert = DT_INST_PROP(inst, ecg_invert),                 \
+            .intb_gpio = GPIO_DT_SPEC_INST_GET_OR(inst, intb_gpios, {0}), \
+            .int2b_gpio = GPIO_DT_SPEC_INST_GET_OR(inst, int2b_gpios, {0}), \
                                                                           \
     };                                                                    \
     PM_DEVICE_DT_INST_DEFINE(inst, max30001_pm_action);                   \
@@ -10,6 +10,7 @@
 #include <zephyr/drivers/sensor.h>
 #include <zephyr/drivers/spi.h>
 #include <zephyr/drivers/gpio.h>
+#include <zephyr/rtio/rtio.h>
 
 #define MAX30001_STATUS_MASK_EINT 0x800000
 #define MAX30001_STATUS_MASK_EOVF 0x400000
@@ -27,6 +28,28 @@
 #define MAX30001_INT_SHIFT_BFIT 16
 #define MAX30001_INT_SHIFT_EFIT 19
 
+#define MAX30001_MNGR_INT_FIT(efit, bfit) \
+	((((efit) - 1) << MAX30001_INT_SHIFT_EFIT) | (((bfit) - 1) << MAX30001_INT_SHIFT_BFIT))
+
+// Largest FIFO watermarks, EFIT is 5 bits and BFIT 3 bits
+#define MAX30001_EFIT_MAX 32
+#define MAX30001_BFIT_MAX 8
+
+// Watermarks used for a rate: about one FIFO read per 125 ms, but never
+// more than 3/4 of the FIFO so read latency doesn't overflow it
+#define MAX30001_EFIT_WM_MAX (MAX30001_EFIT_MAX * 3 / 4)
+#define MAX30001_BFIT_WM_MAX (MAX30001_BFIT_MAX * 3 / 4)
+#define MAX30001_ECG_FIT_FOR_RATE(sps) MIN((sps) / 8, MAX30001_EFIT_WM_MAX)
+#define MAX30001_BIOZ_FIT_FOR_RATE(sps) MIN((sps) / 8, MAX30001_BFIT_WM_MAX)
+
+#define MAX30001_ECG_RATE_DEFAULT 128
+#define MAX30001_BIOZ_RATE_DEFAULT 32
+
+// EN_INT / EN_INT2
+#define MAX30001_EN_INT_EINT 0x800000
+#define MAX30001_EN_INT_BINT 0x080000
+#define MAX30001_EN_INT_TYPE_OD_PU 0x000003 // Open drain with internal 125k pull-up
+
 #define WREG 0x00
 #define RREG 0x01
 
@@ -87,6 +110,8 @@ enum max30001_attribute
 	MAX30001_ATTR_RTOR_ENABLED = 0x04, 
 	MAX30001_ATTR_DCLOFF_ENABLED = 0x05,
 	MAX30001_ATTR_LEAD_CONFIG = 0x06,
+	MAX30001_ATTR_ECG_RATE = 0x07,  // val1: 128, 256 or 512 SPS
+	MAX30001_ATTR_BIOZ_RATE = 0x08, // val1: 32 or 64 SPS
 };
 
 enum max30001_op_mode
@@ -335,6 +360,10 @@ struct max30001_chip_internal_config
 struct max30001_config
 {
 	struct spi_dt_spec spi;
+#ifdef CONFIG_SENSOR_ASYNC_API
+	struct rtio *rtio_ctx;
+	struct rtio_iodev *iodev;
+#endif
 	struct gpio_dt_spec intb_gpio;
 	struct gpio_dt_spec int2b_gpio;
 
@@ -365,6 +394,8 @@ struct max30001_decoder_header
 	uint64_t timestamp;
 } __attribute__((__packed__));
 
+struct max30001_encoded_data;
+
 struct max30001_data
 {
 	struct max30001_chip_internal_config chip_cfg;
@@ -382,6 +413,37 @@ struct max30001_data
 	uint8_t bioz_lead_off;
 
 	uint8_t chip_op_mode;
+
+	uint16_t ecg_rate_sps;
+	uint16_t bioz_rate_sps;
+
+	// FIFO watermarks in samples, as written to MNGR_INT
+	uint8_t efit_samples;
+	uint8_t bfit_samples;
+
+#ifdef CONFIG_SENSOR_ASYNC_API
+	// Raw frames of the chained read in flight
+	uint8_t rx_status[3];
+	uint8_t rx_ecg[MAX30001_EFIT_MAX * 3];
+	uint8_t rx_bioz[MAX30001_BFIT_MAX * 3];
+	uint8_t rx_rtor[3];
+	uint8_t rd_ecg_samples;
+	uint8_t rd_bioz_samples;
+	struct max30001_encoded_data *rd_edata;
+
+	// Set on a FIFO overflow tag; FIFO_RST leads the next chain
+	bool fifo_reset_pending;
+#endif
+
+#ifdef CONFIG_MAX30001_TRIGGER
+	const struct device *dev;
+	struct gpio_callback intb_cb;
+	struct gpio_callback int2b_cb;
+	struct k_work int_work;
+
+	const struct sensor_trigger *fifo_trigger;
+	sensor_trigger_handler_t fifo_handler;
+#endif
 };
 
 struct max30001_encoded_data
@@ -411,4 +473,11 @@ int max30001_get_decoder(const struct device *dev, const struct sensor_decoder_a
 void max30001_synch(const struct device *dev);
 void max30001_fifo_reset(const struct device *dev);
 uint32_t max30001_read_reg(const struct device *dev, uint8_t reg);
-uint32_t max30001_read_status(const struct device *dev);
\ No newline at end of file
+uint32_t max30001_read_status(const struct device *dev);
+int _max30001RegWrite(const struct device *dev, uint8_t reg, uint32_t val);
+
+#ifdef CONFIG_MAX30001_TRIGGER
+int max30001_init_interrupt(const struct device *dev);
+int max30001_trigger_set(const struct device *dev, const struct sensor_trigger *trig,
+						 sensor_trigger_handler_t handler);
+#endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <zephyr/drivers/sensor.h>
+#include <zephyr/rtio/rtio.h>
 
 #include <zephyr/logging/log.h>
 
@@ -6,281 +7,188 @@ LOG_MODULE_REGISTER(MAX30001_ASYNC, CONFIG_SENSOR_LOG_LEVEL);
 
 #include "max30001.h"
 
-static int max30001_async_sample_fetch_lon_detect(const struct device *dev, uint8_t *lon_state)
+/*
+ * One read is a single chain of SPI transactions on the bus RTIO context:
+ *
+ *   [FIFO_RST] -> STATUS -> ECG_FIFO_BURST -> BIOZ_FIFO_BURST -> RTOR -> callback
+ *
+ * Each register access is a command byte and its data under one chip select.
+ * Burst lengths come from the FIFO watermarks this driver programmed, so no
+ * MNGR_INT round trip is needed; slots past the available samples read back
+ * with the "FIFO empty" tag. The chain runs asynchronously and the callback
+ * decodes straight into the caller's max30001_encoded_data buffer.
+ */
+
+#define MAX30001_ETAG_VALID_EOF 0x02
+#define MAX30001_TAG_EMPTY 0x06
+#define MAX30001_TAG_OVERFLOW 0x07
+
+static uint32_t max30001_raw24(const uint8_t *raw)
 {
-    uint32_t max30001_status = 0;
+    return ((uint32_t)raw[0] << 16) | ((uint32_t)raw[1] << 8) | raw[2];
+}
 
-    max30001_status = max30001_read_status(dev);
+static int max30001_prep_reg_read(struct rtio *ctx, struct rtio_iodev *iodev, uint8_t reg,
+                                  uint8_t *buf, uint32_t len)
+{
+    struct rtio_sqe *cmd_sqe = rtio_sqe_acquire(ctx);
+    struct rtio_sqe *read_sqe = rtio_sqe_acquire(ctx);
+    uint8_t cmd = ((reg << 1) | RREG);
 
-    // printk("Status: %x\n", max30001_status);
-    if ((max30001_status & MAX30001_STATUS_MASK_LONINT) == MAX30001_STATUS_MASK_LONINT)
-    {
-        // printk("LONINT\n");
-        *lon_state = 1;
-    }
-    else
+    if (cmd_sqe == NULL || read_sqe == NULL)
     {
-        *lon_state = 0;
+        return -ENOMEM;
     }
 
+    rtio_sqe_prep_tiny_write(cmd_sqe, iodev, RTIO_PRIO_NORM, &cmd, 1, NULL);
+    cmd_sqe->flags = RTIO_SQE_TRANSACTION;
+
+    rtio_sqe_prep_read(read_sqe, iodev, RTIO_PRIO_NORM, buf, len, NULL);
+    read_sqe->flags = RTIO_SQE_CHAINED;
+
     return 0;
 }
 
-static int max30001_async_sample_fetch(const struct device *dev,
-                                       uint8_t *num_samples_ecg, uint8_t *num_samples_bioz, int32_t ecg_samples[32],
-                                       int32_t bioz_samples[32], uint16_t *rri, uint16_t *hr, uint8_t *rrint,
-                                       uint8_t *ecg_lead_off, uint8_t *bioz_lead_off)
+static int max30001_prep_reg_write(struct rtio *ctx, struct rtio_iodev *iodev, uint8_t reg, uint32_t val)
 {
-    struct max30001_data *data = dev->data;
-    const struct max30001_config *config = dev->config;
-
-    uint32_t max30001_status, max30001_mngr_int = 0;
-    uint32_t e_fifo_num_bytes, b_fifo_num_bytes;
-
-    uint32_t e_fifo_num_samples = 0;
-    uint32_t b_fifo_num_samples = 0;
+    struct rtio_sqe *write_sqe = rtio_sqe_acquire(ctx);
+    uint8_t cmd[] = {((reg << 1) | WREG), (uint8_t)(val >> 16), (uint8_t)(val >> 8), (uint8_t)val};
 
-    uint8_t buf_ecg[512];
-    uint8_t buf_bioz[512];
-
-    uint8_t cmd_tx_ecg_fifo_burst = ((ECG_FIFO_BURST << 1) | RREG);
-    const struct spi_buf tx_buf_ecg[1] = {{.buf = &cmd_tx_ecg_fifo_burst, .len = 1}};
-    const struct spi_buf_set tx_ecg = {.buffers = tx_buf_ecg, .count = 1};
-
-    uint8_t cmd_tx_bioz_fifo_burst = ((BIOZ_FIFO_BURST << 1) | RREG);
-    const struct spi_buf tx_buf_bioz[1] = {{.buf = &cmd_tx_bioz_fifo_burst, .len = 1}};
-    const struct spi_buf_set tx_bioz = {.buffers = tx_buf_bioz, .count = 1};
-
-    uint32_t max30001_rtor = 0;
-
-    max30001_status = max30001_read_status(dev);
-
-    if ((max30001_status & MAX30001_STATUS_MASK_DCLOFF) == MAX30001_STATUS_MASK_DCLOFF)
+    if (write_sqe == NULL)
     {
-        // printk("LOff");
-        data->ecg_lead_off = 1;
-        *ecg_lead_off = 1;
-    }
-    else
-    {
-        data->ecg_lead_off = 0;
-        *ecg_lead_off = 0;
+        return -ENOMEM;
     }
 
-    /*while ((max30001_status & MAX30001_STATUS_MASK_EINT) != MAX30001_STATUS_MASK_EINT)
-    {
-        max30001_status = max30001_read_status(dev);
-    }*/
+    rtio_sqe_prep_tiny_write(write_sqe, iodev, RTIO_PRIO_NORM, cmd, sizeof(cmd), NULL);
+    write_sqe->flags = RTIO_SQE_CHAINED;
 
-    // Handle ECG FIFO (when EINT is set)
-    if ((max30001_status & MAX30001_STATUS_MASK_EINT) == MAX30001_STATUS_MASK_EINT) // EINT bit is set, FIFO is full
-    // while ((max30001_status & MAX30001_STATUS_MASK_EINT) != MAX30001_STATUS_MASK_EINT) // EINT bit is set, FIFO is full
-    {
-        max30001_mngr_int = max30001_read_reg(dev, MNGR_INT);
-        e_fifo_num_samples = (((max30001_mngr_int & MAX30001_INT_MASK_EFIT) >> MAX30001_INT_SHIFT_EFIT) + 1); // No of samples = EFIT + 1
-        e_fifo_num_bytes = ((e_fifo_num_samples * 3));                                                        // 24 bit register + 1 dummy byte
-
-        // printk("ES: %d ", e_fifo_num_samples);
-
-        if (e_fifo_num_samples > 16)
-        {
-            e_fifo_num_samples = 16;
-        }
-        *num_samples_ecg = e_fifo_num_samples;
-
-        //_max30001_read_ecg_fifo(dev, e_fifo_num_bytes);
+    return 0;
+}
 
-        struct spi_buf rx_ecg_buf[2] = {{.buf = NULL, .len = 1}, {.buf = &buf_ecg, .len = (e_fifo_num_bytes)}}; // 24 bit register + 1 dummy byte
-        const struct spi_buf_set rx_ecg = {.buffers = rx_ecg_buf, .count = 2};
+// Returns the number of valid samples; stops at the first empty slot
+static uint8_t max30001_decode_ecg(struct max30001_data *data, int32_t *samples)
+{
+    uint8_t count = 0;
 
-        spi_transceive_dt(&config->spi, &tx_ecg, &rx_ecg);
+    for (int i = 0; i < data->rd_ecg_samples; i++)
+    {
+        const uint8_t *raw = &data->rx_ecg[i * 3];
+        uint32_t etag = ((raw[2] & 0x38) >> 3);
 
-        // Also read BioZ FIFO when ECG is active
-        if (max30001_mngr_int == 0) {
-            max30001_mngr_int = max30001_read_reg(dev, MNGR_INT);
+        if (etag <= MAX30001_ETAG_VALID_EOF) // Valid sample
+        {
+            uint32_t uecgtemp = (max30001_raw24(raw) & 0xFFFFC0) << 8;
+            samples[count++] = ((int32_t)uecgtemp) >> 6;
         }
-        b_fifo_num_samples = (((max30001_mngr_int & MAX30001_INT_MASK_BFIT) >> MAX30001_INT_SHIFT_BFIT) + 1);
-        b_fifo_num_bytes = (b_fifo_num_samples * 3);
-        *num_samples_bioz = b_fifo_num_samples;
-
-        struct spi_buf rx_bioz_buf[2] = {{.buf = NULL, .len = 1}, {.buf = &buf_bioz, .len = b_fifo_num_bytes}}; // 24 bit register
-        const struct spi_buf_set rx_bioz = {.buffers = rx_bioz_buf, .count = 2};
-
-        spi_transceive_dt(&config->spi, &tx_bioz, &rx_bioz);
-
-        // Read all the samples from the FIFO
-        for (int i = 0; i < e_fifo_num_samples; i++)
+        else if (etag == MAX30001_TAG_OVERFLOW)
         {
-            uint32_t etag = ((((uint8_t)buf_ecg[i * 3 + 2]) & 0x38) >> 3);
-
-            // printk("E %x ", etag);
-
-            if ((etag == 0x00) || (etag == 0x01) || (etag == 0x02)) // Valid sample
-            {
-                uint32_t uecgtemp = (uint32_t)(((uint32_t)buf_ecg[i * 3] << 16 | (uint32_t)buf_ecg[i * 3 + 1] << 8) | (uint32_t)(buf_ecg[i * 3 + 2] & 0xC0));
-                uecgtemp = (uint32_t)(uecgtemp << 8);
-
-                int32_t secgtemp = (int32_t)uecgtemp;
-                secgtemp = (int32_t)secgtemp >> 6;
-
-                ecg_samples[i] = (int32_t)(secgtemp); //((secgtemp*1000*1000)/2621440);   // Convert to microvolts
-                // printf("%d ", ecg_samples[i]);
-            }
-            else if (etag == 0x06)
-            {
-                break;
-            }
-            else if (etag == 0x07) // FIFO Overflow
-            {
-                // printk("EOVF ");
-                max30001_fifo_reset(dev);
-                // max30001_synch(dev);
-                break;
-            }
+            data->fifo_reset_pending = true;
+            break;
         }
-
-        // Read all the samples from the FIFO
-        for (int i = 0; i < b_fifo_num_samples; i++)
+        else
         {
-            uint32_t btag = ((((uint8_t)buf_bioz[i * 3 + 2]) & 0x07));
-
-            // printk("B %x ", btag);
-
-            if ((btag == 0x00) || (btag == 0x02)) // Valid sample
-            {
-                uint32_t u_bioz_temp = (uint32_t)(((uint32_t)buf_bioz[i * 3] << 16 | (uint32_t)buf_bioz[i * 3 + 1] << 8) | (uint32_t)(buf_bioz[i * 3 + 2] & 0xF0));
-                u_bioz_temp = (uint32_t)(u_bioz_temp << 8);
-
-                int32_t s_bioz_temp = (int32_t)u_bioz_temp;
-                s_bioz_temp = (int32_t)(s_bioz_temp >> 4);
-                // printf("%d ", secgtemp);
-
-                bioz_samples[i] = s_bioz_temp;
-            }
-            else if (btag == 0x06)
-            {
-                break;
-            }
-            else if (btag == 0x07) // FIFO Overflow
-            {
-                // printk("BOVF ");
-                max30001_fifo_reset(dev);
-                // max30001_synch(dev);
-                break;
-            }
+            break;
         }
+    }
 
-        /*max30001_rtor = max30001_read_reg(dev, RTOR);
-        if (max30001_rtor > 0)
-        {
-            data->lastRRI = (uint16_t)((double)((max30001_rtor >> 10) * 7.8125)*1000);
-            data->lastHR = (uint16_t)(60 * 1000 / data->lastRRI);
+    return count;
+}
 
-            *hr = data->lastHR;
-            *rri = data->lastRRI;
+static uint8_t max30001_decode_bioz(struct max30001_data *data, int32_t *samples)
+{
+    uint8_t count = 0;
+
+    for (int i = 0; i < data->rd_bioz_samples; i++)
+    {
+        const uint8_t *raw = &data->rx_bioz[i * 3];
+        uint32_t btag = (raw[2] & 0x07);
+
+        if ((btag == 0x00) || (btag == 0x02)) // Valid sample
+        {
+            uint32_t u_bioz_temp = (max30001_raw24(raw) & 0xFFFFF0) << 8;
+            samples[count++] = ((int32_t)u_bioz_temp) >> 4;
         }
-        if ((max30001_status & MAX30001_STATUS_MASK_RRINT) == MAX30001_STATUS_MASK_RRINT)
+        else if (btag == MAX30001_TAG_OVERFLOW)
         {
-            *rrint = 1;
+            LOG_WRN("BioZ FIFO overflow at sample %d", i);
+            data->fifo_reset_pending = true;
+            break;
         }
         else
         {
-            *rrint = 0;
-        }*/
-    }
-    
-    // Handle BioZ-only FIFO (when BINT is set but EINT is not)
-    else if ((max30001_status & MAX30001_STATUS_MASK_BINT) == MAX30001_STATUS_MASK_BINT)
-    {
-        max30001_mngr_int = max30001_read_reg(dev, MNGR_INT);
-        
-        // No ECG samples in this case
-        *num_samples_ecg = 0;
-        
-        // Read BioZ FIFO
-        b_fifo_num_samples = (((max30001_mngr_int & MAX30001_INT_MASK_BFIT) >> MAX30001_INT_SHIFT_BFIT) + 1);
-        b_fifo_num_bytes = (b_fifo_num_samples * 3);
-        *num_samples_bioz = b_fifo_num_samples;
-        
-        if (b_fifo_num_samples > 32) {
-            b_fifo_num_samples = 32;
-            *num_samples_bioz = 32;
+            break;
         }
+    }
 
-        struct spi_buf rx_bioz_buf[2] = {{.buf = NULL, .len = 1}, {.buf = &buf_bioz, .len = b_fifo_num_bytes}};
-        const struct spi_buf_set rx_bioz = {.buffers = rx_bioz_buf, .count = 2};
+    return count;
+}
 
-        spi_transceive_dt(&config->spi, &tx_bioz, &rx_bioz);
+static void max30001_complete_cb(struct rtio *ctx, const struct rtio_sqe *sqe, int result, void *arg0)
+{
+    struct rtio_iodev_sqe *iodev_sqe = (struct rtio_iodev_sqe *)arg0;
+    const struct device *dev = (const struct device *)sqe->userdata;
+    struct max30001_data *data = dev->data;
+    struct max30001_encoded_data *edata = data->rd_edata;
 
-        // Process BioZ samples
-        for (int i = 0; i < b_fifo_num_samples; i++)
-        {
-            uint32_t btag = ((((uint8_t)buf_bioz[i * 3 + 2]) & 0x07));
-
-            LOG_DBG("BioZ sample %d: btag=0x%02X", i, btag);
-
-            if ((btag == 0x00) || (btag == 0x02)) // Valid sample
-            {
-                uint32_t u_bioz_temp = (uint32_t)(((uint32_t)buf_bioz[i * 3] << 16 | (uint32_t)buf_bioz[i * 3 + 1] << 8) | (uint32_t)(buf_bioz[i * 3 + 2] & 0xF0));
-                u_bioz_temp = (uint32_t)(u_bioz_temp << 8);
-
-                int32_t s_bioz_temp = (int32_t)u_bioz_temp;
-                s_bioz_temp = (int32_t)(s_bioz_temp >> 4);
-
-                bioz_samples[i] = s_bioz_temp;
-            }
-            else if (btag == 0x06)
-            {
-                LOG_DBG("BioZ sample %d: FIFO empty (btag=0x06)", i);
-                break;
-            }
-            else if (btag == 0x07) // FIFO Overflow
-            {
-                LOG_WRN("BioZ FIFO overflow at sample %d", i);
-                // Don't reset FIFO immediately - try to recover the valid samples first
-                // max30001_fifo_reset(dev);
-                break;
-            }
-            else
-            {
-                LOG_WRN("BioZ sample %d: invalid btag=0x%02X", i, btag);
-            }
-        }
-    }
-    else
+    // The reads post completions to the bus context, drop them here
+    int err = rtio_flush_completion_queue(ctx);
+    if (result < 0 || err < 0)
     {
-        // No data available
-        *num_samples_ecg = 0;
-        *num_samples_bioz = 0;
+        LOG_ERR("Chained read failed: %d", (result < 0) ? result : err);
+        rtio_iodev_sqe_err(iodev_sqe, (result < 0) ? result : err);
+        return;
     }
 
-    /*if ((max30001_status & MAX30001_STATUS_MASK_BINT) == MAX30001_STATUS_MASK_BINT)
+    uint32_t max30001_status = max30001_raw24(data->rx_status);
+
+    if (edata->chip_op_mode == MAX30001_OP_MODE_LON_DETECT)
     {
-        max30001_mngr_int = max30001_read_reg(dev, MNGR_INT);
+        edata->lon_state = ((max30001_status & MAX30001_STATUS_MASK_LONINT) == MAX30001_STATUS_MASK_LONINT) ? 1 : 0;
+        rtio_iodev_sqe_ok(iodev_sqe, 0);
+        return;
+    }
+
+    data->ecg_lead_off = ((max30001_status & MAX30001_STATUS_MASK_DCLOFF) == MAX30001_STATUS_MASK_DCLOFF) ? 1 : 0;
+    edata->ecg_lead_off = data->ecg_lead_off;
+    edata->bioz_lead_off = 0;
 
+    edata->num_samples_ecg = max30001_decode_ecg(data, edata->ecg_samples);
+    edata->num_samples_bioz = max30001_decode_bioz(data, edata->bioz_samples);
 
-    }*/
+    // rrint flags a beat detected since the last fetch, rri alone repeats
+    edata->rrint = 0;
 
     if ((max30001_status & MAX30001_STATUS_MASK_RRINT) == MAX30001_STATUS_MASK_RRINT)
     {
-        max30001_rtor = max30001_read_reg(dev, RTOR);
-        if (max30001_rtor > 0)
+        uint32_t max30001_rtor = max30001_raw24(data->rx_rtor);
+        if ((max30001_rtor >> 10) > 0)
         {
             data->lastRRI = (uint16_t)(max30001_rtor >> 10) * 8;
             data->lastHR = (uint16_t)(60 * 1000 / data->lastRRI);
+            edata->rrint = 1;
         }
     }
 
     // Always output the last known good HR and RRI values (prevents displaying garbage/stale data)
-    *hr = data->lastHR;
-    *rri = data->lastRRI;
+    edata->hr = data->lastHR;
+    edata->rri = data->lastRRI;
 
-    return 0;
+    if (edata->num_samples_ecg == 0 && edata->num_samples_bioz == 0)
+    {
+        rtio_iodev_sqe_ok(iodev_sqe, 0); // Return 0 bytes
+    }
+    else
+    {
+        rtio_iodev_sqe_ok(iodev_sqe, sizeof(struct max30001_encoded_data));
+    }
 }
 
 int max30001_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
 {
+    const struct max30001_config *config = dev->config;
     struct max30001_data *data = dev->data;
+    struct rtio *ctx = config->rtio_ctx;
+    struct rtio_iodev *iodev = config->iodev;
 
     uint32_t m_min_buf_len = sizeof(struct max30001_encoded_data);
 
@@ -288,6 +196,7 @@ int max30001_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
     uint32_t buf_len;
 
     struct max30001_encoded_data *m_edata;
+    struct rtio_sqe *cb_sqe;
 
     int ret = 0;
 
@@ -299,44 +208,50 @@ int max30001_submit(const struct device *dev, struct rtio_iodev_sqe *iodev_sqe)
         return ret;
     }
 
-    if (data->chip_op_mode == MAX30001_OP_MODE_LON_DETECT)
-    {
-        m_edata = (struct max30001_encoded_data *)buf;
-        m_edata->header.timestamp = k_ticks_to_ns_floor64(k_uptime_ticks());
+    m_edata = (struct max30001_encoded_data *)buf;
+    m_edata->header.timestamp = k_ticks_to_ns_floor64(k_uptime_ticks());
+    m_edata->chip_op_mode = data->chip_op_mode;
+    data->rd_edata = m_edata;
 
-        m_edata->chip_op_mode = MAX30001_OP_MODE_LON_DETECT;
+    bool stream = (data->chip_op_mode == MAX30001_OP_MODE_STREAM);
+    data->rd_ecg_samples = (stream && data->chip_cfg.reg_cnfg_gen.bit.en_ecg) ? data->efit_samples : 0;
+    data->rd_bioz_samples = (stream && data->chip_cfg.reg_cnfg_gen.bit.en_bioz) ? data->bfit_samples : 0;
 
-        ret = max30001_async_sample_fetch_lon_detect(dev, &m_edata->lon_state);
-    }
-    else
+    if (data->fifo_reset_pending)
     {
-        m_edata = (struct max30001_encoded_data *)buf;
-        m_edata->header.timestamp = k_ticks_to_ns_floor64(k_uptime_ticks());
+        ret = max30001_prep_reg_write(ctx, iodev, FIFO_RST, 0x000000);
+        data->fifo_reset_pending = false;
+    }
 
-        m_edata->chip_op_mode = MAX30001_OP_MODE_STREAM;
-        ret = max30001_async_sample_fetch(dev, &m_edata->num_samples_ecg, &m_edata->num_samples_bioz,
-                                          m_edata->ecg_samples, m_edata->bioz_samples, &m_edata->rri, &m_edata->hr, &m_edata->rrint,
-                                          &m_edata->ecg_lead_off, &m_edata->bioz_lead_off);
+    if (ret == 0)
+    {
+        ret = max30001_prep_reg_read(ctx, iodev, STATUS, data->rx_status, sizeof(data->rx_status));
     }
-    if (ret != 0)
+    if (ret == 0 && data->rd_ecg_samples > 0)
     {
-        LOG_ERR("RTIO submit failed: ret=%d", ret);
-        rtio_iodev_sqe_err(iodev_sqe, ret);
-        return ret;
+        ret = max30001_prep_reg_read(ctx, iodev, ECG_FIFO_BURST, data->rx_ecg, data->rd_ecg_samples * 3);
+    }
+    if (ret == 0 && data->rd_bioz_samples > 0)
+    {
+        ret = max30001_prep_reg_read(ctx, iodev, BIOZ_FIFO_BURST, data->rx_bioz, data->rd_bioz_samples * 3);
+    }
+    if (ret == 0 && stream)
+    {
+        ret = max30001_prep_reg_read(ctx, iodev, RTOR, data->rx_rtor, sizeof(data->rx_rtor));
     }
 
-    // Check if we have any data to return
-    if (m_edata->chip_op_mode == MAX30001_OP_MODE_STREAM) {
-        if (m_edata->num_samples_ecg == 0 && m_edata->num_samples_bioz == 0) {
-            rtio_iodev_sqe_ok(iodev_sqe, 0);  // Return 0 bytes
-            return 0;
-        } else {
-            rtio_iodev_sqe_ok(iodev_sqe, m_min_buf_len);  // Return actual data
-            return 0;
-        }
+    cb_sqe = (ret == 0) ? rtio_sqe_acquire(ctx) : NULL;
+    if (cb_sqe == NULL)
+    {
+        LOG_ERR("RTIO submission queue full");
+        rtio_sqe_drop_all(ctx);
+        rtio_iodev_sqe_err(iodev_sqe, -ENOMEM);
+        return -ENOMEM;
     }
 
-    rtio_iodev_sqe_ok(iodev_sqe, 0);
+    rtio_sqe_prep_callback_no_cqe(cb_sqe, max30001_complete_cb, iodev_sqe, (void *)dev);
+
+    rtio_submit(ctx, 0);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,184 @@
+// ProtoCentral Electronics (info@protocentral.com)
+// SPDX-License-Identifier: Apache-2.0
+
+#define DT_DRV_COMPAT maxim_max30001
+
+#include <zephyr/logging/log.h>
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/drivers/gpio.h>
+
+#include "max30001.h"
+
+LOG_MODULE_DECLARE(SENSOR_MAX30001, CONFIG_MAX30001_LOG_LEVEL);
+
+/*
+ * EINT/BINT stay asserted until the FIFO is read back below EFIT/BFIT, so the
+ * lines are used level triggered: the ISR masks the pin, the work item runs
+ * the handler and unmasks it again. A read that leaves the FIFO above its
+ * watermark simply fires another round.
+ */
+
+static void max30001_int_lines_enable(const struct device *dev, bool enable)
+{
+    const struct max30001_config *config = dev->config;
+    gpio_flags_t flags = enable ? GPIO_INT_LEVEL_ACTIVE : GPIO_INT_DISABLE;
+
+    gpio_pin_interrupt_configure_dt(&config->intb_gpio, flags);
+
+    if (config->int2b_gpio.port != NULL)
+    {
+        gpio_pin_interrupt_configure_dt(&config->int2b_gpio, flags);
+    }
+}
+
+static void max30001_intb_callback(const struct device *port, struct gpio_callback *cb, uint32_t pins)
+{
+    struct max30001_data *data = CONTAINER_OF(cb, struct max30001_data, intb_cb);
+
+    max30001_int_lines_enable(data->dev, false);
+    k_work_submit(&data->int_work);
+}
+
+static void max30001_int2b_callback(const struct device *port, struct gpio_callback *cb, uint32_t pins)
+{
+    struct max30001_data *data = CONTAINER_OF(cb, struct max30001_data, int2b_cb);
+
+    max30001_int_lines_enable(data->dev, false);
+    k_work_submit(&data->int_work);
+}
+
+static void max30001_int_work_handler(struct k_work *work)
+{
+    struct max30001_data *data = CONTAINER_OF(work, struct max30001_data, int_work);
+    sensor_trigger_handler_t handler = data->fifo_handler;
+
+    if (handler == NULL)
+    {
+        return;
+    }
+
+    handler(data->dev, data->fifo_trigger);
+
+    if (data->fifo_handler != NULL)
+    {
+        max30001_int_lines_enable(data->dev, true);
+    }
+}
+
+int max30001_trigger_set(const struct device *dev, const struct sensor_trigger *trig,
+                         sensor_trigger_handler_t handler)
+{
+    const struct max30001_config *config = dev->config;
+    struct max30001_data *data = dev->data;
+    uint32_t en_int = MAX30001_EN_INT_TYPE_OD_PU;
+    uint32_t en_int2 = MAX30001_EN_INT_TYPE_OD_PU;
+
+    if (config->intb_gpio.port == NULL)
+    {
+        return -ENOTSUP;
+    }
+
+    if (trig->type != SENSOR_TRIG_FIFO_WATERMARK)
+    {
+        return -ENOTSUP;
+    }
+
+    max30001_int_lines_enable(dev, false);
+
+    data->fifo_trigger = trig;
+    data->fifo_handler = handler;
+
+    if (handler != NULL)
+    {
+        // ECG watermark on INTB; BioZ on INT2B when that line is wired
+        en_int |= MAX30001_EN_INT_EINT;
+        if (config->int2b_gpio.port != NULL)
+        {
+            en_int2 |= MAX30001_EN_INT_BINT;
+        }
+        else
+        {
+            en_int |= MAX30001_EN_INT_BINT;
+        }
+    }
+
+    _max30001RegWrite(dev, EN_INT, en_int);
+    _max30001RegWrite(dev, EN_INT2, en_int2);
+
+    if (handler != NULL)
+    {
+        max30001_int_lines_enable(dev, true);
+    }
+
+    LOG_DBG("FIFO watermark interrupt %s", (handler != NULL) ? "enabled" : "disabled");
+
+    return 0;
+}
+
+static int max30001_init_line(const struct gpio_dt_spec *spec, struct gpio_callback *cb,
+                              gpio_callback_handler_t isr)
+{
+    int ret;
+
+    if (!gpio_is_ready_dt(spec))
+    {
+        LOG_ERR("Interrupt GPIO %s not ready", spec->port->name);
+        return -ENODEV;
+    }
+
+    ret = gpio_pin_configure_dt(spec, GPIO_INPUT);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    gpio_init_callback(cb, isr, BIT(spec->pin));
+
+    ret = gpio_add_callback(spec->port, cb);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    return gpio_pin_interrupt_configure_dt(spec, GPIO_INT_DISABLE);
+}
+
+int max30001_init_interrupt(const struct device *dev)
+{
+    const struct max30001_config *config = dev->config;
+    struct max30001_data *data = dev->data;
+    int ret;
+
+    data->dev = dev;
+    k_work_init(&data->int_work, max30001_int_work_handler);
+
+    // Chip side routing stays off until a trigger handler is set
+    _max30001RegWrite(dev, EN_INT, MAX30001_EN_INT_TYPE_OD_PU);
+    _max30001RegWrite(dev, EN_INT2, MAX30001_EN_INT_TYPE_OD_PU);
+
+    if (config->intb_gpio.port == NULL)
+    {
+        LOG_DBG("No INTB line, FIFO must be polled");
+        return 0;
+    }
+
+    ret = max30001_init_line(&config->intb_gpio, &data->intb_cb, max30001_intb_callback);
+    if (ret < 0)
+    {
+        LOG_ERR("INTB setup failed: %d", ret);
+        return ret;
+    }
+
+    if (config->int2b_gpio.port != NULL)
+    {
+        ret = max30001_init_line(&config->int2b_gpio, &data->int2b_cb, max30001_int2b_callback);
+        if (ret < 0)
+        {
+            LOG_ERR("INT2B setup failed: %d", ret);
+            return ret;
+        }
+    }
+
+    return 0;
+}
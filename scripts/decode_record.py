@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: MIT
+#
+# Decode a HealthyPi Move ECG/BioZ record file to one sample per line.
+#
+# Compressed records (app/src/hpi_record_codec.c) start with a "HECZ" file
+# header followed by blocks; older records are raw little-endian int32.
+#
+#   decode_record.py <record file> [-o samples.csv]
+#   decode_record.py --selftest
+
+import argparse
+import random
+import struct
+import sys
+
+MAGIC = 0x5A434548
+FILE_HDR = struct.Struct("<IBBHHH")
+BLOCK_HDR = struct.Struct("<BBHHi")
+BLOCK_SYNC = 0xB5
+RAW_BLOCK = 0xFF
+BLOCK_SAMPLES = 128
+RICE_ESCAPE = 24
+RICE_MAX_K = 24
+MASK32 = 0xFFFFFFFF
+
+
+def to_i32(v):
+    v &= MASK32
+    return v - (1 << 32) if v & 0x80000000 else v
+
+
+def zigzag_enc(v):
+    return ((v << 1) ^ (v >> 31)) & MASK32
+
+
+def zigzag_dec(u):
+    return (u >> 1) ^ -(u & 1)
+
+
+def predict(s, i):
+    return s[0] if i == 1 else 2 * s[i - 1] - s[i - 2]
+
+
+class BitReader:
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def get(self, nbits):
+        if self.pos + nbits > len(self.data) * 8:
+            raise ValueError("truncated block")
+        v = 0
+        for _ in range(nbits):
+            v = (v << 1) | ((self.data[self.pos >> 3] >> (7 - (self.pos & 7))) & 1)
+            self.pos += 1
+        return v
+
+
+class BitWriter:
+    def __init__(self):
+        self.bits = []
+
+    def put(self, value, nbits):
+        self.bits.extend((value >> (nbits - 1 - i)) & 1 for i in range(nbits))
+
+    def bytes(self):
+        out = bytearray((len(self.bits) + 7) // 8)
+        for i, b in enumerate(self.bits):
+            out[i >> 3] |= b << (7 - (i & 7))
+        return bytes(out)
+
+
+def rice_get(br, k):
+    q = 0
+    while br.get(1):
+        q += 1
+        if q == RICE_ESCAPE:
+            return br.get(32)
+    return (q << k) | (br.get(k) if k else 0)
+
+
+def decode_block(data, off):
+    sync, k, n, payload_len, keyframe = BLOCK_HDR.unpack_from(data, off)
+    if sync != BLOCK_SYNC or n == 0 or n > BLOCK_SAMPLES:
+        raise ValueError("bad block at offset %d" % off)
+    payload = data[off + BLOCK_HDR.size:off + BLOCK_HDR.size + payload_len]
+    if len(payload) != payload_len:
+        raise ValueError("truncated block at offset %d" % off)
+
+    s = [keyframe]
+    if k == RAW_BLOCK:
+        s.extend(struct.unpack("<%di" % (n - 1), payload))
+    else:
+        br = BitReader(payload)
+        for i in range(1, n):
+            s.append(to_i32(predict(s, i) + zigzag_dec(rice_get(br, k))))
+    return s, BLOCK_HDR.size + payload_len
+
+
+def decode(data):
+    if len(data) >= FILE_HDR.size and FILE_HDR.unpack_from(data)[0] == MAGIC:
+        samples = []
+        off = FILE_HDR.size
+        while off < len(data):
+            try:
+                block, used = decode_block(data, off)
+            except (ValueError, struct.error) as e:
+                # An interrupted write leaves a partial last block
+                print("stopping: %s" % e, file=sys.stderr)
+                break
+            samples.extend(block)
+            off += used
+        return samples
+
+    return list(struct.unpack("<%di" % (len(data) // 4), data[:len(data) // 4 * 4]))
+
+
+# Reference encoder, mirrors hpi_record_codec_encode_block() for the self test
+def encode_block(s):
+    n = len(s)
+    res = [zigzag_enc(to_i32(s[i] - predict(s, i))) for i in range(1, n)]
+    k = 0
+    while k < RICE_MAX_K and ((n - 1) << (k + 1)) <= sum(res):
+        k += 1
+
+    bw = BitWriter()
+    for u in res:
+        q = u >> k
+        if q >= RICE_ESCAPE:
+            bw.put((1 << RICE_ESCAPE) - 1, RICE_ESCAPE)
+            bw.put(u, 32)
+        else:
+            bw.put(((1 << q) - 1) << 1, q + 1)
+            bw.put(u & ((1 << k) - 1), k)
+    payload = bw.bytes()
+
+    if len(payload) >= (n - 1) * 4:
+        k = RAW_BLOCK
+        payload = struct.pack("<%di" % (n - 1), *s[1:])
+    return BLOCK_HDR.pack(BLOCK_SYNC, k, n, len(payload), s[0]) + payload
+
+
+def encode(samples, log_type=0x10, sample_rate=128):
+    out = bytearray(FILE_HDR.pack(MAGIC, 1, log_type, sample_rate, BLOCK_SAMPLES, 0))
+    for i in range(0, len(samples), BLOCK_SAMPLES):
+        out += encode_block(samples[i:i + BLOCK_SAMPLES])
+    return bytes(out)
+
+
+def selftest():
+    rng = random.Random(1)
+    cases = {
+        "ecg": [int(20000 * ((i % 110) < 6) + rng.randint(-30, 30)) for i in range(128 * 30)],
+        "noise18": [rng.randint(-(1 << 17), (1 << 17) - 1) for _ in range(1000)],
+        "extremes": [-(1 << 31), (1 << 31) - 1, 0, -(1 << 31), 5],
+        "single": [42],
+    }
+    for name, samples in cases.items():
+        enc = encode(samples)
+        if decode(enc) != samples:
+            print("FAIL: %s" % name)
+            return 1
+        print("ok: %-8s %6d samples %7d -> %6d bytes" % (name, len(samples), len(samples) * 4, len(enc)))
+    return 0
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__)
+    ap.add_argument("record", nargs="?")
+    ap.add_argument("-o", "--output")
+    ap.add_argument("--selftest", action="store_true")
+    args = ap.parse_args()
+
+    if args.selftest:
+        return selftest()
+    if not args.record:
+        ap.error("record file required")
+
+    with open(args.record, "rb") as f:
+        samples = decode(f.read())
+
+    out = open(args.output, "w") if args.output else sys.stdout
+    for v in samples:
+        out.write("%d\n" % v)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())